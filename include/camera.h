@@ -68,6 +68,9 @@ namespace MiniEngine
 
         Matrix4f getViewProjection();
 
+        // pixels covered by a unit long segment facing the camera at i_distance
+        float getPixelsPerUnit( const float i_distance );
+
         inline uint32_t getWidth() const
         {
             return m_width;
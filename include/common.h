@@ -70,6 +70,86 @@ struct Vertex
     {}
 };
 
+//the vertex buffer of a mesh is split in two streams, the positions and everything else (VertexAttributes),
+//so the depth only passes fetch the positions alone
+struct VertexAttributes
+{
+    Vector3f m_normal;
+    Vector2f m_uv;
+};
+
+//16 bit positions in the cube around the bounds of the mesh, octahedral normals and half float uvs
+struct PackedPosition
+{
+    uint16_t m_position[ 4 ]; //unorm, w unused
+};
+
+struct PackedAttributes
+{
+    int16_t  m_normal[ 2 ]; //snorm
+    uint16_t m_uv    [ 2 ]; //half
+};
+
+//what the vertex buffer of a mesh holds
+enum class VertexLayout : uint32_t
+{
+    Full   = 0, //Vector3f positions and VertexAttributes
+    Packed = 1  //PackedPosition and PackedAttributes, the model matrix takes the dequantization
+};
+
+//the streams a pipeline reads: positions at binding 0, attributes at binding 1
+enum class VertexStreams : uint32_t
+{
+    All       = 0,
+    Positions = 1
+};
+
+constexpr VertexLayout  kSCENE_VERTEX_LAYOUT  = kPACKED_VERTICES ? VertexLayout::Packed : VertexLayout::Full;
+constexpr VertexStreams kDEPTH_VERTEX_STREAMS = kDEPTH_POSITION_STREAM ? VertexStreams::Positions : VertexStreams::All;
+
+struct MeshBounds
+{
+    Vector3f m_min;
+    Vector3f m_max;
+
+    MeshBounds() :
+        m_min( {  kINFINITY,  kINFINITY,  kINFINITY } ),
+        m_max( { -kINFINITY, -kINFINITY, -kINFINITY } )
+    {}
+
+    void extend( const Vector3f& i_point )
+    {
+        m_min = glm::min( m_min, i_point );
+        m_max = glm::max( m_max, i_point );
+    }
+};
+
+//range of the index buffer drawn at one level of detail, the error is how far (in object units) its surface
+//can be from the full mesh
+struct MeshLod
+{
+    uint32_t m_index_offset;
+    uint32_t m_index_count;
+    float    m_error;
+};
+
+//what a mesh is created from. A reader hands its array to the consumer in pieces, in order and of whole elements,
+//each one only valid during the call: a mapped cache gives the whole array in one piece straight from the mapping,
+//a compressed one every block as it is decompressed. The consumer splits or converts them into the staging memory
+template<typename T>
+using MeshPieceConsumer = std::function<void( const T* i_data, const uint32_t i_first, const uint32_t i_count )>;
+
+struct MeshData
+{
+    uint32_t             m_vertex_count = 0;
+    uint32_t             m_index_count  = 0; //every lod
+    MeshBounds           m_bounds;
+    std::vector<MeshLod> m_lods;             //full mesh first
+
+    std::function<void( const MeshPieceConsumer<Vertex>&   )> m_read_vertices;
+    std::function<void( const MeshPieceConsumer<uint32_t>& )> m_read_indices;
+};
+
 typedef enum ImageBlockType
 {
     IMAGE_BLOCK_2D = 0,
@@ -85,6 +165,7 @@ struct ImageBlock
     VkFormat       m_format;
     VkDeviceMemory m_memory     = VK_NULL_HANDLE;
     VkSampler      m_sampler    = VK_NULL_HANDLE;
+    VkExtent2D     m_extent     = { 0, 0 }; //size of the first mip, what a pass rendering into it sets as viewport
 };
 
 struct Attachments
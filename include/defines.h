@@ -24,6 +24,7 @@
 #include <iterator>
 #include <assert.h>
 #include <random>
+#include <functional>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -82,5 +83,29 @@ namespace MiniEngine
     constexpr uint32_t kMAX_NUMBER_OF_FRAMES = 3;
     constexpr uint32_t kSSAO_KERNEL_SIZE = 64;
     constexpr uint32_t kSSAO_NOISE_DIM = 4;
+    constexpr uint32_t kMAX_RECORDING_THREADS = 8;
+    constexpr uint32_t kMIN_DRAWS_PER_SECONDARY = 128;
+    constexpr uint32_t kMAX_NUMBER_OF_SWAPCHAIN_IMAGES = 3;
+    constexpr bool     kRECORD_ONCE_COMMAND_BUFFERS = true;
+    constexpr bool     kCOMPRESS_MESH_CACHE = false;
+    constexpr float    kWELD_EPSILON = 1e-6f;
+    constexpr uint32_t kVERTEX_CACHE_SIZE = 16;
+    constexpr uint32_t kMAX_MESH_LODS = 5;
+    constexpr float    kLOD_MAX_ERROR = 0.02f;        //of the bounds diagonal, coarser levels are not built
+    constexpr bool     kLOG_MESH_IMPORT = false;      //prints the vertex cache and lod statistics of every imported obj
+    constexpr float    kLOD_PIXEL_ERROR = 1.0f;
+    constexpr float    kSHADOW_LOD_PIXEL_ERROR = 4.0f;
+    constexpr bool     kPACKED_VERTICES = true;       //quantized positions, octahedral normals and half uvs, shaders/vert_packed.spv
+    constexpr bool     kDEPTH_POSITION_STREAM = true;  //the depth only passes fetch the position stream alone, shaders/depth.spv and depth_packed.spv
+    constexpr uint32_t kGEOMETRY_POOL_VERTICES = 1 << 21; //per vertex layout
+    constexpr uint32_t kGEOMETRY_POOL_INDICES = 1 << 23;
+    constexpr bool     kINDIRECT_DRAWS = true;         //falls back to direct draws without drawIndirectFirstInstance
+    constexpr bool     kSPLIT_INDEX_CHUNKS = false;    //meshes past 65536 vertices as chunks of 16 bit indices instead of 32 bit ones
+    constexpr uint64_t kUPLOAD_RING_SIZE = 64ull << 20; //bytes of staging memory, bigger uploads get their own buffer
+    constexpr uint64_t kUPLOAD_ALIGNMENT = 16;
+    constexpr bool     kTRANSFER_QUEUE = true;         //uploads on a transfer only queue family when the device has one
+    constexpr bool     kASYNC_MESH_LOADING = true;     //entities are drawn as their meshes become resident, without it the scene waits for all of them
+    constexpr uint32_t kMESH_LOADER_THREADS = 2;
+    constexpr uint64_t kMESH_MEMORY_BUDGET = 64ull << 20; //geometry pool bytes kept by the mesh registry, the unused meshes past it are evicted. Below the 80 MiB the packed pool holds, a bigger one is clamped to it
 
 };
\ No newline at end of file
@@ -8,6 +8,8 @@ namespace MiniEngine
     class RenderPassVK;
     class WindowVK;
     class Scene;
+    class Entity;
+    struct Frame;
 
     class Engine final
     {
@@ -23,21 +25,37 @@ namespace MiniEngine
 
         void loadScene     ( const std::string& i_path );
 
+        //bytes written by the cpu for the gpu during the last frame
+        uint64_t getUploadBytesPerFrame() const
+        {
+            return m_upload_bytes_per_frame;
+        }
+
     private:
         Engine( const Engine& ) = delete;
         Engine& operator=(const Engine& ) = delete;
 
         void createSyncObjects  ();
         void destroySyncObjects ();
+        void createCommandBuffers ();
+        void destroyCommandBuffers();
         void createRenderPasses ();
         void destroyRenderPasses();
         void createAttachments  ();
         void destroyAttachments ();
+        void createShadowAttachments ();
+        void destroyShadowAttachments();
+        void resize             ();
         void createSamplers     ();
         void destroySamplers    ();
-        void updateGlobalBuffers();
+        void updateGlobalBuffers( Frame& io_frame );
+        void updateLods         ();
+        void addLoadedEntities  ();
+
+        VkCommandBuffer updateObjectBuffers( const Frame& i_frame );
 
         std::vector<std::shared_ptr<RenderPassVK>> m_render_passes;
+        std::vector<std::shared_ptr<Entity>>       m_loading_entities; //their mesh is not resident yet, no pass draws them
 
         struct FrameSemaphores
         {
@@ -45,9 +63,11 @@ namespace MiniEngine
             VkSemaphore m_presentation_semaphore;
         };
         
-        std::array<FrameSemaphores, 3> m_frame_semaphore;
-        std::array<VkFence        , 3> m_frame_fence;
-        uint32_t                       m_current_frame;
+        std::array<FrameSemaphores, kMAX_NUMBER_OF_FRAMES> m_frame_semaphore;
+        std::array<uint64_t       , kMAX_NUMBER_OF_FRAMES> m_frame_timeline_value; //signaled by the last submit of each slot
+        std::array<VkCommandBuffer, kMAX_NUMBER_OF_FRAMES> m_upload_command_buffer;
+        uint32_t                                           m_current_frame;
+        uint64_t                                           m_upload_bytes_per_frame;
 
         bool m_resize;
         bool m_close;
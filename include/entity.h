@@ -10,9 +10,17 @@ namespace MiniEngine
 {
     class MeshVK;
     class Material;
+    class Camera;
     struct Frame;
     struct Runtime;
 
+    //which level of detail a pass draws, the shadow maps take coarser ones
+    enum class LodTarget : uint32_t
+    {
+        Camera = 0,
+        Shadow = 1
+    };
+
     class Entity final 
     {
     public:
@@ -25,7 +33,20 @@ namespace MiniEngine
 
         static std::shared_ptr<Entity> createEntity(  const Runtime& i_runtime, const pugi::xml_node& i_node, const uint32_t i_id );
 
-        void draw( CommandBuffer& i_command_buffer,  const Frame& i_frame );
+        void draw( CommandBuffer& i_command_buffer,  const Frame& i_frame, const LodTarget i_target = LodTarget::Camera );
+
+        //what draw records, for the indirect buffers, getDrawCount commands
+        void getDrawCommands( const LodTarget i_target, VkDrawIndexedIndirectCommand* o_commands ) const;
+
+        uint32_t    getDrawCount() const;
+        VkIndexType getIndexType() const;
+
+        //picks the levels of detail from the size of the mesh on screen, true when one of them changed
+        bool selectLods( Camera& i_camera );
+
+        //the mesh may still be loading or its copies still running, an entity is added to the passes once
+        //i_completed_value, of the graphics timeline, has reached the submit that uploaded its mesh
+        bool isResident( const uint64_t i_completed_value ) const;
 
         inline Transform& getTransform()
        {
@@ -37,11 +58,21 @@ namespace MiniEngine
            return *m_material;
        }
 
+       inline const MeshVK& getMesh() const
+       {
+           return *m_mesh;
+       }
+
        inline uint32_t getEntityOffset() const
        {
            return m_entity_offset;
        }
 
+       //true when the transform or the material changed since the last markUploaded
+       bool isDirty() const;
+       void markUploaded();
+       void markDirty   ();
+
     private:
         Entity( const Entity& ) = delete;
         Entity& operator=(const Entity& ) = delete;
@@ -52,5 +83,11 @@ namespace MiniEngine
         std::shared_ptr<Material> m_material;
 
         uint32_t m_entity_offset;
+
+        std::array<uint32_t, 2> m_lods = { { 0, 0 } }; //by LodTarget
+
+        //generations of the data currently stored in the per object buffer
+        uint32_t m_uploaded_transform_generation = UINT32_MAX;
+        uint32_t m_uploaded_material_generation  = UINT32_MAX;
     };
 };
\ No newline at end of file
@@ -31,7 +31,7 @@ namespace MiniEngine
     struct PerObjectData
     {
         //for now we only have material data
-        alignas( 16 ) Matrix4f m_model;
+        alignas( 16 ) Matrix4f m_model; //with the dequantization of packed vertices folded in
         alignas( 16 ) Vector4f m_albedo; 
         alignas( 16 ) Vector4f m_metallic_roughness;
     };
@@ -42,5 +42,11 @@ namespace MiniEngine
     };
 
     struct Frame
-    {};
+    {
+        uint32_t m_frame_id = 0; //in-flight slot, selects per frame buffers, descriptor sets and command buffers
+        uint32_t m_image_id = 0; //acquired swap chain image
+
+        //dynamic offsets inside the upload buffer of the in-flight slot
+        uint32_t m_per_frame_offset = 0;
+    };
 };
\ No newline at end of file
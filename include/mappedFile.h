@@ -0,0 +1,51 @@
+#pragma once
+
+#include "common.h"
+
+namespace MiniEngine
+{
+    // Read only view of a whole file mapped in memory.
+    // Nothing is read on open, the pages come from the os file cache the first time they are touched.
+    class MappedFile final
+    {
+    public:
+        MappedFile ();
+        ~MappedFile();
+
+        bool open ( const std::string& i_path );
+        void close();
+
+        bool isOpen() const
+        {
+            return m_open;
+        }
+
+        const uint8_t* getData() const
+        {
+            return m_data;
+        }
+
+        size_t getSize() const
+        {
+            return m_size;
+        }
+
+        // size and last write time (seconds) of a file without opening it
+        static bool getStamp( const std::string& i_path, uint64_t& o_size, int64_t& o_time );
+
+    private:
+        MappedFile( const MappedFile& ) = delete;
+        MappedFile& operator=(const MappedFile& ) = delete;
+
+        const uint8_t* m_data;
+        size_t         m_size;
+        bool           m_open;
+
+#if defined(_WIN32)
+        void* m_file;
+        void* m_mapping;
+#else
+        int   m_file;
+#endif
+    };
+};
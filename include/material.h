@@ -17,7 +17,7 @@ namespace MiniEngine
             Undefined
         };
 
-        explicit Material( const Runtime& i_runtime, const TMaterial i_type ) : m_runtime( i_runtime ), m_material_type( i_type ){};
+        explicit Material( const Runtime& i_runtime, const TMaterial i_type ) : m_runtime( i_runtime ), m_material_type( i_type ), m_generation( 0 ){};
 
         ~Material() = default;
     
@@ -34,11 +34,23 @@ namespace MiniEngine
             return m_material_type;
         }
 
+        //bumped on every parameter change, lets the owner know when the gpu copy is stale
+        uint32_t getGeneration() const
+        {
+            return m_generation;
+        }
+
+        void markDirty()
+        {
+            m_generation++;
+        }
+
         static std::shared_ptr<Material> createMaterial(  const Runtime& i_runtime, const pugi::xml_node& i_node );
 
     protected:
        const Runtime& m_runtime;
        const TMaterial m_material_type;
+       uint32_t        m_generation;
 
     private:
         Material( const Material& ) = delete;
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "common.h"
+#include "mappedFile.h"
+
+namespace MiniEngine
+{
+    // Binary copy of a parsed and welded mesh and its levels of detail, written next to its source as <source>.mesh.
+    // It is tied to the size, last write time and content hash of the source, to the layout of Vertex and
+    // to the settings the arrays were built with (weld epsilon...), when any of them changed open fails
+    // and the source has to be parsed again. A source that was only touched (same size and content) keeps its cache.
+    // The file is mapped, the readers of getData hand the arrays straight from the mapping, or block by block
+    // as they are decompressed when the cache was written compressed.
+    class MeshCache final
+    {
+    public:
+        explicit MeshCache( const std::string& i_source_path, const uint64_t i_settings );
+        ~MeshCache() = default;
+
+        bool open ();
+        void close();
+
+        // the readers point into the mapping, valid while the cache is open
+        MeshData getData() const;
+
+        static void write(
+            const std::string&           i_source_path,
+            const std::vector<Vertex>&   i_vertices,
+            const std::vector<uint32_t>& i_indices,
+            const std::vector<MeshLod>&  i_lods,
+            const MeshBounds&            i_bounds,
+            const uint64_t               i_settings,
+            const bool                   i_compress );
+
+    private:
+        MeshCache( const MeshCache& ) = delete;
+        MeshCache& operator=(const MeshCache& ) = delete;
+
+        struct Header
+        {
+            uint32_t m_magic;
+            uint32_t m_version;
+            uint32_t m_vertex_size;
+            uint32_t m_flags;
+            uint64_t m_source_size;
+            int64_t  m_source_time;
+            uint64_t m_source_hash;
+            uint64_t m_settings;
+            uint32_t m_vertex_count;
+            uint32_t m_index_count;
+            float    m_bounds_min[ 3 ];
+            float    m_bounds_max[ 3 ];
+            uint64_t m_vertices_offset;
+            uint64_t m_vertices_stored_size;
+            uint64_t m_indices_offset;
+            uint64_t m_indices_stored_size;
+            uint32_t m_lod_count;
+            MeshLod  m_lods[ kMAX_MESH_LODS ];
+        };
+
+        static std::string getCachePath( const std::string& i_source_path );
+
+        typedef std::function<void( const uint8_t* i_data, const uint32_t i_first, const uint32_t i_count )> PieceConsumer;
+
+        // i_count elements of i_element_size bytes in pieces, see MeshData
+        void readArray( const uint64_t i_offset, const uint64_t i_stored_size, const size_t i_element_size, const uint32_t i_count, const PieceConsumer& i_consumer ) const;
+
+        std::string m_source_path;
+        uint64_t    m_settings;
+        MappedFile  m_file;
+        Header      m_header;
+    };
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "common.h"
+
+namespace MiniEngine
+{
+    // Reorders the triangles and vertices of an indexed mesh for the GPU, done once at import.
+    // optimize runs three passes: Tipsify orders the triangles for the post-transform cache, the resulting
+    // clusters are sorted from the outside of the mesh to the inside so near surfaces tend to be drawn first
+    // (less overdraw), and the vertices are renumbered in the order the indices first use them (vertex fetch).
+    namespace MeshOptimizer
+    {
+        // ACMR: transformed vertices per triangle, from 0.5 (ideal for large grids) to 3
+        // ATVR: transformed vertices per vertex, 1 is ideal
+        struct CacheStatistics
+        {
+            float m_acmr;
+            float m_atvr;
+        };
+
+        // simulates a FIFO post-transform cache of i_cache_size entries
+        CacheStatistics analyzeVertexCache( const std::vector<uint32_t>& i_indices, const size_t i_vertex_count, const uint32_t i_cache_size );
+
+        void optimize( std::vector<Vertex>& io_vertices, std::vector<uint32_t>& io_indices, const uint32_t i_cache_size );
+
+        // only the triangle order for the post-transform cache, the vertices stay where they are
+        void optimizeVertexCache( std::vector<uint32_t>& io_indices, const size_t i_vertex_count, const uint32_t i_cache_size );
+    };
+};
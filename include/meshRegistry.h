@@ -1,6 +1,12 @@
 #pragma once
 
 #include "common.h"
+#include "meshCache.h"
+#include "mpscQueue.h"
+#include "workerPool.h"
+
+#include <atomic>
+#include <chrono>
 
 namespace MiniEngine
 {
@@ -8,23 +14,113 @@ namespace MiniEngine
     class MeshVK;
 
     
+    // Every mesh by path and layout. The registry holds a reference to each one, a mesh nothing else holds
+    // anymore stays resident until the meshes in the geometry pool go over the budget, kMESH_MEMORY_BUDGET clamped
+    // to what the pool holds, then the least recently used of those are evicted. A mesh that doesn't fit in the
+    // pool evicts them too before it gives up. Loading an evicted path again reads it back, from the binary cache.
     class MeshRegistry final
     {
     public:
+        struct Statistics
+        {
+            uint64_t m_resident_bytes = 0;   //vertices and indices in the geometry pool
+            uint64_t m_evictions      = 0;
+            uint64_t m_reloads        = 0;   //loads of an evicted path
+            double   m_reload_ms      = 0.0; //summed over m_reloads, from the request to the upload
+            double   m_last_reload_ms = 0.0;
+        };
+
         explicit MeshRegistry ( const Runtime& i_runtime );
         ~MeshRegistry() = default;
 
         bool initialize();
         void shutdown();
 
-        std::shared_ptr<MeshVK> loadMesh( const std::string& i_path );
+        // a path loaded with both layouts is two meshes
+        std::shared_ptr<MeshVK> loadMesh( const std::string& i_path, const VertexLayout i_layout = kSCENE_VERTEX_LAYOUT );
+
+        // returns at once, the mesh is read on the loader threads and stays non resident until an update uploads it.
+        // A loader fans the parsing and welding of its mesh out over the other loaders
+        std::shared_ptr<MeshVK> loadMeshAsync( const std::string& i_path, const VertexLayout i_layout = kSCENE_VERTEX_LAYOUT );
+
+        // uploads the loads as they finish until none is left, for a scene that has to be whole before it is drawn
+        void waitLoaded();
+
+        // render thread, once per frame after the wait on its timeline value. Uploads the meshes the loaders finished,
+        // marks the ones still held as used in i_frame and evicts down to the budget. How many became resident
+        uint32_t update( const uint64_t i_frame );
+
+        // the device finished every submit, the meshes drawn until now are evicted without waiting kMAX_NUMBER_OF_FRAMES frames
+        void markIdle();
+
+        bool isLoading() const
+        {
+            return m_loading > 0;
+        }
+
+        const Statistics& getStatistics() const
+        {
+            return m_statistics;
+        }
 
 
     private:
         MeshRegistry( const MeshRegistry& ) = delete;
         MeshRegistry& operator=(const MeshRegistry& ) = delete;
 
+        //what a loader thread hands back for MeshVK::initialize. A cached mesh stays in its open cache and is read
+        //from the mapping straight into the staging buffers, only a fresh obj import carries the arrays
+        struct LoadedMesh
+        {
+            std::shared_ptr<MeshVK>    m_mesh;
+            std::string                m_path;
+            std::unique_ptr<MeshCache> m_cache;    //open, or null for an import
+            std::vector<Vertex>        m_vertices;
+            std::vector<uint32>        m_indices;
+            std::vector<MeshLod>       m_lods;
+            MeshBounds                 m_bounds;
+            std::string                m_error;    //empty when it loaded
+
+            bool                                  m_reload = false;
+            std::chrono::steady_clock::time_point m_start;
+        };
+
+        //opens the cache of io_mesh.m_path, or fills the arrays from the obj when there is none. Touches nothing else, any thread
+        static void readMesh( LoadedMesh& io_mesh, WorkerPool* i_workers );
+
+        std::unique_ptr<LoadedMesh> createJob( const std::string& i_key, const std::string& i_path, const VertexLayout i_layout );
+
+        uint32_t uploadLoaded();
+        void     addResident ( MeshVK& io_mesh, const bool i_reload, const std::chrono::steady_clock::time_point i_start );
+
+        // the least recently used meshes nothing holds, that no frame in flight may draw, until i_budget is met
+        void evict( const uint64_t i_budget );
+
+        // one of them, false when every resident mesh is in use
+        bool evictLeastRecentlyUsed();
+
+        // drawn by a frame the gpu may not have finished
+        bool isInFlight( const MeshVK& i_mesh ) const;
+
+        // evicts until io_mesh fits in the geometry pool, throws when nothing is left to evict
+        void initializeMesh( MeshVK& io_mesh, const MeshData& i_data, const std::string& i_path );
+
+        void stopLoaders();
+        void loadJob    ( std::unique_ptr<LoadedMesh> io_job );
+
         const Runtime& m_runtime;
         std::unordered_map<std::string, std::shared_ptr<MeshVK>> m_meshes;
+        std::set<std::string>                                    m_evicted; //keys, a load of one of them is a reload
+
+        uint64_t   m_frame;      //of the last update
+        uint64_t   m_idle_frame; //no submit before it is in flight, set by markIdle
+        uint64_t   m_budget;     //bytes, set by initialize
+        Statistics m_statistics;
+
+        WorkerPool                              m_loaders;        //kMESH_LOADER_THREADS, their jobs never touch vulkan
+        std::atomic<bool>                       m_stop;           //the queued jobs are dropped
+
+        MpscQueue<std::unique_ptr<LoadedMesh>>  m_completed;      //loaders to render thread
+        uint32_t                                m_loading;        //queued and not yet uploaded, render thread only
     };
 };
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "common.h"
+
+namespace MiniEngine
+{
+    // Quadric error edge collapse (Garland and Heckbert, 1997) that only moves vertices onto their neighbours,
+    // so every level of detail indexes the vertex buffer of the full mesh.
+    // Vertices on a uv or normal seam (same position as another vertex) never move, border vertices only slide
+    // along the border. The returned error is the largest distance from a collapsed vertex to the planes of the
+    // faces it came from, in the units of the positions.
+    namespace MeshSimplifier
+    {
+        float simplify(
+            const std::vector<Vertex>&   i_vertices,
+            const std::vector<uint32_t>& i_indices,
+            const size_t                 i_target_index_count,
+            const float                  i_max_error,
+            std::vector<uint32_t>&       o_indices );
+    };
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "common.h"
+
+#include <atomic>
+
+namespace MiniEngine
+{
+    // Unbounded multi producer, single consumer queue without locks, a linked list of nodes behind a stub.
+    // Any thread pushes, the exchange of the head orders the producers and never retries.
+    // Only one thread pops, it returns false when the queue is empty or a push is halfway through,
+    // that item shows up in a later pop.
+    template<typename T>
+    class MpscQueue final
+    {
+    public:
+        MpscQueue() :
+            m_head( new Node() ),
+            m_tail( m_head.load( std::memory_order_relaxed ) )
+        {
+        }
+
+        ~MpscQueue()
+        {
+            T item;
+            while( pop( item ) )
+            {
+            }
+
+            delete m_tail;
+        }
+
+        void push( T i_item )
+        {
+            Node* node = new Node();
+            node->m_item = std::move( i_item );
+
+            //the release store publishes the item to the consumer that loads m_next
+            Node* previous = m_head.exchange( node, std::memory_order_acq_rel );
+            previous->m_next.store( node, std::memory_order_release );
+        }
+
+        bool pop( T& o_item )
+        {
+            Node* next = m_tail->m_next.load( std::memory_order_acquire );
+
+            if( next == nullptr )
+            {
+                return false;
+            }
+
+            //next becomes the stub, its item has been moved out
+            o_item = std::move( next->m_item );
+
+            delete m_tail;
+            m_tail = next;
+
+            return true;
+        }
+
+    private:
+        MpscQueue( const MpscQueue& ) = delete;
+        MpscQueue& operator=(const MpscQueue& ) = delete;
+
+        struct Node
+        {
+            std::atomic<Node*> m_next = { nullptr };
+            T                  m_item = T();
+        };
+
+        std::atomic<Node*> m_head; //last pushed, shared by the producers
+        Node*              m_tail; //stub, consumer only
+    };
+};
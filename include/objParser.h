@@ -0,0 +1,37 @@
+#pragma once
+
+#include "common.h"
+
+namespace MiniEngine
+{
+    class WorkerPool;
+
+    // Wavefront obj reader for the v/vn/vt/f records, the rest of the file is skipped.
+    // The file is mapped and split at line boundaries in chunks that are parsed on the workers, every
+    // chunk into its own arrays. An exclusive scan of the chunk sizes gives where each chunk goes and
+    // the chunks are copied in parallel into the final arrays, resolving the relative (negative) indices.
+    // The output is laid out like tinyobj's attrib_t and index_t: one index per face corner, the faces
+    // in file order and triangulated as a fan.
+    namespace ObjParser
+    {
+        struct Index
+        {
+            int32_t m_vertex_index;
+            int32_t m_normal_index;   //-1 when missing
+            int32_t m_texcoord_index; //-1 when missing
+        };
+
+        struct Mesh
+        {
+            std::vector<float> m_positions; //xyz
+            std::vector<float> m_normals;   //xyz
+            std::vector<float> m_texcoords; //uv
+            std::vector<Index> m_indices;   //three per triangle
+
+            std::vector<uint32_t> m_shapes; //first index of every shape (o and g records), the first is 0
+        };
+
+        // i_workers can be null, the chunks are parsed on the calling thread then
+        bool load( const std::string& i_path, WorkerPool* i_workers, Mesh& o_mesh );
+    };
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "common.h"
+
+namespace MiniEngine
+{
+    struct Runtime;
+
+    // The bytes the hash of a create info was computed on, a hit compares them so two states that collide
+    // on the hash never share a handle
+    struct PipelineStateKey
+    {
+        uint64_t             m_hash;
+        std::vector<uint8_t> m_state;
+
+        bool operator==( const PipelineStateKey& i_other ) const
+        {
+            return m_hash == i_other.m_hash && m_state == i_other.m_state;
+        }
+    };
+
+    struct PipelineStateKeyHash
+    {
+        size_t operator()( const PipelineStateKey& i_key ) const
+        {
+            return static_cast<size_t>( i_key.m_hash );
+        }
+    };
+
+    // Owns the pipelines, pipeline layouts and descriptor set layouts of the passes.
+    // Every object is keyed by the state it was created from, so two passes asking for the same
+    // state get the same handle. Handles are reference counted, a pass releases what it got in its shutdown.
+    // Pipelines are compiled through a VkPipelineCache that is saved to disk on shutdown and loaded back on
+    // initialize when it was written by the same device and driver.
+    // Main thread only, the compilation of a batch is the only part spread over the workers.
+    class PipelineRegistry final
+    {
+    public:
+        PipelineRegistry ( const Runtime& i_runtime );
+        ~PipelineRegistry();
+
+        bool initialize();
+        void shutdown();
+
+        VkDescriptorSetLayout getDescriptorSetLayout    ( const VkDescriptorSetLayoutCreateInfo& i_info );
+        void                  releaseDescriptorSetLayout( VkDescriptorSetLayout i_layout );
+
+        VkPipelineLayout getPipelineLayout    ( const VkPipelineLayoutCreateInfo& i_info );
+        void             releasePipelineLayout( VkPipelineLayout i_layout );
+
+        // o_pipelines keeps the order of i_infos, the ones that are not stored yet are compiled in parallel
+        void       getGraphicsPipelines( const std::vector<VkGraphicsPipelineCreateInfo>& i_infos, std::vector<VkPipeline>& o_pipelines );
+        VkPipeline getGraphicsPipeline ( const VkGraphicsPipelineCreateInfo& i_info );
+        void       releasePipeline     ( VkPipeline i_pipeline );
+
+        VkPipelineCache getPipelineCache() const
+        {
+            return m_pipeline_cache;
+        }
+
+    private:
+        PipelineRegistry( const PipelineRegistry& ) = delete;
+        PipelineRegistry& operator=(const PipelineRegistry& ) = delete;
+
+        template<typename T>
+        struct Entry
+        {
+            T        m_handle;
+            uint32_t m_references;
+        };
+
+        void loadPipelineCache( std::vector<char>& o_data ) const;
+        void savePipelineCache() const;
+
+        VkPipelineCache m_pipeline_cache;
+
+        std::unordered_map<PipelineStateKey, Entry<VkDescriptorSetLayout>, PipelineStateKeyHash> m_descriptor_set_layouts;
+        std::unordered_map<PipelineStateKey, Entry<VkPipelineLayout>, PipelineStateKeyHash>      m_pipeline_layouts;
+        std::unordered_map<PipelineStateKey, Entry<VkPipeline>, PipelineStateKeyHash>            m_pipelines;
+
+        const Runtime& m_runtime;
+    };
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "common.h"
+
+namespace MiniEngine
+{
+    // Best fit free list over a range of elements, it only hands out offsets, the memory lives somewhere else.
+    // The free blocks are kept twice, by offset to merge a freed block with its neighbours and by size to
+    // find the smallest one that fits, so both allocate and free are logarithmic in the number of blocks.
+    class RangeAllocator final
+    {
+    public:
+        static constexpr uint32_t kINVALID_OFFSET = std::numeric_limits<uint32_t>::max();
+
+        explicit RangeAllocator( const uint32_t i_size = 0 );
+        ~RangeAllocator() = default;
+
+        void reset( const uint32_t i_size );
+
+        // kINVALID_OFFSET when no free block is large enough
+        uint32_t allocate( const uint32_t i_size );
+        void     free    ( const uint32_t i_offset, const uint32_t i_size );
+
+        uint32_t getSize() const
+        {
+            return m_size;
+        }
+
+        uint32_t getFreeSize() const
+        {
+            return m_free_size;
+        }
+
+        uint32_t getLargestFreeBlock() const
+        {
+            return m_blocks_by_size.empty() ? 0 : m_blocks_by_size.rbegin()->first;
+        }
+
+    private:
+        void insertBlock( const uint32_t i_offset, const uint32_t i_size );
+        void eraseBlock ( std::map<uint32_t, uint32_t>::iterator i_block );
+
+        std::map<uint32_t, uint32_t>      m_blocks_by_offset; //offset -> size
+        std::multimap<uint32_t, uint32_t> m_blocks_by_size;   //size -> offset
+
+        uint32_t m_size;
+        uint32_t m_free_size;
+    };
+};
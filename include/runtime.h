@@ -7,31 +7,38 @@ namespace MiniEngine
 {
     class MeshRegistry;
     class ShaderRegistry;
+    class PipelineRegistry;
     class Engine;
     class RendererVK;
+    class FrameAllocatorVK;
+    class CommandRecorderVK;
+    class GeometryPoolVK;
 
     struct Runtime
     {
         std::unique_ptr<RendererVK>     m_renderer;
         std::unique_ptr<ShaderRegistry> m_shader_registry;
         std::unique_ptr<MeshRegistry>   m_mesh_registry;
+
+        //the vertex and index buffers every mesh is sub-allocated from
+        std::unique_ptr<GeometryPoolVK> m_geometry_pool;
+
+        //pipelines and layouts shared between passes, backed by the on disk pipeline cache
+        std::unique_ptr<PipelineRegistry> m_pipeline_registry;
+
+        //per thread command pools and the workers the passes record on
+        std::unique_ptr<CommandRecorderVK> m_command_recorder;
         
 
-        inline const std::array<VkBuffer, kMAX_NUMBER_OF_FRAMES> getPerFrameBuffer() const
-        {
-            return m_per_frame_buffer;
-        }
+        //one upload buffer per in-flight frame, PerFrameData lives inside at the dynamic offsets of the Frame
+        const std::array<VkBuffer, kMAX_NUMBER_OF_FRAMES> getUploadBuffer() const;
 
-        inline const std::array<VkBuffer, kMAX_NUMBER_OF_FRAMES> getPerObjectBuffer() const
+        //device local, only the dirty PerObjectData ranges are copied into it
+        inline VkBuffer getPerObjectBuffer() const
         {
             return m_per_object_buffer;
         }
 
-        inline const std::array<VkBuffer, kMAX_NUMBER_OF_FRAMES> getKernelBuffer() const
-        {
-            return m_kernel_buffer;
-        }
-
 
     private:
         explicit Runtime() = default;
@@ -43,14 +50,10 @@ namespace MiniEngine
         void createResources();
         void freeResources  ();
 
-        std::array<VkBuffer      , kMAX_NUMBER_OF_FRAMES> m_per_frame_buffer        = { VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE};
-        std::array<VkDeviceMemory, kMAX_NUMBER_OF_FRAMES> m_per_frame_buffer_memory;
-
-        std::array<VkBuffer       , kMAX_NUMBER_OF_FRAMES> m_per_object_buffer = { VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE };
-        std::array<VkDeviceMemory, kMAX_NUMBER_OF_FRAMES> m_per_object_buffer_memory;
+        std::array<std::unique_ptr<FrameAllocatorVK>, kMAX_NUMBER_OF_FRAMES> m_frame_allocator;
 
-        std::array<VkBuffer, kMAX_NUMBER_OF_FRAMES> m_kernel_buffer = { VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE };
-        std::array<VkDeviceMemory, kMAX_NUMBER_OF_FRAMES> m_kernel_buffer_mem;
+        VkBuffer       m_per_object_buffer        = VK_NULL_HANDLE;
+        VkDeviceMemory m_per_object_buffer_memory = VK_NULL_HANDLE;
 
         friend class Engine;
     };
@@ -23,6 +23,12 @@ namespace MiniEngine
         Matrix4f getTransform();
         Matrix4f getInverseTransform() ;
 
+        //bumped on every modification, lets the owner know when the gpu copy is stale
+        uint32_t getGeneration() const
+        {
+            return m_generation;
+        }
+
         void translate( const Vector3f& i_translation );
         void rotate   ( const RotAxis&  i_rotation    );
         void scale    ( const Vector3f& i_scale       );
@@ -34,6 +40,7 @@ namespace MiniEngine
 
     private:
         bool m_dirty;
+        uint32_t m_generation;
         Matrix4f m_transform_matrix;
         Matrix4f m_inverse_transform;
     };
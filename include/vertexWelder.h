@@ -0,0 +1,25 @@
+#pragma once
+
+#include "common.h"
+#include "objParser.h"
+
+namespace MiniEngine
+{
+    class WorkerPool;
+
+    // Turns the face corners of a parsed obj into an indexed mesh.
+    // Corners are the same vertex when their position, normal and uv fall in the same cell of an i_epsilon
+    // grid (0 compares the exact values), so split normals and uv seams keep their own vertices.
+    // Every shape is welded on its own on the workers, through an open addressing table sized from its corner
+    // count, and the shapes are concatenated afterwards. The first corner of a vertex gives its values.
+    namespace VertexWelder
+    {
+        void weld(
+            const ObjParser::Mesh& i_mesh,
+            const float            i_epsilon,
+            WorkerPool*            i_workers,
+            std::vector<Vertex>&   o_vertices,
+            std::vector<uint32_t>& o_indices,
+            MeshBounds&            o_bounds );
+    };
+};
@@ -21,6 +21,7 @@ namespace MiniEngine
         bool            initialize() override;
         void            shutdown() override;
         VkCommandBuffer draw(const Frame& i_frame) override;
+        void            resize() override;
 
     private:
         AmbientOcclusionBlurVK(const AmbientOcclusionBlurVK&) = delete;
@@ -31,6 +32,7 @@ namespace MiniEngine
         void createPipelines();
         void createDescriptorLayout();
         void createDescriptors();
+        void updateDescriptors();
 
         struct DescriptorsSets
         {
@@ -38,7 +40,6 @@ namespace MiniEngine
         };
 
         VkRenderPass                   m_render_pass;
-        std::array<VkCommandBuffer, 3> m_command_buffer;
         std::array<VkFramebuffer, 3> m_fbos;
 
         // prepare the different render supported depending on the material
@@ -51,8 +52,9 @@ namespace MiniEngine
 
         MeshVKPtr m_plane;
 
-        ImageBlock m_ssao_attachment;
-        ImageBlock m_ssao_blur_attachment;
+        //attachments of the engine, recreated in place when the window is resized
+        const ImageBlock& m_ssao_attachment;
+        const ImageBlock& m_ssao_blur_attachment;
 
     };
 };
\ No newline at end of file
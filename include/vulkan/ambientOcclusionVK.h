@@ -11,17 +11,27 @@ namespace MiniEngine
     class AmbientOcclusionVK final : public RenderPassVK
     {
     public:
+        // Distribucion de las muestras del kernel dentro del hemisferio
+        enum class KernelDistribution
+        {
+            Random,   // uniform random directions, same as the original per frame kernel
+            Poisson   // best candidate directions, blue noise like coverage with fewer samples
+        };
+
         AmbientOcclusionVK(
             const Runtime& i_runtime,
             const ImageBlock& i_in_normal_attachment,
             const ImageBlock& i_in_position_attachment,
-            const ImageBlock& i_ssao_attachment
+            const ImageBlock& i_ssao_attachment,
+            const uint32_t i_kernel_size = kSSAO_KERNEL_SIZE,
+            const KernelDistribution i_kernel_distribution = KernelDistribution::Random
         );
         virtual ~AmbientOcclusionVK();
 
         bool            initialize() override;
         void            shutdown() override;
         VkCommandBuffer draw(const Frame& i_frame) override;
+        void            resize() override;
 
     private:
         AmbientOcclusionVK(const AmbientOcclusionVK&) = delete;
@@ -32,6 +42,8 @@ namespace MiniEngine
         void createPipelines();
         void createDescriptorLayout();
         void createDescriptors();
+        void updateDescriptors();
+        void createKernel();
 
         struct DescriptorsSets
         {
@@ -39,7 +51,6 @@ namespace MiniEngine
         };
 
         VkRenderPass                   m_render_pass;
-        std::array<VkCommandBuffer, 3> m_command_buffer;
         std::array<VkFramebuffer, 3> m_fbos;
 
         // prepare the different render supported depending on the material
@@ -55,8 +66,15 @@ namespace MiniEngine
         //Textura de ruido de SSAO
         ImageBlock m_text_noise;
 
-        ImageBlock m_in_position_depth_attachment;
-        ImageBlock m_in_normal_attachment;
-        ImageBlock m_ssao_attachment;
+        //Kernel de SSAO, generated once at initialize and never written again
+        uint32_t           m_kernel_size;
+        KernelDistribution m_kernel_distribution;
+        VkBuffer           m_kernel_buffer;
+        VkDeviceMemory     m_kernel_memory;
+
+        //attachments of the engine, recreated in place when the window is resized
+        const ImageBlock& m_in_position_depth_attachment;
+        const ImageBlock& m_in_normal_attachment;
+        const ImageBlock& m_ssao_attachment;
     };
 };
\ No newline at end of file
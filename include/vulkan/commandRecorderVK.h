@@ -0,0 +1,89 @@
+#pragma once
+
+#include "common.h"
+#include "workerPool.h"
+
+namespace MiniEngine
+{
+    class DeviceVK;
+
+    // Records command buffers from several threads.
+    // Every thread (the main one is index 0, the workers go after it) owns one command pool per in-flight
+    // frame, so no pool is ever touched by two threads. The pools of a slot are reset as a whole in
+    // beginFrame, once its timeline value has been waited, and the command buffers allocated from them are reused.
+    // In record once mode the pools of a slot are only reset after invalidateCache, so what was recorded
+    // for it can be submitted again until then.
+    class CommandRecorderVK final
+    {
+    public:
+        explicit CommandRecorderVK( const DeviceVK& i_device );
+        ~CommandRecorderVK();
+
+        void initialize( const uint32_t i_worker_count );
+        void shutdown  ();
+
+        void beginFrame( const uint32_t i_frame_id );
+
+        void setRecordOnce  ( const bool i_record_once );
+        void invalidateCache();
+
+        bool isRecordOnce() const
+        {
+            return m_record_once;
+        }
+
+        //command buffers recorded with a different generation are gone or about to be
+        uint64_t getCacheGeneration() const
+        {
+            return m_cache_generation;
+        }
+
+        // command buffer from the pool of the calling thread, valid until the slot is reused
+        VkCommandBuffer allocate( const uint32_t i_frame_id, const VkCommandBufferLevel i_level );
+
+        // see WorkerPool::parallelFor, the caller records the first chunk
+        void parallelFor( const uint32_t i_count, const uint32_t i_min_chunk, const std::function<void( uint32_t, uint32_t )>& i_job )
+        {
+            m_workers.parallelFor( i_count, i_min_chunk, i_job );
+        }
+
+        // records the buckets (one pipeline each) in parallel secondary command buffers that continue
+        // i_inheritance, the result keeps the order of the buckets and is ready for vkCmdExecuteCommands
+        std::vector<VkCommandBuffer> recordSecondaries(
+            const uint32_t                                                        i_frame_id,
+            const VkCommandBufferInheritanceInfo&                                 i_inheritance,
+            const std::vector<uint32_t>&                                          i_bucket_sizes,
+            const uint32_t                                                        i_min_chunk,
+            const std::function<void( VkCommandBuffer, uint32_t, uint32_t, uint32_t )>& i_record );
+
+        uint32_t getThreadCount() const
+        {
+            return static_cast<uint32_t>( m_pools.size() );
+        }
+
+        WorkerPool& getWorkers()
+        {
+            return m_workers;
+        }
+
+    private:
+        CommandRecorderVK( const CommandRecorderVK& ) = delete;
+        CommandRecorderVK& operator=(const CommandRecorderVK& ) = delete;
+
+        struct ThreadPool
+        {
+            VkCommandPool                               m_pool = VK_NULL_HANDLE;
+            std::array<std::vector<VkCommandBuffer>, 2> m_buffers; //primary and secondary
+            std::array<uint32_t                    , 2> m_used{};
+        };
+
+        const DeviceVK& m_device;
+
+        std::vector<std::array<ThreadPool, kMAX_NUMBER_OF_FRAMES>> m_pools; //[thread][frame], by WorkerPool::getThreadIndex
+        WorkerPool                                                 m_workers;
+
+        bool                                         m_record_once;
+        uint64_t                                     m_cache_generation;
+        std::array<uint64_t, kMAX_NUMBER_OF_FRAMES>  m_slot_generation;
+    };
+};
@@ -26,6 +26,7 @@ namespace MiniEngine
         bool            initialize() override;
         void            shutdown  () override;
         VkCommandBuffer draw      ( const Frame& i_frame ) override;
+        void            resize    () override;
 
     private:
         CompositionPassVK( const CompositionPassVK& ) = delete;
@@ -36,15 +37,15 @@ namespace MiniEngine
         void createPipelines       ();
         void createDescriptorLayout();
         void createDescriptors     ();
+        void updateDescriptors     ();
 
         struct DescriptorsSets
         {
             VkDescriptorSet m_textures_descriptor;
         };
 
-        VkRenderPass                   m_render_pass;
-        std::array<VkCommandBuffer, 3> m_command_buffer;
-        std::array<VkFramebuffer  , 3> m_fbos;
+        VkRenderPass                                       m_render_pass;
+        std::array<VkFramebuffer  , 3                    > m_fbos;
 
         // prepare the different render supported depending on the material
         VkPipeline                                                         m_composition_pipeline;
@@ -56,12 +57,13 @@ namespace MiniEngine
     
         MeshVKPtr m_plane;
 
-        ImageBlock m_in_color_attachment;
-        ImageBlock m_in_position_depth_attachment;
-        ImageBlock m_in_normal_attachment;
-        ImageBlock m_in_material_attachment;
-        ImageBlock m_in_ssao_attachment;
-        ImageBlock m_in_shadow_attachment;
-        std::array<ImageBlock, 3> m_output_swap_images;
+        //attachments of the engine and images of the swap chain, both recreated in place when the window is resized
+        const ImageBlock&                m_in_color_attachment;
+        const ImageBlock&                m_in_position_depth_attachment;
+        const ImageBlock&                m_in_normal_attachment;
+        const ImageBlock&                m_in_material_attachment;
+        const ImageBlock&                m_in_ssao_attachment;
+        const ImageBlock&                m_in_shadow_attachment;
+        const std::array<ImageBlock, 3>& m_output_swap_images;
     };
 };
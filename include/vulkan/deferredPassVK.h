@@ -6,6 +6,7 @@ namespace MiniEngine
 {
     struct Runtime;
     class Entity;
+    class IndirectDrawsVK;
     typedef std::shared_ptr<Entity> EntityPtr;
 
     class DeferredPassVK final : public RenderPassVK
@@ -23,8 +24,10 @@ namespace MiniEngine
         bool            initialize() override;
         void            shutdown  () override;
         VkCommandBuffer draw      ( const Frame& i_frame ) override;
+        void            resize    () override;
 
         void addEntityToDraw( const EntityPtr i_entity ) override;
+        void update( const Frame& i_frame ) override;
 
     private:
         DeferredPassVK( const DeferredPassVK& ) = delete;
@@ -48,23 +51,24 @@ namespace MiniEngine
             VkPipeline                                                         m_pipeline;
             VkPipelineLayout                                                   m_pipeline_layouts;
             std::array<VkDescriptorSetLayout          , 2                    > m_descriptor_set_layout; //2 sets, per frame and per object
-            std::array<DescriptorsSets                , 3                    > m_descriptor_sets;
+            std::array<DescriptorsSets                , kMAX_NUMBER_OF_FRAMES> m_descriptor_sets;
             std::array<VkPipelineShaderStageCreateInfo, 2                    > m_shader_stages;
         };
 
         std::array<MaterialPipeline, 2> m_pipelines; //one by material
        
-        VkRenderPass                   m_render_pass;
-        std::array<VkCommandBuffer, 3> m_command_buffer;
-        std::array<VkFramebuffer  , 3> m_fbos;
-        VkDescriptorPool               m_descriptor_pool;
+        VkRenderPass                                       m_render_pass;
+        std::array<VkFramebuffer  , 3                    > m_fbos;
+        VkDescriptorPool                                   m_descriptor_pool;
 
         std::unordered_map<uint32_t, std::vector<EntityPtr>> m_entities_to_draw;
+        std::unique_ptr<IndirectDrawsVK>                     m_indirect_draws; //null when the device can't draw indirect
 
-        const ImageBlock m_depth_buffer;
-        const ImageBlock m_color_attachment;
-        const ImageBlock m_normals_attachment;
-        const ImageBlock m_position_attachment;
-        const ImageBlock m_material_attachment;
+        //attachments of the engine, recreated in place when the window is resized
+        const ImageBlock& m_depth_buffer;
+        const ImageBlock& m_color_attachment;
+        const ImageBlock& m_normals_attachment;
+        const ImageBlock& m_position_attachment;
+        const ImageBlock& m_material_attachment;
     };
 };
\ No newline at end of file
@@ -5,6 +5,7 @@
 namespace MiniEngine
 {
     class RendererVK;
+    class SubmitQueueVK;
 
     class DeviceVK final
     {
@@ -32,6 +33,28 @@ namespace MiniEngine
             return m_command_pool;
         }
 
+        uint32_t getGraphicsQueueIndex() const
+        {
+            return m_graphics_queue_index;
+        }
+
+        //every submit to the graphics queue goes through it
+        SubmitQueueVK& getSubmitQueue() const
+        {
+            return *m_submit_queue;
+        }
+
+        const VkPhysicalDeviceProperties& getPhysicalDeviceProperties() const
+        {
+            return m_phyisical_device_properties;
+        }
+
+        //every supported feature is enabled on the logical device
+        const VkPhysicalDeviceFeatures& getPhysicalDeviceFeatures() const
+        {
+            return m_physical_device_features;
+        }
+
         uint32_t getMemoryTypeIndex( uint32_t typeBits, VkMemoryPropertyFlags properties ) const;
 
     private:
@@ -49,12 +72,17 @@ namespace MiniEngine
         void destroyCommandPool();
 
         uint32_t getQueueFamilyIndex( VkQueueFlagBits i_queue_flags ) const;
+        uint32_t getTransferQueueFamilyIndex() const;
     
         const RendererVK& m_renderer;
 
         uint32_t                                         m_graphics_queue_index;
         VkCommandPool                                    m_command_pool;
         VkQueue                                          m_graphics_queue;
+        std::unique_ptr<SubmitQueueVK>                   m_submit_queue;
+        uint32_t                                         m_transfer_queue_index; //UINT32_MAX without a transfer only family
+        VkQueue                                          m_transfer_queue;
+        std::unique_ptr<SubmitQueueVK>                   m_transfer_submit_queue;
         VkPhysicalDeviceProperties                       m_phyisical_device_properties;
         VkPhysicalDeviceFeatures                         m_physical_device_features;
         VkPhysicalDeviceMemoryProperties                 m_physical_device_memory_properties;
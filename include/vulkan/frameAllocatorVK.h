@@ -0,0 +1,52 @@
+#pragma once
+
+#include "common.h"
+
+namespace MiniEngine
+{
+    class DeviceVK;
+
+    // Linear allocator over a persistently mapped, host coherent buffer.
+    // One instance per in-flight frame: it is reset once its timeline value has been waited and the
+    // returned offsets are meant to be used as dynamic offsets when binding the descriptors.
+    class FrameAllocatorVK final
+    {
+    public:
+        explicit FrameAllocatorVK( const DeviceVK& i_device );
+        ~FrameAllocatorVK() = default;
+
+        void initialize( const VkDeviceSize i_size, const VkBufferUsageFlags i_usage );
+        void shutdown  ();
+
+        void  reset   ();
+        void* allocate( const VkDeviceSize i_size, const VkDeviceSize i_alignment, uint32_t& o_offset );
+
+        template<typename T>
+        T* allocate( const VkDeviceSize i_alignment, uint32_t& o_offset, const size_t i_count = 1 )
+        {
+            return reinterpret_cast<T*>( allocate( sizeof( T ) * i_count, i_alignment, o_offset ) );
+        }
+
+        VkBuffer getBuffer() const
+        {
+            return m_buffer;
+        }
+
+        VkDeviceSize getUsedBytes() const
+        {
+            return m_head;
+        }
+
+    private:
+        FrameAllocatorVK( const FrameAllocatorVK& ) = delete;
+        FrameAllocatorVK& operator=(const FrameAllocatorVK& ) = delete;
+
+        const DeviceVK& m_device;
+
+        VkBuffer       m_buffer;
+        VkDeviceMemory m_memory;
+        uint8_t*       m_mapped;
+        VkDeviceSize   m_size;
+        VkDeviceSize   m_head;
+    };
+};
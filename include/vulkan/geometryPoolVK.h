@@ -0,0 +1,97 @@
+#pragma once
+
+#include "common.h"
+#include "rangeAllocator.h"
+
+namespace MiniEngine
+{
+    class DeviceVK;
+
+    // Where the vertices and indices of a mesh live inside the GeometryPoolVK, in elements.
+    struct GeometryAllocation
+    {
+        VertexLayout m_layout        = VertexLayout::Full;
+        VkIndexType  m_index_type    = VK_INDEX_TYPE_UINT32;
+        uint32_t     m_vertex_offset = RangeAllocator::kINVALID_OFFSET;
+        uint32_t     m_vertex_count  = 0;
+        uint32_t     m_index_offset  = RangeAllocator::kINVALID_OFFSET;
+        uint32_t     m_index_count   = 0;
+    };
+
+    // Every mesh sub-allocated from a few large device local buffers: one index buffer per index type and,
+    // per vertex layout, the position and attribute streams (created the first time the layout is used).
+    // A pass binds them once and the draws pick their mesh with vertexOffset and firstIndex.
+    // The capacity is fixed, an allocation that doesn't fit comes back invalid and the owner of the meshes
+    // frees some of them before trying again.
+    class GeometryPoolVK final
+    {
+    public:
+        explicit GeometryPoolVK( const DeviceVK& i_device );
+        ~GeometryPoolVK() = default;
+
+        void initialize( const uint32_t i_vertex_capacity, const uint32_t i_index_capacity );
+        void shutdown  ();
+
+        // m_vertex_offset is RangeAllocator::kINVALID_OFFSET when the vertices or the indices don't fit
+        GeometryAllocation allocate( const VertexLayout i_layout, const uint32_t i_vertex_count, const VkIndexType i_index_type, const uint32_t i_index_count );
+        void               free    ( const GeometryAllocation& i_allocation );
+
+        // bytes of the streams of i_layout and of both index buffers
+        VkDeviceSize getCapacity( const VertexLayout i_layout ) const;
+
+        // the streams of i_layout, nothing is bound if no mesh of the layout was ever allocated
+        void bind       ( VkCommandBuffer i_command_buffer, const VertexLayout i_layout, const VertexStreams i_streams ) const;
+        void bindIndices( VkCommandBuffer i_command_buffer, const VkIndexType i_index_type ) const;
+
+        VkBuffer getIndexBuffer( const VkIndexType i_index_type ) const
+        {
+            return m_index_heaps[ getIndexHeap( i_index_type ) ].m_buffer;
+        }
+
+        VkBuffer getPositionsBuffer( const VertexLayout i_layout ) const
+        {
+            return m_vertex_heaps[ static_cast<uint32_t>( i_layout ) ].m_positions_buffer;
+        }
+
+        VkBuffer getAttributesBuffer( const VertexLayout i_layout ) const
+        {
+            return m_vertex_heaps[ static_cast<uint32_t>( i_layout ) ].m_attributes_buffer;
+        }
+
+    private:
+        GeometryPoolVK( const GeometryPoolVK& ) = delete;
+        GeometryPoolVK& operator=(const GeometryPoolVK& ) = delete;
+
+        struct VertexHeap
+        {
+            VkBuffer       m_positions_buffer  = VK_NULL_HANDLE;
+            VkBuffer       m_attributes_buffer = VK_NULL_HANDLE;
+            VkDeviceMemory m_positions_memory  = VK_NULL_HANDLE;
+            VkDeviceMemory m_attributes_memory = VK_NULL_HANDLE;
+            RangeAllocator m_allocator;
+        };
+
+        struct IndexHeap
+        {
+            VkBuffer       m_buffer = VK_NULL_HANDLE;
+            VkDeviceMemory m_memory = VK_NULL_HANDLE;
+            RangeAllocator m_allocator;
+        };
+
+        void createVertexHeap( const VertexLayout i_layout );
+
+        static uint32_t getIndexHeap( const VkIndexType i_index_type )
+        {
+            assert( i_index_type == VK_INDEX_TYPE_UINT16 || i_index_type == VK_INDEX_TYPE_UINT32 );
+            return i_index_type == VK_INDEX_TYPE_UINT16 ? 0 : 1;
+        }
+
+        const DeviceVK& m_device;
+
+        uint32_t m_vertex_capacity;
+        uint32_t m_index_capacity;
+
+        std::array<IndexHeap , 2> m_index_heaps;  //16 and 32 bit
+        std::array<VertexHeap, 2> m_vertex_heaps; //by VertexLayout
+    };
+};
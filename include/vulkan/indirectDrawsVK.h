@@ -0,0 +1,69 @@
+#pragma once
+
+#include "common.h"
+
+namespace MiniEngine
+{
+    class DeviceVK;
+    class GeometryPoolVK;
+    class Entity;
+    enum class LodTarget : uint32_t;
+    typedef std::shared_ptr<Entity> EntityPtr;
+
+    // VkDrawIndexedIndirectCommands of a geometry pass, one persistently mapped buffer per in-flight frame.
+    // update writes the commands of every entity every frame, bucket after bucket (one bucket per material
+    // pipeline) and inside a bucket the 16 bit index meshes before the 32 bit ones, so a recorded
+    // vkCmdDrawIndexedIndirect keeps pointing at the right commands as long as the entity lists don't change.
+    // A change of level of detail only rewrites the commands.
+    class IndirectDrawsVK final
+    {
+    public:
+        explicit IndirectDrawsVK( const DeviceVK& i_device, const GeometryPoolVK& i_geometry_pool );
+        ~IndirectDrawsVK() = default;
+
+        void initialize();
+        void shutdown  ();
+
+        // the timeline value of i_frame_id must have been waited, the gpu reads the commands of the slot.
+        // The buffer of a slot is sized by its first update and recreated when the entity lists outgrow it,
+        // a new buffer means new commands so the cache of recorded command buffers must have been invalidated
+        void update( const uint32_t i_frame_id, const std::unordered_map<uint32_t, std::vector<EntityPtr>>& i_buckets, const uint32_t i_bucket_count, const LodTarget i_target );
+
+        // every command of i_bucket, binding the index buffer of each index type, firstInstance is the PerObjectData index
+        void draw( VkCommandBuffer i_command_buffer, const uint32_t i_frame_id, const uint32_t i_bucket ) const;
+
+        // kINDIRECT_DRAWS and a device where firstInstance reaches gl_BaseInstance
+        static bool isSupported( const DeviceVK& i_device );
+
+    private:
+        IndirectDrawsVK( const IndirectDrawsVK& ) = delete;
+        IndirectDrawsVK& operator=(const IndirectDrawsVK& ) = delete;
+
+        struct Slot
+        {
+            VkBuffer                      m_buffer   = VK_NULL_HANDLE;
+            VkDeviceMemory                m_memory   = VK_NULL_HANDLE;
+            VkDrawIndexedIndirectCommand* m_mapped   = nullptr;
+            uint32_t                      m_capacity = 0;
+        };
+
+        struct Bucket
+        {
+            uint32_t m_offset      = 0; //first command
+            uint32_t m_short_count = 0; //16 bit index commands, the 32 bit ones follow
+            uint32_t m_count       = 0;
+        };
+
+        void createSlot ( Slot& io_slot, const uint32_t i_capacity );
+        void destroySlot( Slot& io_slot );
+        void drawRange  ( VkCommandBuffer i_command_buffer, VkBuffer i_buffer, const uint32_t i_offset, const uint32_t i_count ) const;
+
+        const DeviceVK&       m_device;
+        const GeometryPoolVK& m_geometry_pool;
+
+        std::array<Slot, kMAX_NUMBER_OF_FRAMES> m_slots;
+        std::vector<Bucket>                     m_buckets;
+
+        bool m_multi_draw; //without multiDrawIndirect every command is its own call
+    };
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common.h"
+#include "vulkan/geometryPoolVK.h"
 
 
 namespace MiniEngine
@@ -10,32 +11,115 @@ namespace MiniEngine
     class MeshVK final
     {
     public:
-        explicit MeshVK( const Runtime& i_runtime, const std::string& i_path, const std::vector<uint32_t> i_indices, const std::vector<Vertex> i_vertices );
+        explicit MeshVK( const Runtime& i_runtime, const std::string& i_path, const VertexLayout i_layout );
         ~MeshVK() = default;
     
-        bool initialize();
+        // false, with nothing uploaded, when the mesh doesn't fit in the geometry pool
+        bool initialize( const MeshData& i_data );
         void shutdown();
 
-        void draw( VkCommandBuffer& i_command_buffer, const uint32_t i_instance_id );
+        // the geometry pool streams of the layout must be bound, see GeometryPoolVK::bind, the indices are bound here
+        void draw( VkCommandBuffer& i_command_buffer, const uint32_t i_instance_id, const uint32_t i_lod = 0 );
+
+        // the same draws for vkCmdDrawIndexedIndirect, getDrawCount of them over the index buffer of getIndexType.
+        // Every level writes the same count, the ones with fewer chunks pad with empty draws
+        void getDrawCommands( const uint32_t i_instance_id, const uint32_t i_lod, VkDrawIndexedIndirectCommand* o_commands ) const;
+
+        uint32_t getDrawCount() const
+        {
+            return m_chunks_per_lod;
+        }
+
+        VkIndexType getIndexType() const
+        {
+            return m_allocation.m_index_type;
+        }
+
+        // false until initialize, an asynchronous load hands out the mesh before that
+        bool isResident() const
+        {
+            return m_allocation.m_vertex_offset != RangeAllocator::kINVALID_OFFSET;
+        }
+
+        // what the mesh takes in the geometry pool, 0 when it is not resident
+        VkDeviceSize getByteSize() const;
+
+        // last frame something held the mesh, for the eviction of the registry
+        void markUsed( const uint64_t i_frame )
+        {
+            m_last_used_frame = i_frame;
+        }
+
+        uint64_t getLastUsedFrame() const
+        {
+            return m_last_used_frame;
+        }
+
+        // value of the graphics timeline whose submit carries, or acquires from the transfer queue, the copies of initialize
+        uint64_t getUploadValue() const
+        {
+            return m_upload_value;
+        }
+
+        // the coarsest level whose error, at i_pixels_per_unit, stays within i_max_pixel_error
+        uint32_t selectLod( const float i_pixels_per_unit, const float i_max_pixel_error ) const;
+
+        const MeshBounds& getBounds() const
+        {
+            return m_bounds;
+        }
+
+        // goes after the model matrix, identity unless the vertices are packed
+        const Matrix4f& getDequantization() const
+        {
+            return m_dequantization;
+        }
+
+        // vertex input and vertex shader of the pipelines that draw meshes of i_layout reading i_streams
+        static void        getVertexInput ( const VertexLayout i_layout, const VertexStreams i_streams, std::vector<VkVertexInputBindingDescription>& o_bindings, std::vector<VkVertexInputAttributeDescription>& o_attributes );
+        static const char* getVertexShader( const VertexLayout i_layout, const VertexStreams i_streams = VertexStreams::All );
+
+        // bytes per vertex of each stream
+        static uint32_t getPositionStride  ( const VertexLayout i_layout );
+        static uint32_t getAttributesStride( const VertexLayout i_layout );
 
     private:
         MeshVK( const MeshVK& ) = delete;
         MeshVK& operator=(const MeshVK& ) = delete;
 
-        VkBuffer createVertexBuffer( const std::vector<Vertex>& i_data, VkDeviceMemory& i_memory );
-        void createIndexBuffer ();
+        // a run of triangles of one level whose vertices fit in 16 bit indices relative to m_base_vertex
+        struct IndexChunk
+        {
+            uint32_t m_index_offset;
+            uint32_t m_index_count;
+            uint32_t m_base_vertex;
+        };
+
+        // false when a single triangle spans more vertices than a 16 bit index reaches
+        bool createChunks      ( const MeshData& i_data, const bool i_split );
+        void createVertexBuffer( const MeshData& i_data );
+        void createIndexBuffer ( const MeshData& i_data );
+
+        VkDrawIndexedIndirectCommand getChunkCommand( const uint32_t i_instance_id, const IndexChunk& i_chunk ) const;
 
         const Runtime& m_runtime;
 
         std::string m_path;
 
-        std::vector<uint32_t> m_indices;
-        std::vector<Vertex>   m_vertices;
+        uint32_t             m_index_count;
+        uint32_t             m_vertex_count;
+        MeshBounds           m_bounds;
+        std::vector<MeshLod> m_lods; //full mesh first
+        VertexLayout         m_layout;
+        Matrix4f             m_dequantization;
+
+        GeometryAllocation   m_allocation;       //vertices and indices inside the geometry pool
+
+        std::vector<IndexChunk> m_chunks;         //m_chunks_per_lod per level, full mesh first
+        uint32_t                m_chunks_per_lod;
 
-        VkBuffer                                       m_indices_buffer;
-        VkBuffer                                       m_data_buffer;
-        VkDeviceMemory                                 m_indices_memory;
-        VkDeviceMemory                                 m_data_memory;
+        uint64_t m_last_used_frame;
+        uint64_t m_upload_value;
     
     };
 };
\ No newline at end of file
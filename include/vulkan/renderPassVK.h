@@ -22,10 +22,25 @@ namespace MiniEngine
         virtual void            shutdown  () = 0;
         virtual VkCommandBuffer draw      ( const Frame& ) = 0;
 
+        // draw, or in record once mode the command buffer already recorded for this frame slot and
+        // swap chain image, as long as the cache of the recorder has not been invalidated since
+        VkCommandBuffer record( const Frame& i_frame );
+
+        // every frame before record, replayed or not: what the recorded commands read from per frame buffers
+        virtual void update( const Frame& )
+        {
+        }
+
         virtual void addEntityToDraw( const EntityPtr i_entity )
         {
         }
 
+        // the window and the attachments that depend on its size have been recreated, the pass rebuilds
+        // what points at them (framebuffers, descriptor writes). Render pass and pipelines are kept
+        virtual void resize()
+        {
+        }
+
     protected:
         const Runtime& m_runtime;
         const std::shared_ptr<RenderPassVK> m_prev_render_pass;
@@ -33,5 +48,14 @@ namespace MiniEngine
     private:
         RenderPassVK( const RenderPassVK& ) = delete;
         RenderPassVK& operator=(const RenderPassVK& ) = delete;
+
+        struct CachedCommandBuffer
+        {
+            VkCommandBuffer m_command_buffer   = VK_NULL_HANDLE;
+            uint64_t        m_generation       = 0;
+            uint32_t        m_per_frame_offset = 0; //baked as dynamic offset
+        };
+
+        std::array<std::array<CachedCommandBuffer, kMAX_NUMBER_OF_SWAPCHAIN_IMAGES>, kMAX_NUMBER_OF_FRAMES> m_cached_command_buffers;
     };
 };
\ No newline at end of file
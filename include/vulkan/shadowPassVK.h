@@ -6,6 +6,7 @@ namespace MiniEngine
 {
     struct Runtime;
     class Entity;
+    class IndirectDrawsVK;
     typedef std::shared_ptr<Entity> EntityPtr;
 
     class ShadowPassVK final : public RenderPassVK
@@ -23,6 +24,7 @@ namespace MiniEngine
         VkCommandBuffer draw(const Frame& i_frame) override;
 
         void addEntityToDraw(const EntityPtr i_entity) override;
+        void update(const Frame& i_frame) override;
 
     private:
         ShadowPassVK(const ShadowPassVK&) = delete;
@@ -46,18 +48,18 @@ namespace MiniEngine
             VkPipeline                                                         m_pipeline;
             VkPipelineLayout                                                   m_pipeline_layouts;
             std::array<VkDescriptorSetLayout, 2>                               m_descriptor_set_layout; // Dos sets: per frame y per object.
-            std::array<DescriptorsSets, 3>                                     m_descriptor_sets;
+            std::array<DescriptorsSets, kMAX_NUMBER_OF_FRAMES>                 m_descriptor_sets;
             std::array<VkPipelineShaderStageCreateInfo, 2>                     m_shader_stages;
         };
 
         std::array<MaterialPipeline, 2> m_pipelines; // Uno por cada tipo de material 
 
         VkRenderPass                   m_render_pass;
-        std::array<VkCommandBuffer, 3> m_command_buffer;
         std::array<VkFramebuffer, 3>   m_fbos;
         VkDescriptorPool               m_descriptor_pool;
 
         std::unordered_map<uint32_t, std::vector<EntityPtr>> m_entities_to_draw;
+        std::unique_ptr<IndirectDrawsVK>                     m_indirect_draws; //null when the device can't draw indirect
 
         ImageBlock m_shadow_depth_buffer;
 
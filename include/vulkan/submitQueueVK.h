@@ -0,0 +1,119 @@
+#pragma once
+
+#include "common.h"
+
+#include <deque>
+
+namespace MiniEngine
+{
+    class DeviceVK;
+    class UploadBatcherVK;
+
+    // Submission layer of a queue (graphics, or transfer when the device has one) built on a timeline semaphore.
+    // Every vkQueueSubmit signals the next value of the timeline, so the cpu can wait on the exact point
+    // it needs (a frame slot, an upload) instead of on fences or on the whole queue.
+    // Uploads are recorded in their own command buffers and go in front of the next submit, the
+    // staging resources handed with releaseBuffer are destroyed once that submit has been reached.
+    // Most uploads should go through the UploadBatcherVK of the graphics queue, whose open batch is closed
+    // by every submit. A transfer queue gets no batcher, the one of the graphics queue submits to it.
+    // Uploads and releases are main thread only, like the command pool behind them.
+    class SubmitQueueVK final
+    {
+    public:
+        explicit SubmitQueueVK( const DeviceVK& i_device );
+        ~SubmitQueueVK();
+
+        void initialize( const VkQueue i_queue, const uint32_t i_queue_family );
+        void shutdown  ();
+
+        // batched uploads for this queue, copied on i_transfer_queue when there is one
+        void createUploadBatcher( SubmitQueueVK* i_transfer_queue );
+
+        VkCommandBuffer beginUpload();
+        void            endUpload  ( VkCommandBuffer i_command_buffer );
+
+        void releaseBuffer( const VkBuffer i_buffer, const VkDeviceMemory i_memory );
+
+        // the next submit waits at i_stage until i_timeline (another queue's) reaches i_value
+        void addWait( const VkSemaphore i_timeline, const uint64_t i_value, const VkPipelineStageFlags i_stage );
+
+        // pending uploads followed by i_command_buffers in one submit, returns the value it signals.
+        // The binary semaphores are for the swap chain, which can't use timeline semaphores
+        uint64_t submit(
+            const std::vector<VkCommandBuffer>& i_command_buffers,
+            const VkSemaphore                   i_wait_semaphore = VK_NULL_HANDLE,
+            const VkPipelineStageFlags          i_wait_stage     = 0,
+            const VkSemaphore                   i_signal_semaphore = VK_NULL_HANDLE );
+
+        // pending uploads alone, nothing is submitted if there are none
+        uint64_t flush();
+
+        void     wait             ( const uint64_t i_value ) const;
+        uint64_t getCompletedValue() const;
+
+        uint64_t getSubmittedValue() const
+        {
+            return m_submitted_value;
+        }
+
+        VkSemaphore getTimeline() const
+        {
+            return m_timeline;
+        }
+
+        uint32_t getQueueFamily() const
+        {
+            return m_queue_family;
+        }
+
+        bool hasPendingUploads() const;
+
+        UploadBatcherVK& getUploadBatcher() const
+        {
+            return *m_upload_batcher;
+        }
+
+    private:
+        SubmitQueueVK( const SubmitQueueVK& ) = delete;
+        SubmitQueueVK& operator=(const SubmitQueueVK& ) = delete;
+
+        struct StagingBuffer
+        {
+            VkBuffer       m_buffer;
+            VkDeviceMemory m_memory;
+        };
+
+        struct TimelineWait
+        {
+            VkSemaphore          m_timeline;
+            uint64_t             m_value;
+            VkPipelineStageFlags m_stage;
+        };
+
+        template<typename T>
+        struct Retired
+        {
+            uint64_t m_value;
+            T        m_resource;
+        };
+
+        void collect();
+
+        const DeviceVK& m_device;
+
+        VkQueue       m_queue;
+        uint32_t      m_queue_family;
+        VkSemaphore   m_timeline;
+        VkCommandPool m_upload_pool;
+        uint64_t      m_submitted_value;
+
+        std::unique_ptr<UploadBatcherVK> m_upload_batcher;
+
+        std::vector<VkCommandBuffer> m_pending_uploads;
+        std::vector<StagingBuffer>   m_pending_releases;
+        std::vector<TimelineWait>    m_pending_waits;
+
+        std::deque<Retired<VkCommandBuffer>> m_retired_uploads;
+        std::deque<Retired<StagingBuffer>>   m_retired_releases;
+    };
+};
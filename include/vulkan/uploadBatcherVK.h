@@ -0,0 +1,101 @@
+#pragma once
+
+#include "common.h"
+
+#include <deque>
+
+namespace MiniEngine
+{
+    class DeviceVK;
+    class SubmitQueueVK;
+
+    // Where the data of an upload is written before its copy is recorded.
+    struct StagingRegion
+    {
+        VkBuffer     m_buffer = VK_NULL_HANDLE;
+        VkDeviceSize m_offset = 0;
+        void*        m_data   = nullptr;
+    };
+
+    // Buffer and image uploads through one persistently mapped staging ring.
+    // The copies of a batch are recorded in a single command buffer that goes in front of the next submit
+    // of the graphics SubmitQueueVK, and the ring space of the batch is reused once the copies have run.
+    // With a transfer queue the batch is submitted there instead, ending with release barriers that hand
+    // the destinations to the graphics family, and the graphics submit waits for it and acquires them.
+    // A full ring submits the open batch and waits for the oldest one, an upload larger than the whole ring
+    // gets a staging buffer of its own. Main thread only, like the SubmitQueueVK it records for.
+    class UploadBatcherVK final
+    {
+    public:
+        explicit UploadBatcherVK( const DeviceVK& i_device, SubmitQueueVK& i_graphics_queue, SubmitQueueVK* i_transfer_queue );
+        ~UploadBatcherVK() = default;
+
+        void initialize( const VkDeviceSize i_ring_size );
+        void shutdown  ();
+
+        // room for i_size bytes, written by the caller before the copies that read them are recorded.
+        // Those copies go before the next stage, which may submit the batch and reuse older regions
+        StagingRegion stage( const VkDeviceSize i_size, const VkDeviceSize i_alignment = kUPLOAD_ALIGNMENT );
+
+        void copyToBuffer( const StagingRegion& i_region, const VkDeviceSize i_size, VkBuffer i_dst_buffer, const VkDeviceSize i_dst_offset = 0 );
+
+        // i_copy.bufferOffset is relative to the region, the image goes from undefined to i_final_layout
+        void copyToImage( const StagingRegion& i_region, VkImage i_image, const VkBufferImageCopy& i_copy, const VkImageSubresourceRange& i_range, const VkImageLayout i_final_layout );
+
+        // stage plus copyToBuffer for data that is already in memory
+        void upload( const void* i_data, const VkDeviceSize i_size, VkBuffer i_dst_buffer, const VkDeviceSize i_dst_offset = 0 );
+
+        // called by the SubmitQueueVK right before the submit that will signal i_value
+        void close( const uint64_t i_value );
+
+        bool isOpen() const
+        {
+            return m_command_buffer != VK_NULL_HANDLE || !m_dedicated.empty();
+        }
+
+    private:
+        UploadBatcherVK( const UploadBatcherVK& ) = delete;
+        UploadBatcherVK& operator=(const UploadBatcherVK& ) = delete;
+
+        struct Batch
+        {
+            uint64_t     m_value; //timeline value, of m_copy_queue, of the submit that carries it
+            VkDeviceSize m_end;   //ring position after its last region
+        };
+
+        struct StagingBuffer
+        {
+            VkBuffer       m_buffer;
+            VkDeviceMemory m_memory;
+        };
+
+        VkCommandBuffer getCommandBuffer();
+        VkDeviceSize    reserve         ( const VkDeviceSize i_size, const VkDeviceSize i_alignment );
+
+        bool isTransfer() const
+        {
+            return &m_copy_queue != &m_graphics_queue;
+        }
+
+        const DeviceVK& m_device;
+        SubmitQueueVK&  m_graphics_queue;
+        SubmitQueueVK&  m_copy_queue;     //the transfer queue when there is one, the graphics queue otherwise
+
+        VkBuffer       m_ring_buffer;
+        VkDeviceMemory m_ring_memory;
+        uint8_t*       m_ring_data;
+        VkDeviceSize   m_ring_size;
+
+        //positions grow without wrapping, the offset inside the ring is position % m_ring_size
+        VkDeviceSize m_head;
+        VkDeviceSize m_tail;
+
+        VkCommandBuffer            m_command_buffer; //open batch, null when nothing was recorded since the last submit
+        std::vector<StagingBuffer> m_dedicated;      //oversized uploads of the open batch
+        std::deque<Batch>          m_batches;        //submitted, still holding ring space
+
+        //queue family ownership transfers of the open batch, recorded as release and as acquire
+        std::vector<VkBufferMemoryBarrier> m_buffer_barriers;
+        std::vector<VkImageMemoryBarrier>  m_image_barriers;
+    };
+};
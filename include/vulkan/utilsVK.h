@@ -25,6 +25,9 @@ namespace MiniEngine
 
         void endRegion(VkCommandBuffer i_cmd_buffer);
 
+        // viewport and scissor covering i_width x i_height, for pipelines that take them as dynamic state
+        void setViewport(VkCommandBuffer i_cmd_buffer, uint32_t i_width, uint32_t i_height);
+
         bool getSupportedDepthFormat( VkPhysicalDevice i_physical_device, VkFormat* i_depth_format );
 
         VkShaderModule loadShader( const std::string i_filename, const VkDevice i_device );
@@ -32,6 +35,9 @@ namespace MiniEngine
         void createBuffer( const DeviceVK& i_device, VkDeviceSize i_size, VkBufferUsageFlags i_usage, VkMemoryPropertyFlags i_properties, VkBuffer& o_buffer, VkDeviceMemory& o_buffer_memory );
 
         void copyBuffer( const DeviceVK& i_device, VkBuffer i_src_buffer, VkBuffer i_dst_buffer, VkDeviceSize i_size );
+
+        // copy through the staging ring of the upload batcher, it runs with the next submit of the graphics queue
+        void uploadBuffer( const DeviceVK& i_device, const void* i_data, VkDeviceSize i_size, VkBuffer i_dst_buffer, VkDeviceSize i_dst_offset = 0 );
         
         void setImageLayout( VkCommandBuffer i_cmd_buffer, VkImage i_image, VkImageLayout i_old_image_layout, VkImageLayout i_new_image_layout, VkImageSubresourceRange i_subresource_range, VkPipelineStageFlags isrc_stage_mask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VkPipelineStageFlags i_dst_stage_mask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
    
@@ -30,7 +30,8 @@ namespace MiniEngine
             return m_color_space;
         }
 
-        std::array<ImageBlock, 3> getSwapChainImages() const
+        //refilled in place when the swap chain is recreated
+        const std::array<ImageBlock, 3>& getSwapChainImages() const
         {
             return m_swap_chain_images;
         }
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace MiniEngine
+{
+    // Threads that run the chunks of parallelFor and the jobs given to post.
+    // A thread waiting in parallelFor runs queued jobs of its own pool meanwhile, so a job can fan out again on the
+    // pool it runs on. Two pools never run each other's jobs, the render workers don't pick up the work of the loaders.
+    class WorkerPool final
+    {
+    public:
+        WorkerPool ();
+        ~WorkerPool();
+
+        void initialize( const uint32_t i_worker_count );
+        // the queued jobs are run before the workers leave
+        void shutdown  ();
+
+        // splits [0, i_count) in chunks of at least i_min_chunk elements and runs them on the workers.
+        // The caller runs the first chunk and keeps running queued jobs until all of them are done,
+        // so it can be called again from inside a job without blocking the pool.
+        void parallelFor( const uint32_t i_count, const uint32_t i_min_chunk, const std::function<void( uint32_t, uint32_t )>& i_job );
+
+        // runs i_job on a worker without waiting for it, on the calling thread when there are no workers.
+        // Nothing catches what it throws
+        void post( std::function<void()> i_job );
+
+        // the workers and the calling thread
+        uint32_t getThreadCount() const
+        {
+            return static_cast<uint32_t>( m_workers.size() ) + 1;
+        }
+
+        // 0 for any thread that is not a worker, 1..n for the workers of a pool
+        static uint32_t getThreadIndex();
+
+    private:
+        WorkerPool( const WorkerPool& ) = delete;
+        WorkerPool& operator=(const WorkerPool& ) = delete;
+
+        void workerLoop( const uint32_t i_thread_index );
+        bool runPendingJob();
+
+        std::vector<std::thread> m_workers;
+
+        std::deque<std::function<void()>> m_jobs;
+        std::mutex                        m_jobs_mutex;
+        std::condition_variable           m_jobs_condition;
+        bool                              m_stop;
+    };
+};
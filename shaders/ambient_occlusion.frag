@@ -40,7 +40,7 @@ layout (  std140, set = 0, binding = 4 ) uniform KernelSamples{
 layout(location = 0) out float out_color;
 
 const vec2 noiseScale = vec2(1600.0 / 4.0, 900.0 / 4.0); // Based on screen size
-const int kernelSize = 64;
+layout( constant_id = 0 ) const int kernelSize = 64; // set by AmbientOcclusionVK, <= samples[] size
 const float radius = 0.5;
 const float bias = 0.025;
 
@@ -1,4 +1,7 @@
 C:\VulkanSDK\1.4.309.0\Bin\glslc.exe vert.vert -o vert.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe vert_packed.vert -o vert_packed.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe depth.vert -o depth.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe depth_packed.vert -o depth_packed.spv
 C:\VulkanSDK\1.4.309.0\Bin\glslc.exe diffuse.frag -o diffuse.spv
 C:\VulkanSDK\1.4.309.0\Bin\glslc.exe microfacets.frag -o microfacets.spv
 C:\VulkanSDK\1.4.309.0\Bin\glslc.exe composition_v.vert -o composition_v.spv
@@ -0,0 +1,54 @@
+#version 460
+
+#extension GL_ARB_shader_draw_parameters : enable
+
+//inputs, only the PackedPosition stream: unorm positions in the cube of the mesh (the model matrix dequantizes them)
+layout( location = 0 ) in vec4 v_positions;
+
+//globals
+struct LightData
+{
+    vec4 m_light_pos;
+    vec4 m_radiance;
+    vec4 m_attenuattion;
+    mat4 m_view_projection;
+};
+
+layout( std140, set = 0, binding = 0 ) uniform PerFrameData
+{
+    vec4      m_camera_pos;
+    mat4      m_view;
+    mat4      m_projection;
+    mat4      m_view_projection;
+    mat4      m_inv_view;
+    mat4      m_inv_projection;
+    mat4      m_inv_view_projection;
+    vec4      m_clipping_planes;
+    LightData m_lights[ 10 ];
+    uint      m_number_of_lights;
+} per_frame_data;
+
+
+struct ObjectData
+{
+    mat4 m_model;
+    vec4 m_albedo; 
+    vec4 m_metallic_roughness;
+};
+
+//all object matrices
+layout(std140,set = 1, binding = 0) readonly buffer ObjectBufferData
+{
+    ObjectData objects[];
+} per_object_data;
+
+
+layout( location = 0 ) out vec3 f_position;
+
+void main() {
+    //pos in world space, the shadow geometry shader projects it for each light
+    vec4 pos = per_object_data.objects[ gl_BaseInstance ].m_model * vec4(v_positions.xyz, 1.0);
+    f_position = pos.xyz;
+
+    gl_Position = per_frame_data.m_projection * per_frame_data.m_view * pos;
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+#version 460
+
+#extension GL_ARB_shader_draw_parameters : enable
+
+//inputs, PackedPosition and PackedAttributes: unorm positions in the cube of the mesh (the model matrix dequantizes them),
+//octahedral snorm normals and half float uvs
+layout( location = 0 ) in vec4 v_positions;
+layout( location = 1 ) in vec2 v_normals;
+layout( location = 2 ) in vec2 v_uvs;
+
+//globals
+struct LightData
+{
+    vec4 m_light_pos;
+    vec4 m_radiance;
+    vec4 m_attenuattion;
+    mat4 m_view_projection;
+};
+
+layout( std140, set = 0, binding = 0 ) uniform PerFrameData
+{
+    vec4      m_camera_pos;
+    mat4      m_view;
+    mat4      m_projection;
+    mat4      m_view_projection;
+    mat4      m_inv_view;
+    mat4      m_inv_projection;
+    mat4      m_inv_view_projection;
+    vec4      m_clipping_planes;
+    LightData m_lights[ 10 ];
+    uint      m_number_of_lights;
+} per_frame_data;
+
+
+struct ObjectData
+{
+    mat4 m_model;
+    vec4 m_albedo; 
+    vec4 m_metallic_roughness;
+};
+
+//all object matrices
+layout(std140,set = 1, binding = 0) readonly buffer ObjectBufferData
+{
+    ObjectData objects[];
+} per_object_data;
+
+
+vec3 decodeOctahedral( vec2 i_encoded )
+{
+    vec3 normal = vec3( i_encoded, 1.0 - abs( i_encoded.x ) - abs( i_encoded.y ) );
+
+    if( normal.z < 0.0 )
+    {
+        vec2 signs = vec2( normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0 );
+        normal.xy  = ( 1.0 - abs( normal.yx ) ) * signs;
+    }
+
+    return normalize( normal );
+}
+
+
+layout( location = 0 ) out vec3 f_position;
+layout( location = 1 ) out vec3 f_normal;
+layout( location = 2 ) out vec2 f_uv;
+layout( location = 3 ) out flat int f_instance;
+
+void main() {
+    //pos in view space
+    vec4 pos = per_object_data.objects[ gl_BaseInstance ].m_model * vec4(v_positions.xyz, 1.0);
+    f_position = pos.xyz;
+
+    //normal in view space
+    //mat3 normal_matrix = transpose( inverse( mat3( per_frame_data.m_view * per_object_data.objects[ gl_BaseInstance ].m_model ) ) );
+    //f_normal = normal_matrix * v_normals;
+
+    //normal in world space
+    mat3 normal_matrix = transpose( inverse( mat3( per_object_data.objects[ gl_BaseInstance ].m_model ) ) );
+    f_normal = normal_matrix * decodeOctahedral( v_normals );
+
+    // uv
+    f_uv = v_uvs;
+
+    //progate the id
+    f_instance = gl_BaseInstance;
+
+    gl_Position = per_frame_data.m_projection * per_frame_data.m_view * pos;
+}
\ No newline at end of file
@@ -83,6 +83,15 @@ Matrix4f Camera::getProjection()
 }
 
 
+float Camera::getPixelsPerUnit( const float i_distance )
+{
+    //the vertical scale of the projection maps the height of the view to [-1,1]
+    const float scale = 0.5f * static_cast<float>( m_height ) * std::abs( getProjection()[ 1 ][ 1 ] );
+
+    return m_is_perspective ? scale / std::max( i_distance, m_near ) : scale;
+}
+
+
 Matrix4f Camera::getViewProjection() 
 {
     if( m_dirty[ 0 ] || m_dirty[ 1 ] )
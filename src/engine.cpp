@@ -4,6 +4,7 @@
 #include "frame.h"
 #include "meshRegistry.h"
 #include "shaderRegistry.h"
+#include "pipelineRegistry.h"
 #include "scene.h"
 #include "camera.h"
 #include "light.h"
@@ -14,6 +15,8 @@
 
 // vulkan includes
 #include "vulkan/rendererVK.h"
+#include "vulkan/geometryPoolVK.h"
+#include "vulkan/indirectDrawsVK.h"
 #include "vulkan/renderPassVK.h"
 #include "vulkan/deferredPassVK.h"
 #include "vulkan/depthPrePassVK.h"
@@ -24,6 +27,10 @@
 #include "vulkan/windowVK.h"
 #include "vulkan/deviceVK.h"
 #include "vulkan/utilsVK.h"
+#include "vulkan/frameAllocatorVK.h"
+#include "vulkan/commandRecorderVK.h"
+#include "vulkan/submitQueueVK.h"
+#include "vulkan/meshVK.h"
 
 
 
@@ -48,9 +55,11 @@ Engine& Engine::instance()
 
 
 Engine::Engine() : 
-    m_current_frame( 0     ),
-    m_close        ( false ),
-    m_resize       ( false )
+    m_frame_timeline_value  ( {}    ),
+    m_current_frame         ( 0     ),
+    m_upload_bytes_per_frame( 0     ),
+    m_close                 ( false ),
+    m_resize                ( false )
 {
 
 }
@@ -70,13 +79,19 @@ bool Engine::initialize()
 
     renderer.initialize();
 
-    m_runtime.m_mesh_registry   = std::make_unique<MeshRegistry  >( m_runtime );
-    m_runtime.m_shader_registry = std::make_unique<ShaderRegistry>( m_runtime );
+    m_runtime.m_geometry_pool = std::make_unique<GeometryPoolVK>( *renderer.getDevice() );
+    m_runtime.m_geometry_pool->initialize( kGEOMETRY_POOL_VERTICES, kGEOMETRY_POOL_INDICES );
+
+    m_runtime.m_mesh_registry     = std::make_unique<MeshRegistry    >( m_runtime );
+    m_runtime.m_shader_registry   = std::make_unique<ShaderRegistry  >( m_runtime );
+    m_runtime.m_pipeline_registry = std::make_unique<PipelineRegistry>( m_runtime );
 
     m_runtime.m_mesh_registry->initialize();
     m_runtime.m_shader_registry->initialize();
+    m_runtime.m_pipeline_registry->initialize();
 
-    createSyncObjects ();
+    createSyncObjects   ();
+    createCommandBuffers();
 
     return true;
 }
@@ -89,63 +104,66 @@ void Engine::run()
     bool loop = true;
     while( loop && m_scene ) 
     {
-        uint32_t clamped_idx = m_current_frame % 3;
+        uint32_t clamped_idx = m_current_frame % kMAX_NUMBER_OF_FRAMES;
+
+        SubmitQueueVK& submit_queue = renderer.getDevice()->getSubmitQueue();
+
+        //wait until the gpu is done with the buffers and command buffers of this in-flight frame
+        submit_queue.wait( m_frame_timeline_value[ clamped_idx ] );
+
+        //before beginFrame: a change of level or a new entity invalidates the cache, and with it the pools of this slot
+        addLoadedEntities();
+        updateLods();
+
+        m_runtime.m_command_recorder->beginFrame( clamped_idx );
+
         renderer.getWindow().prepareFrame( m_frame_semaphore[ clamped_idx ].m_presentation_semaphore );
-        
-        vkWaitForFences( renderer.getDevice()->getLogicalDevice(), 1, &m_frame_fence[ clamped_idx ], VK_TRUE, 1000000000 );
+
+        Frame frame;
+        frame.m_frame_id = clamped_idx;
+        frame.m_image_id = renderer.getWindow().getCurrentImageId();
         
         //update global uniforms buffers 
-        updateGlobalBuffers(); 
-
-        //prepare pipeline stages
-        VkSubmitInfo submit_info{};
-        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        updateGlobalBuffers( frame ); 
 
-        submit_info.sType                   = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submit_info.pNext                   = nullptr;
-        submit_info.pWaitDstStageMask       = &wait_stage;
-        submit_info.waitSemaphoreCount      = 1;
-        submit_info.pWaitSemaphores         = &m_frame_semaphore[ clamped_idx ].m_presentation_semaphore;
-        submit_info.signalSemaphoreCount    = 1;
-        submit_info.pSignalSemaphores       = &m_frame_semaphore[ clamped_idx ].m_render_semaphore;
-
-        // draw render passes
+        // draw render passes, the copies of the dirty objects go first
         std::vector<VkCommandBuffer> cmds;
-        for( auto& pass : m_render_passes )
+
+        VkCommandBuffer upload_cmd = updateObjectBuffers( frame );
+        if( upload_cmd != VK_NULL_HANDLE )
         {
-            cmds.push_back( pass->draw( {} ) );
+            cmds.push_back( upload_cmd );
         }
 
-        submit_info.commandBufferCount = static_cast<uint32_t>(cmds.size());
-        submit_info.pCommandBuffers    = cmds.data();
+        //every pass records on a worker (or replays its cached command buffer), the submission keeps the order of m_render_passes
+        std::vector<VkCommandBuffer> pass_cmds( m_render_passes.size(), VK_NULL_HANDLE );
 
-        vkResetFences  ( renderer.getDevice()->getLogicalDevice(), 1, &m_frame_fence[ clamped_idx ] );
+        m_runtime.m_command_recorder->parallelFor( static_cast<uint32_t>( m_render_passes.size() ), 1, [ & ]( const uint32_t i_begin, const uint32_t i_end )
+        {
+            for( uint32_t id = i_begin; id < i_end; id++ )
+            {
+                pass_cmds[ id ] = m_render_passes[ id ]->record( frame );
+            }
+        } );
+
+        cmds.insert( cmds.end(), pass_cmds.begin(), pass_cmds.end() );
 
-        vkQueueSubmit( renderer.getDevice()->getGraphicsQueue(), 1, &submit_info, m_frame_fence[ clamped_idx ] );
+        //one submit per frame, the uploads queued since the last one go in front of it
+        m_frame_timeline_value[ clamped_idx ] = submit_queue.submit(
+            cmds,
+            m_frame_semaphore[ clamped_idx ].m_presentation_semaphore,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            m_frame_semaphore[ clamped_idx ].m_render_semaphore );
 
+        //no queue wait here, the timeline value of this slot is waited kMAX_NUMBER_OF_FRAMES frames later
         uint32_t result = renderer.getWindow().renderFrame( m_frame_semaphore[ clamped_idx ].m_render_semaphore );
-        
-        vkQueueWaitIdle( renderer.getDevice()->getGraphicsQueue() );
 
         //
         //check if we need to resize the window               
         // Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
         if( ( result == VK_ERROR_OUT_OF_DATE_KHR ) || ( result == VK_SUBOPTIMAL_KHR ) )
         {
-           renderer.getWindow().wait();
-
-            vkDeviceWaitIdle( renderer.getDevice()->getLogicalDevice() );
-                       
-            destroySamplers    ();
-            destroyRenderPasses();
-            destroyAttachments ();
-            destroySyncObjects ();
-            renderer.getWindow ().resize();        
-
-            createSyncObjects ();
-            createSamplers    ();
-            createAttachments ();
-            createRenderPasses();
+            resize();
         }                   
 
 
@@ -173,35 +191,60 @@ void Engine::shutdown()
 
     destroyRenderPasses();
     destroyAttachments ();
+    destroyShadowAttachments();
     destroySamplers    ();
     destroySyncObjects ();
+    destroyCommandBuffers();
 
     m_runtime.m_mesh_registry->shutdown();
+    m_runtime.m_pipeline_registry->shutdown();
     m_runtime.m_shader_registry->shutdown();
 
+    //after the meshes, they hand their ranges back on shutdown
+    m_runtime.m_geometry_pool->shutdown();
+
     m_runtime.m_renderer->shutdown();
 }
 
 
 void Engine::loadScene( const std::string& i_path )
 {
-    m_scene = Scene::loadScene( m_runtime, i_path );
-
-    assert( m_scene );
+    //created just once, before the scene so its meshes are parsed on the workers
+    m_runtime.createResources();
 
     if( !m_render_passes.empty() )
     {
+        //up to kMAX_NUMBER_OF_FRAMES submits may still use the passes, attachments and samplers of the old scene
+        vkDeviceWaitIdle( m_runtime.m_renderer->getDevice()->getLogicalDevice() );
+
         destroySamplers    ();
         destroyAttachments ();
+        destroyShadowAttachments();
         destroyRenderPasses();
+
+        //the cached command buffers point at what was just destroyed
+        m_runtime.m_command_recorder->invalidateCache();
+
+        //no frame draws the old meshes anymore, the loads of the new scene may evict them right away
+        m_runtime.m_mesh_registry->markIdle();
     }
-    else //create uniform buffers just once
+
+    //the passes are gone, dropping the old scene releases the last references to its meshes
+    if( m_scene )
     {
-        m_runtime.createResources();
+        m_scene->shutdown();
+        m_scene = nullptr;
     }
 
+    m_loading_entities.clear();
+
+    m_scene = Scene::loadScene( m_runtime, i_path );
+
+    assert( m_scene );
+
     createSamplers    ();
     createAttachments ();
+    createShadowAttachments();
     createRenderPasses();
 
     RendererVK& renderer = *m_runtime.m_renderer;
@@ -215,7 +258,7 @@ void Engine::createSyncObjects()
     RendererVK& renderer = *m_runtime.m_renderer;
 
     //create sync objects
-    for( uint32_t idx = 0; idx < 3; idx++ )
+    for( uint32_t idx = 0; idx < kMAX_NUMBER_OF_FRAMES; idx++ )
     {
         VkSemaphoreCreateInfo semaphore_info{};
         semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -229,14 +272,6 @@ void Engine::createSyncObjects()
         {
             throw MiniEngineException( "Cannot create presentation semaphore" );
         }
-
-        VkFenceCreateInfo fence_info{};
-        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-
-        if( vkCreateFence( renderer.getDevice()->getLogicalDevice(), &fence_info, nullptr, &m_frame_fence[ idx ] ) )
-        {
-            throw MiniEngineException( "Cannot create fence" );
-        }
     }
 }
 
@@ -245,15 +280,39 @@ void Engine::destroySyncObjects()
 {
     RendererVK& renderer = *m_runtime.m_renderer;
 
-    for( uint32_t idx = 0; idx < 3; idx++ )
+    for( uint32_t idx = 0; idx < kMAX_NUMBER_OF_FRAMES; idx++ )
     {
         vkDestroySemaphore( renderer.getDevice()->getLogicalDevice(), m_frame_semaphore[ idx ].m_render_semaphore      , nullptr );
         vkDestroySemaphore( renderer.getDevice()->getLogicalDevice(), m_frame_semaphore[ idx ].m_presentation_semaphore, nullptr );
-        vkDestroyFence    ( renderer.getDevice()->getLogicalDevice(), m_frame_fence[ idx ]                             , nullptr );
     }
 }
 
 
+void Engine::createCommandBuffers()
+{
+    RendererVK& renderer = *m_runtime.m_renderer;
+
+    VkCommandBufferAllocateInfo command_buffer_allocate_info{};
+    command_buffer_allocate_info.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_allocate_info.commandPool        = renderer.getDevice()->getCommandPool();
+    command_buffer_allocate_info.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_allocate_info.commandBufferCount = static_cast<uint32_t>( m_upload_command_buffer.size() );
+
+    if( vkAllocateCommandBuffers( renderer.getDevice()->getLogicalDevice(), &command_buffer_allocate_info, m_upload_command_buffer.data() ) )
+    {
+        throw MiniEngineException( "Cannot allocate upload command buffers" );
+    }
+}
+
+
+void Engine::destroyCommandBuffers()
+{
+    RendererVK& renderer = *m_runtime.m_renderer;
+
+    vkFreeCommandBuffers( renderer.getDevice()->getLogicalDevice(), renderer.getDevice()->getCommandPool(), static_cast<uint32_t>( m_upload_command_buffer.size() ), m_upload_command_buffer.data() );
+}
+
+
 void Engine::createRenderPasses ()
 { 
     //temp
@@ -316,16 +375,29 @@ void Engine::createRenderPasses ()
     m_render_passes.push_back( composition_pass );
 
 
+    m_loading_entities.clear();
+
     if( m_scene )
     {
-        for( auto pass : m_render_passes )
+        const uint64_t completed = m_runtime.m_renderer->getDevice()->getSubmitQueue().getCompletedValue();
+
+        for( auto entity : m_scene->getMeshes() )
         {
-            for( auto entity : m_scene->getMeshes() )
+            if( !entity->isResident( completed ) )
+            {
+                m_loading_entities.push_back( entity );
+                continue;
+            }
+
+            for( auto pass : m_render_passes )
             {
                 pass->addEntityToDraw( entity );
             }
         }
     }
+
+    //new passes, new entity lists, whatever was recorded before can't be replayed
+    m_runtime.m_command_recorder->invalidateCache();
 }
 
 
@@ -340,15 +412,22 @@ void Engine::destroyRenderPasses()
     }
 
     m_render_passes.clear();
+    m_loading_entities.clear();
 }
 
 
 
-void Engine::updateGlobalBuffers()
+void Engine::updateGlobalBuffers( Frame& io_frame )
 {
-    assert( m_runtime.m_per_frame_buffer[ m_current_frame % 3 ] );
+    assert( m_runtime.m_frame_allocator[ io_frame.m_frame_id ] );
     assert( m_scene );
 
+    //the timeline value of this slot has been waited, the gpu no longer reads its upload buffer
+    FrameAllocatorVK& allocator = *m_runtime.m_frame_allocator[ io_frame.m_frame_id ];
+    allocator.reset();
+
+    const VkPhysicalDeviceLimits& limits = m_runtime.m_renderer->getDevice()->getPhysicalDeviceProperties().limits;
+
     //global settings
     PerFrameData perframe_data;
     Vector3f cam_pos = m_scene->getCamera().getCameraPos();
@@ -378,73 +457,134 @@ void Engine::updateGlobalBuffers()
 
     }
 
-    // ssao buffer
-    KernelSSAO kernel_ssao;
-    std::uniform_real_distribution<float> randomFloats(0.0, 1.0); // random floats between [0.0, 1.0]
-    std::default_random_engine generator;
+    //material buffers
+    *allocator.allocate<PerFrameData>( limits.minUniformBufferOffsetAlignment, io_frame.m_per_frame_offset ) = perframe_data;
+
+    m_upload_bytes_per_frame = sizeof( PerFrameData );
+}
 
-    for (unsigned int i = 0; i < 64; ++i)
-    {
-        glm::vec3 sample(
-            randomFloats(generator) * 2.0 - 1.0,
-            randomFloats(generator) * 2.0 - 1.0,
-            randomFloats(generator)
-        );
-        float scale = (float)i / 64.0;
-        scale = glm::mix(0.1f, 1.0f, scale * scale);
 
-        sample = glm::normalize(sample) * randomFloats(generator) * scale;
+VkCommandBuffer Engine::updateObjectBuffers( const Frame& i_frame )
+{
+    assert( m_scene->getMeshes().size() <= kMAX_NUMBER_OF_OBJECTS );
 
-        kernel_ssao.m_kernelSSAO[i] = glm::vec4(sample.x, sample.y, sample.z, 1.0f);
+    uint32_t dirty_count = 0;
+    for( auto& entity : m_scene->getMeshes() )
+    {
+        dirty_count += entity->isDirty() ? 1 : 0;
     }
 
-    void* k_data;
-    vkMapMemory(m_runtime.m_renderer->getDevice()->getLogicalDevice(), m_runtime.m_kernel_buffer_mem[m_current_frame % 3], 0, sizeof(KernelSSAO), 0, &k_data);
+    if( dirty_count == 0 )
+    {
+        return VK_NULL_HANDLE;
+    }
 
-    memcpy(k_data, &kernel_ssao, sizeof(KernelSSAO));
+    //staging for the dirty objects, packed one after another
+    uint32_t staging_offset = 0;
+    PerObjectData* staging_data = m_runtime.m_frame_allocator[ i_frame.m_frame_id ]->allocate<PerObjectData>( alignof( PerObjectData ), staging_offset, dirty_count );
 
-    vkUnmapMemory(m_runtime.m_renderer->getDevice()->getLogicalDevice(), m_runtime.m_kernel_buffer_mem[m_current_frame % 3]);
+    //consecutive dirty entities are merged in the same copy region
+    std::vector<VkBufferCopy> copy_regions;
+    uint32_t staging_idx = 0;
 
+    for( uint32_t idx = 0; idx < m_scene->getMeshes().size(); idx++ )
+    {
+        std::shared_ptr<Entity> entity = m_scene->getMeshes()[ idx ];
 
-    //material buffers
-    void* data;
-    vkMapMemory( m_runtime.m_renderer->getDevice()->getLogicalDevice(), m_runtime.m_per_frame_buffer_memory[ m_current_frame  % 3 ], 0, sizeof( PerFrameData ), 0, &data );
+        if( !entity->isDirty() )
+        {
+            continue;
+        }
 
-    memcpy( data, &perframe_data, sizeof( PerFrameData ) );
+        const VkDeviceSize dst_offset = sizeof( PerObjectData ) * entity->getEntityOffset();
 
-    vkUnmapMemory( m_runtime.m_renderer->getDevice()->getLogicalDevice(), m_runtime.m_per_frame_buffer_memory[ m_current_frame % 3 ] );
+        if( !copy_regions.empty() && copy_regions.back().dstOffset + copy_regions.back().size == dst_offset )
+        {
+            copy_regions.back().size += sizeof( PerObjectData );
+        }
+        else
+        {
+            VkBufferCopy region{};
+            region.srcOffset = staging_offset + sizeof( PerObjectData ) * staging_idx;
+            region.dstOffset = dst_offset;
+            region.size      = sizeof( PerObjectData );
+            copy_regions.push_back( region );
+        }
 
-    
-    for( uint32_t idx = 0; idx < m_scene->getMeshes().size(); idx++ )
-    {
-        PerObjectData* data_object;
-        std::shared_ptr<Entity> entity = m_scene->getMeshes()[ idx ];
-        
-        vkMapMemory( m_runtime.m_renderer->getDevice()->getLogicalDevice(), m_runtime.m_per_object_buffer_memory[ m_current_frame % 3 ], sizeof( PerObjectData ) * idx, sizeof( PerObjectData ), 0, reinterpret_cast<void**>( &data_object ) );
+        //build it on the stack, the upload memory is write combined and must not be read back
+        PerObjectData data_object = {};
 
-        data_object->m_model = entity->getTransform().getTransform();
+        data_object.m_model = entity->getTransform().getTransform() * entity->getMesh().getDequantization();
 
         switch( entity->getMaterial().getType() )
         {
             case Material::TMaterial::Diffuse:
             {
                 Diffuse& diffuse = reinterpret_cast<Diffuse&>( entity->getMaterial() );
-                data_object->m_albedo  = Vector4f( diffuse.getData().m_albedo.x, diffuse.getData().m_albedo.y, diffuse.getData().m_albedo.z, 0.0f );
+                data_object.m_albedo  = Vector4f( diffuse.getData().m_albedo.x, diffuse.getData().m_albedo.y, diffuse.getData().m_albedo.z, 0.0f );
 
                 break;
             }
             case Material::TMaterial::Microfacets: 
             {
                 Microfacets& microfacets = reinterpret_cast<Microfacets&>( entity->getMaterial() );
-                data_object->m_albedo             = Vector4f( microfacets.getData().m_albedo.x, microfacets.getData().m_albedo.y , microfacets.getData().m_albedo.z, 0.0f );
-                data_object->m_metallic_roughness = Vector4f( microfacets.getData().m_metallic, microfacets.getData().m_roughness,                             0.0f, 0.0f );
+                data_object.m_albedo             = Vector4f( microfacets.getData().m_albedo.x, microfacets.getData().m_albedo.y , microfacets.getData().m_albedo.z, 0.0f );
+                data_object.m_metallic_roughness = Vector4f( microfacets.getData().m_metallic, microfacets.getData().m_roughness,                             0.0f, 0.0f );
                 break;
             }
         }        
 
-        vkUnmapMemory( m_runtime.m_renderer->getDevice()->getLogicalDevice(), m_runtime.m_per_object_buffer_memory[ m_current_frame % 3 ] );
+        staging_data[ staging_idx++ ] = data_object;
+        entity->markUploaded();
     }
-    
+
+    m_upload_bytes_per_frame += sizeof( PerObjectData ) * dirty_count;
+
+    VkCommandBuffer& upload_cmd = m_upload_command_buffer[ i_frame.m_frame_id ];
+    vkResetCommandBuffer( upload_cmd, 0 );
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if( vkBeginCommandBuffer( upload_cmd, &begin_info ) != VK_SUCCESS )
+    {
+        throw MiniEngineException( "failed to begin recording command buffer!" );
+    }
+
+    UtilsVK::beginRegion( upload_cmd, "Per Object Upload", Vector4f( 0.5f, 0.5f, 0.0f, 1.0f ) );
+
+    //the previous frame may still be reading the buffer
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask       = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer              = m_runtime.getPerObjectBuffer();
+    barrier.offset              = 0;
+    barrier.size                = VK_WHOLE_SIZE;
+
+    const VkPipelineStageFlags shader_stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+    vkCmdPipelineBarrier( upload_cmd, shader_stages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr );
+
+    vkCmdCopyBuffer( upload_cmd, m_runtime.m_frame_allocator[ i_frame.m_frame_id ]->getBuffer(), m_runtime.getPerObjectBuffer(), static_cast<uint32_t>( copy_regions.size() ), copy_regions.data() );
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier( upload_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, shader_stages, 0, 0, nullptr, 1, &barrier, 0, nullptr );
+
+    UtilsVK::insert   ( upload_cmd, "Uploaded " + std::to_string( m_upload_bytes_per_frame ) + " bytes", Vector4f( 0.5f, 0.5f, 0.0f, 1.0f ) );
+    UtilsVK::endRegion( upload_cmd );
+
+    if( vkEndCommandBuffer( upload_cmd ) != VK_SUCCESS )
+    {
+        throw MiniEngineException( "failed to record command buffer!" );
+    }
+
+    return upload_cmd;
 }
 
 
@@ -464,6 +604,27 @@ void Engine::createAttachments()
     UtilsVK::createImage(*m_runtime.m_renderer->getDevice(), VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, width, height, m_render_target_attachments.m_ssao_attachment);
     UtilsVK::createImage(*m_runtime.m_renderer->getDevice(), VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, width, height, m_render_target_attachments.m_ssao_blur_attachment);
 
+    m_render_target_attachments.m_color_attachment.m_sampler            = m_global_samplers[ 0 ];         
+    m_render_target_attachments.m_normal_attachment.m_sampler           = m_global_samplers[ 0 ];        
+    m_render_target_attachments.m_position_depth_attachment.m_sampler   = m_global_samplers[ 0 ];
+    m_render_target_attachments.m_material_attachment.m_sampler         = m_global_samplers[ 0 ];      
+    m_render_target_attachments.m_depth_attachment.m_sampler            = m_global_samplers[ 0 ];         
+    m_render_target_attachments.m_ssao_attachment.m_sampler             = m_global_samplers[ 0 ];          
+    m_render_target_attachments.m_ssao_blur_attachment.m_sampler        = m_global_samplers[ 0 ]; 
+
+    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_color_attachment.m_image          ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image Color Attachment"    );
+    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_normal_attachment.m_image         ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image Normal Attachment "  );
+    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_position_depth_attachment.m_image ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image Position Attachment ");
+    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_material_attachment.m_image       ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image Material Attachment ");
+    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_depth_attachment.m_image          ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image Depth Buffer"        );
+    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_ssao_attachment.m_image           ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image SSAO attachment"     );
+    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_ssao_blur_attachment.m_image      ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image SSAO blur "          );
+}
+
+
+void Engine::createShadowAttachments()
+{
+    //does not depend on the size of the window, kept when it is resized
     UtilsVK::createImage(
         *m_runtime.m_renderer->getDevice(),
         VK_FORMAT_D32_SFLOAT_S8_UINT,
@@ -476,28 +637,61 @@ void Engine::createAttachments()
         m_render_target_attachments.m_shadow_attachment
     );
 
+    m_render_target_attachments.m_shadow_attachment.m_sampler = m_global_samplers[ 0 ];
 
+    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_shadow_attachment.m_image ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image Shadow attachment" );
+}
 
-    
-    
 
-    m_render_target_attachments.m_color_attachment.m_sampler            = m_global_samplers[ 0 ];         
-    m_render_target_attachments.m_normal_attachment.m_sampler           = m_global_samplers[ 0 ];        
-    m_render_target_attachments.m_position_depth_attachment.m_sampler   = m_global_samplers[ 0 ];
-    m_render_target_attachments.m_material_attachment.m_sampler         = m_global_samplers[ 0 ];      
-    m_render_target_attachments.m_depth_attachment.m_sampler            = m_global_samplers[ 0 ];         
-    m_render_target_attachments.m_ssao_attachment.m_sampler             = m_global_samplers[ 0 ];          
-    m_render_target_attachments.m_ssao_blur_attachment.m_sampler        = m_global_samplers[ 0 ]; 
-    m_render_target_attachments.m_shadow_attachment.m_sampler           = m_global_samplers[ 0 ];
+void Engine::updateLods()
+{
+    Camera& camera = const_cast< Camera& >( m_scene->getCamera() );
 
-    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_color_attachment.m_image          ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image Color Attachment"    );
-    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_normal_attachment.m_image         ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image Normal Attachment "  );
-    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_position_depth_attachment.m_image ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image Position Attachment ");
-    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_material_attachment.m_image       ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image Material Attachment ");
-    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_depth_attachment.m_image          ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image Depth Buffer"        );
-    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_ssao_attachment.m_image           ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image SSAO attachment"     );
-    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)( m_render_target_attachments.m_ssao_blur_attachment.m_image      ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image SSAO blur "          );
-    UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t)(m_render_target_attachments.m_ssao_blur_attachment.m_image       ), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, "Image Shadow attachment ");
+    bool changed = false;
+    for( auto entity : m_scene->getMeshes() )
+    {
+        changed = entity->selectLods( camera ) || changed;
+    }
+
+    //the draws recorded with the old levels can't be replayed, the indirect ones are written every frame
+    if( changed && !IndirectDrawsVK::isSupported( *m_runtime.m_renderer->getDevice() ) )
+    {
+        m_runtime.m_command_recorder->invalidateCache();
+    }
+}
+
+
+void Engine::addLoadedEntities()
+{
+    //uploads what the loader threads finished, the copies go in front of this frame's submit.
+    //After the wait on the timeline value of the slot, the registry may evict what older frames drew
+    m_runtime.m_mesh_registry->update( m_current_frame );
+
+    //an entity is drawn by the first frame after its copies are done, no frame waits on the upload of a mesh it draws
+    const uint64_t completed = m_runtime.m_renderer->getDevice()->getSubmitQueue().getCompletedValue();
+
+    auto loaded = std::stable_partition( m_loading_entities.begin(), m_loading_entities.end(), [ completed ]( const EntityPtr& i_entity ) { return !i_entity->isResident( completed ); } );
+
+    if( loaded == m_loading_entities.end() )
+    {
+        return;
+    }
+
+    for( auto entity = loaded; entity != m_loading_entities.end(); entity++ )
+    {
+        for( auto pass : m_render_passes )
+        {
+            pass->addEntityToDraw( *entity );
+        }
+
+        //the model matrix was uploaded with the dequantization of a mesh that didn't exist yet
+        ( *entity )->markDirty();
+    }
+
+    m_loading_entities.erase( loaded, m_loading_entities.end() );
+
+    //new entity lists
+    m_runtime.m_command_recorder->invalidateCache();
 }
 
 
@@ -510,7 +704,40 @@ void Engine::destroyAttachments()
     UtilsVK::freeImageBlock( *m_runtime.m_renderer->getDevice(), m_render_target_attachments.m_depth_attachment          );
     UtilsVK::freeImageBlock( *m_runtime.m_renderer->getDevice(), m_render_target_attachments.m_ssao_attachment           );
     UtilsVK::freeImageBlock( *m_runtime.m_renderer->getDevice(), m_render_target_attachments.m_ssao_blur_attachment      );
-    UtilsVK::freeImageBlock( *m_runtime.m_renderer->getDevice(), m_render_target_attachments.m_shadow_attachment         );
+}
+
+
+void Engine::destroyShadowAttachments()
+{
+    UtilsVK::freeImageBlock( *m_runtime.m_renderer->getDevice(), m_render_target_attachments.m_shadow_attachment );
+}
+
+
+void Engine::resize()
+{
+    RendererVK& renderer = *m_runtime.m_renderer;
+
+    renderer.getWindow().wait();
+
+    //nothing in flight may still use the attachments or the images of the old swap chain
+    vkDeviceWaitIdle( renderer.getDevice()->getLogicalDevice() );
+
+    //only what depends on the size of the window is rebuilt, the render passes, pipelines, samplers
+    //and shadow maps are kept. The attachments are recreated in place, the passes hold references to them
+    destroyAttachments ();
+    destroySyncObjects ();
+    renderer.getWindow().resize();
+
+    createSyncObjects();
+    createAttachments();
+
+    for( auto pass : m_render_passes )
+    {
+        pass->resize();
+    }
+
+    //the cached command buffers point at the old framebuffers
+    m_runtime.m_command_recorder->invalidateCache();
 }
 
 
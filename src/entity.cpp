@@ -24,7 +24,8 @@ std::shared_ptr<Entity> Entity::createEntity(  const Runtime& i_runtime, const p
     auto entity = std::make_shared<Entity>( i_runtime );
     std::string path = i_node.find_child_by_attribute( "name", "filename" ).attribute("value").value();
     
-    entity->m_mesh = i_runtime.m_mesh_registry->loadMesh( path );
+    //queued by Scene::loadScene, resident already unless the scene loads asynchronously
+    entity->m_mesh = i_runtime.m_mesh_registry->loadMeshAsync( path );
 
     for (pugi::xml_node node = i_node.child("transform"); node; node = node.next_sibling("transform") )
     {
@@ -60,14 +61,86 @@ void Entity::shutdown()
 }
 
 
-void Entity::draw( CommandBuffer& i_command_buffer, const Frame& i_frame )
+bool Entity::isDirty() const
+{
+    return m_uploaded_transform_generation != m_transform.getGeneration() || m_uploaded_material_generation != m_material->getGeneration();
+}
+
+
+void Entity::markUploaded()
+{
+    m_uploaded_transform_generation = m_transform.getGeneration();
+    m_uploaded_material_generation  = m_material->getGeneration();
+}
+
+
+void Entity::markDirty()
+{
+    m_uploaded_transform_generation = UINT32_MAX;
+    m_uploaded_material_generation  = UINT32_MAX;
+}
+
+
+bool Entity::isResident( const uint64_t i_completed_value ) const
+{
+    return m_mesh->isResident() && m_mesh->getUploadValue() <= i_completed_value;
+}
+
+
+bool Entity::selectLods( Camera& i_camera )
+{
+    if( !m_mesh->isResident() )
+    {
+        return false;
+    }
+
+    const MeshBounds& bounds    = m_mesh->getBounds();
+    const Matrix4f    transform = m_transform.getTransform();
+
+    //bounding sphere in world space, the largest scale of the axes scales the errors too
+    const float scale = std::max( { glm::length( Vector3f( transform[ 0 ] ) ), glm::length( Vector3f( transform[ 1 ] ) ), glm::length( Vector3f( transform[ 2 ] ) ) } );
+
+    const Vector3f center   = Vector3f( transform * Vector4f( ( bounds.m_min + bounds.m_max ) * 0.5f, 1.0f ) );
+    const float    radius   = 0.5f * glm::length( bounds.m_max - bounds.m_min ) * scale;
+    const float    distance = std::max( glm::length( center - i_camera.getCameraPos() ) - radius, 0.0f );
+
+    const float pixels_per_unit = i_camera.getPixelsPerUnit( distance ) * scale;
+
+    const std::array<uint32_t, 2> lods =
+    { {
+        m_mesh->selectLod( pixels_per_unit, kLOD_PIXEL_ERROR        ),
+        m_mesh->selectLod( pixels_per_unit, kSHADOW_LOD_PIXEL_ERROR )
+    } };
+
+    const bool changed = lods != m_lods;
+    m_lods = lods;
+
+    return changed;
+}
+
+
+void Entity::draw( CommandBuffer& i_command_buffer, const Frame& i_frame, const LodTarget i_target )
 {
     //make the draw
     const RendererVK& renderer = *m_runtime.m_renderer;
     
-    m_mesh->draw( i_command_buffer, m_entity_offset );
+    m_mesh->draw( i_command_buffer, m_entity_offset, m_lods[ static_cast<uint32_t>( i_target ) ] );
 }
 
 
+void Entity::getDrawCommands( const LodTarget i_target, VkDrawIndexedIndirectCommand* o_commands ) const
+{
+    m_mesh->getDrawCommands( m_entity_offset, m_lods[ static_cast<uint32_t>( i_target ) ], o_commands );
+}
 
 
+uint32_t Entity::getDrawCount() const
+{
+    return m_mesh->getDrawCount();
+}
+
+
+VkIndexType Entity::getIndexType() const
+{
+    return m_mesh->getIndexType();
+}
\ No newline at end of file
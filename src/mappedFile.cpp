@@ -0,0 +1,159 @@
+#include "mappedFile.h"
+
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace MiniEngine;
+
+
+MappedFile::MappedFile() :
+    m_data   ( nullptr ),
+    m_size   ( 0       ),
+    m_open   ( false   ),
+#if defined(_WIN32)
+    m_file   ( INVALID_HANDLE_VALUE ),
+    m_mapping( nullptr )
+#else
+    m_file   ( -1 )
+#endif
+{
+}
+
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+bool MappedFile::open( const std::string& i_path )
+{
+    close();
+
+#if defined(_WIN32)
+    m_file = CreateFileA( i_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+    if( m_file == INVALID_HANDLE_VALUE )
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if( !GetFileSizeEx( m_file, &size ) )
+    {
+        close();
+        return false;
+    }
+    m_size = static_cast<size_t>( size.QuadPart );
+
+    //an empty file can't be mapped, it is open with no data
+    if( m_size > 0 )
+    {
+        m_mapping = CreateFileMappingA( m_file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+        m_data    = m_mapping ? static_cast<const uint8_t*>( MapViewOfFile( m_mapping, FILE_MAP_READ, 0, 0, 0 ) ) : nullptr;
+
+        if( m_data == nullptr )
+        {
+            close();
+            return false;
+        }
+    }
+#else
+    m_file = ::open( i_path.c_str(), O_RDONLY );
+    if( m_file < 0 )
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+    if( fstat( m_file, &file_stat ) != 0 )
+    {
+        close();
+        return false;
+    }
+    m_size = static_cast<size_t>( file_stat.st_size );
+
+    //an empty file can't be mapped, it is open with no data
+    if( m_size > 0 )
+    {
+        void* data = mmap( nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0 );
+        if( data == MAP_FAILED )
+        {
+            close();
+            return false;
+        }
+
+        m_data = static_cast<const uint8_t*>( data );
+        madvise( data, m_size, MADV_SEQUENTIAL );
+    }
+#endif
+
+    m_open = true;
+    return true;
+}
+
+
+void MappedFile::close()
+{
+#if defined(_WIN32)
+    if( m_data )
+    {
+        UnmapViewOfFile( m_data );
+    }
+    if( m_mapping )
+    {
+        CloseHandle( m_mapping );
+    }
+    if( m_file != INVALID_HANDLE_VALUE )
+    {
+        CloseHandle( m_file );
+    }
+
+    m_mapping = nullptr;
+    m_file    = INVALID_HANDLE_VALUE;
+#else
+    if( m_data )
+    {
+        munmap( const_cast<uint8_t*>( m_data ), m_size );
+    }
+    if( m_file >= 0 )
+    {
+        ::close( m_file );
+    }
+
+    m_file = -1;
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+    m_open = false;
+}
+
+
+bool MappedFile::getStamp( const std::string& i_path, uint64_t& o_size, int64_t& o_time )
+{
+#if defined(_WIN32)
+    struct _stat64 file_stat;
+    if( _stat64( i_path.c_str(), &file_stat ) != 0 )
+    {
+        return false;
+    }
+#else
+    struct stat file_stat;
+    if( stat( i_path.c_str(), &file_stat ) != 0 )
+    {
+        return false;
+    }
+#endif
+
+    o_size = static_cast<uint64_t>( file_stat.st_size );
+    o_time = static_cast<int64_t> ( file_stat.st_mtime );
+
+    return true;
+}
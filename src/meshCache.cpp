@@ -0,0 +1,521 @@
+#include "meshCache.h"
+
+#include <cstring>
+
+using namespace MiniEngine;
+
+
+namespace
+{
+    constexpr uint32_t kMESH_CACHE_MAGIC   = 0x4853454d; //"MESH"
+    constexpr uint32_t kMESH_CACHE_VERSION = 4;
+
+    constexpr uint32_t kFLAG_COMPRESSED = 1u << 0;
+
+    //arrays start aligned so the uncompressed path copies from aligned memory
+    constexpr uint64_t kARRAY_ALIGNMENT = 16;
+
+    //compressed arrays are split in blocks: [raw size][stored size][bytes], the high bit of the
+    //stored size marks a block that did not compress and is kept as is
+    constexpr size_t   kBLOCK_SIZE = 1u << 20;
+    constexpr uint32_t kRAW_BLOCK  = 1u << 31;
+
+    //LZ4 block format: greedy matches found through a hash of the next 4 bytes
+    constexpr uint32_t kHASH_BITS     = 14;
+    constexpr size_t   kMIN_MATCH     = 4;
+    constexpr size_t   kLAST_LITERALS = 5;
+    constexpr size_t   kMATCH_LIMIT   = 12;
+    constexpr size_t   kMAX_OFFSET    = 65535;
+
+
+    uint32_t read32( const uint8_t* i_data )
+    {
+        uint32_t value;
+        memcpy( &value, i_data, sizeof( uint32_t ) );
+        return value;
+    }
+
+
+    uint32_t hashSequence( const uint32_t i_sequence )
+    {
+        return ( i_sequence * 2654435761u ) >> ( 32 - kHASH_BITS );
+    }
+
+
+    void writeLength( std::vector<uint8_t>& o_output, size_t i_length )
+    {
+        while( i_length >= 255 )
+        {
+            o_output.push_back( 255 );
+            i_length -= 255;
+        }
+        o_output.push_back( static_cast<uint8_t>( i_length ) );
+    }
+
+
+    void writeSequence( std::vector<uint8_t>& o_output, const uint8_t* i_literals, const size_t i_literal_count, const size_t i_offset, const size_t i_match_length )
+    {
+        const size_t match_code = i_match_length >= kMIN_MATCH ? i_match_length - kMIN_MATCH : 0;
+
+        o_output.push_back( static_cast<uint8_t>( ( std::min<size_t>( i_literal_count, 15 ) << 4 ) | std::min<size_t>( match_code, 15 ) ) );
+
+        if( i_literal_count >= 15 )
+        {
+            writeLength( o_output, i_literal_count - 15 );
+        }
+        o_output.insert( o_output.end(), i_literals, i_literals + i_literal_count );
+
+        //the last sequence is only literals
+        if( i_match_length == 0 )
+        {
+            return;
+        }
+
+        o_output.push_back( static_cast<uint8_t>( i_offset & 0xff ) );
+        o_output.push_back( static_cast<uint8_t>( i_offset >> 8   ) );
+
+        if( match_code >= 15 )
+        {
+            writeLength( o_output, match_code - 15 );
+        }
+    }
+
+
+    void compressBlock( const uint8_t* i_input, const size_t i_size, std::vector<uint8_t>& o_output )
+    {
+        //position + 1 of the last time each hash was seen, 0 is empty
+        std::vector<uint32_t> table( 1u << kHASH_BITS, 0 );
+
+        const size_t match_limit = i_size > kMATCH_LIMIT ? i_size - kMATCH_LIMIT : 0;
+        const size_t match_end   = i_size > kLAST_LITERALS ? i_size - kLAST_LITERALS : 0;
+
+        size_t anchor   = 0;
+        size_t position = 0;
+
+        while( position < match_limit )
+        {
+            const uint32_t sequence  = read32( i_input + position );
+            uint32_t&      slot      = table[ hashSequence( sequence ) ];
+            const size_t   candidate = slot;
+
+            slot = static_cast<uint32_t>( position + 1 );
+
+            if( candidate == 0 || position - ( candidate - 1 ) > kMAX_OFFSET || read32( i_input + candidate - 1 ) != sequence )
+            {
+                position++;
+                continue;
+            }
+
+            const size_t match = candidate - 1;
+
+            size_t length = kMIN_MATCH;
+            while( position + length < match_end && i_input[ match + length ] == i_input[ position + length ] )
+            {
+                length++;
+            }
+
+            writeSequence( o_output, i_input + anchor, position - anchor, position - match, length );
+
+            position += length;
+            anchor    = position;
+        }
+
+        writeSequence( o_output, i_input + anchor, i_size - anchor, 0, 0 );
+    }
+
+
+    size_t readLength( const uint8_t*& io_input, const uint8_t* i_end )
+    {
+        size_t length = 0;
+        uint8_t value = 255;
+
+        while( value == 255 )
+        {
+            if( io_input == i_end )
+            {
+                throw MiniEngineException( "Corrupted mesh cache block" );
+            }
+
+            value   = *io_input++;
+            length += value;
+        }
+
+        return length;
+    }
+
+
+    void decompressBlock( const uint8_t* i_input, const size_t i_size, uint8_t* o_output, const size_t i_output_size )
+    {
+        const uint8_t* input  = i_input;
+        const uint8_t* end    = i_input + i_size;
+        size_t         output = 0;
+
+        while( input < end )
+        {
+            const uint8_t token = *input++;
+
+            size_t literals = token >> 4;
+            if( literals == 15 )
+            {
+                literals += readLength( input, end );
+            }
+
+            if( literals > static_cast<size_t>( end - input ) || literals > i_output_size - output )
+            {
+                throw MiniEngineException( "Corrupted mesh cache block" );
+            }
+
+            memcpy( o_output + output, input, literals );
+            input  += literals;
+            output += literals;
+
+            if( input == end )
+            {
+                break;
+            }
+
+            if( end - input < 2 )
+            {
+                throw MiniEngineException( "Corrupted mesh cache block" );
+            }
+
+            const size_t offset = input[ 0 ] | ( input[ 1 ] << 8 );
+            input += 2;
+
+            size_t length = ( token & 15 ) + kMIN_MATCH;
+            if( ( token & 15 ) == 15 )
+            {
+                length += readLength( input, end );
+            }
+
+            if( offset == 0 || offset > output || length > i_output_size - output )
+            {
+                throw MiniEngineException( "Corrupted mesh cache block" );
+            }
+
+            //byte by byte, a match can overlap what it is writing
+            for( size_t id = 0; id < length; id++ )
+            {
+                o_output[ output + id ] = o_output[ output - offset + id ];
+            }
+            output += length;
+        }
+
+        if( output != i_output_size )
+        {
+            throw MiniEngineException( "Corrupted mesh cache block" );
+        }
+    }
+
+
+    void appendArray( std::vector<uint8_t>& io_file, const void* i_data, const size_t i_size, const bool i_compress, uint64_t& o_offset, uint64_t& o_stored_size )
+    {
+        io_file.resize( ( io_file.size() + kARRAY_ALIGNMENT - 1 ) / kARRAY_ALIGNMENT * kARRAY_ALIGNMENT, 0 );
+        o_offset = io_file.size();
+
+        const uint8_t* data = static_cast<const uint8_t*>( i_data );
+
+        if( !i_compress )
+        {
+            io_file.insert( io_file.end(), data, data + i_size );
+        }
+        else
+        {
+            std::vector<uint8_t> block;
+
+            for( size_t begin = 0; begin < i_size; begin += kBLOCK_SIZE )
+            {
+                const size_t raw_size = std::min( kBLOCK_SIZE, i_size - begin );
+
+                block.clear();
+                compressBlock( data + begin, raw_size, block );
+
+                const bool     keep_raw    = block.size() >= raw_size;
+                const uint32_t block_sizes[ 2 ] =
+                {
+                    static_cast<uint32_t>( raw_size ),
+                    keep_raw ? static_cast<uint32_t>( raw_size ) | kRAW_BLOCK : static_cast<uint32_t>( block.size() )
+                };
+
+                const uint8_t* sizes = reinterpret_cast<const uint8_t*>( block_sizes );
+                io_file.insert( io_file.end(), sizes, sizes + sizeof( block_sizes ) );
+
+                if( keep_raw )
+                {
+                    io_file.insert( io_file.end(), data + begin, data + begin + raw_size );
+                }
+                else
+                {
+                    io_file.insert( io_file.end(), block.begin(), block.end() );
+                }
+            }
+        }
+
+        o_stored_size = io_file.size() - o_offset;
+    }
+
+
+    //FNV-1a, eight bytes per step so hashing a large source stays far below parsing it
+    uint64_t hashBytes( const uint8_t* i_data, const size_t i_size )
+    {
+        uint64_t hash = 14695981039346656037ull;
+
+        size_t id = 0;
+        for( ; id + sizeof( uint64_t ) <= i_size; id += sizeof( uint64_t ) )
+        {
+            uint64_t word;
+            memcpy( &word, i_data + id, sizeof( uint64_t ) );
+
+            hash ^= word;
+            hash *= 1099511628211ull;
+        }
+        for( ; id < i_size; id++ )
+        {
+            hash ^= i_data[ id ];
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+
+    bool hashFile( const std::string& i_path, uint64_t& o_hash )
+    {
+        MappedFile file;
+        if( !file.open( i_path ) )
+        {
+            return false;
+        }
+
+        o_hash = hashBytes( file.getData(), file.getSize() );
+        return true;
+    }
+}
+
+
+MeshCache::MeshCache( const std::string& i_source_path, const uint64_t i_settings ) :
+    m_source_path( i_source_path ),
+    m_settings   ( i_settings    ),
+    m_header     ( {}            )
+{
+    static_assert( sizeof( Header ) == 116 + sizeof( MeshLod ) * kMAX_MESH_LODS && sizeof( Header ) % 8 == 0, "the cache header is written as is, it can't have padding" );
+}
+
+
+bool MeshCache::open()
+{
+    close();
+
+    uint64_t source_size = 0;
+    int64_t  source_time = 0;
+
+    if( !MappedFile::getStamp( m_source_path, source_size, source_time ) )
+    {
+        return false;
+    }
+
+    if( !m_file.open( getCachePath( m_source_path ) ) || m_file.getSize() < sizeof( Header ) )
+    {
+        close();
+        return false;
+    }
+
+    memcpy( &m_header, m_file.getData(), sizeof( Header ) );
+
+    bool valid = m_header.m_magic       == kMESH_CACHE_MAGIC   &&
+                 m_header.m_version     == kMESH_CACHE_VERSION &&
+                 m_header.m_vertex_size == sizeof( Vertex )    &&
+                 m_header.m_settings    == m_settings          &&
+                 m_header.m_source_size == source_size;
+
+    valid = valid && m_header.m_vertices_offset + m_header.m_vertices_stored_size <= m_file.getSize() &&
+                     m_header.m_indices_offset  + m_header.m_indices_stored_size  <= m_file.getSize();
+
+    valid = valid && m_header.m_lod_count > 0 && m_header.m_lod_count <= kMAX_MESH_LODS;
+
+    for( uint32_t lod = 0; valid && lod < m_header.m_lod_count; lod++ )
+    {
+        valid = static_cast<uint64_t>( m_header.m_lods[ lod ].m_index_offset ) + m_header.m_lods[ lod ].m_index_count <= m_header.m_index_count;
+    }
+
+    //same size but touched since the cache was written, only its content tells if it changed
+    uint64_t source_hash = 0;
+    if( valid && m_header.m_source_time != source_time )
+    {
+        valid = hashFile( m_source_path, source_hash ) && source_hash == m_header.m_source_hash;
+    }
+
+    if( !valid )
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+
+void MeshCache::close()
+{
+    m_file.close();
+    m_header = {};
+}
+
+
+MeshData MeshCache::getData() const
+{
+    assert( m_file.isOpen() );
+
+    MeshData data;
+    data.m_vertex_count = m_header.m_vertex_count;
+    data.m_index_count  = m_header.m_index_count;
+    data.m_bounds.m_min = Vector3f( m_header.m_bounds_min[ 0 ], m_header.m_bounds_min[ 1 ], m_header.m_bounds_min[ 2 ] );
+    data.m_bounds.m_max = Vector3f( m_header.m_bounds_max[ 0 ], m_header.m_bounds_max[ 1 ], m_header.m_bounds_max[ 2 ] );
+    data.m_lods.assign( m_header.m_lods, m_header.m_lods + m_header.m_lod_count );
+
+    data.m_read_vertices = [ this ]( const MeshPieceConsumer<Vertex>& i_consumer )
+    {
+        readArray( m_header.m_vertices_offset, m_header.m_vertices_stored_size, sizeof( Vertex ), m_header.m_vertex_count, [ &i_consumer ]( const uint8_t* i_data, const uint32_t i_first, const uint32_t i_count )
+        {
+            i_consumer( reinterpret_cast<const Vertex*>( i_data ), i_first, i_count );
+        } );
+    };
+
+    data.m_read_indices = [ this ]( const MeshPieceConsumer<uint32_t>& i_consumer )
+    {
+        readArray( m_header.m_indices_offset, m_header.m_indices_stored_size, sizeof( uint32_t ), m_header.m_index_count, [ &i_consumer ]( const uint8_t* i_data, const uint32_t i_first, const uint32_t i_count )
+        {
+            i_consumer( reinterpret_cast<const uint32_t*>( i_data ), i_first, i_count );
+        } );
+    };
+
+    return data;
+}
+
+
+void MeshCache::write(
+    const std::string&           i_source_path,
+    const std::vector<Vertex>&   i_vertices,
+    const std::vector<uint32_t>& i_indices,
+    const std::vector<MeshLod>&  i_lods,
+    const MeshBounds&            i_bounds,
+    const uint64_t               i_settings,
+    const bool                   i_compress )
+{
+    Header header{};
+    header.m_magic        = kMESH_CACHE_MAGIC;
+    header.m_version      = kMESH_CACHE_VERSION;
+    header.m_vertex_size  = sizeof( Vertex );
+    header.m_flags        = i_compress ? kFLAG_COMPRESSED : 0;
+    header.m_settings     = i_settings;
+    header.m_vertex_count = static_cast<uint32_t>( i_vertices.size() );
+    header.m_index_count  = static_cast<uint32_t>( i_indices.size() );
+    header.m_lod_count    = static_cast<uint32_t>( std::min<size_t>( i_lods.size(), kMAX_MESH_LODS ) );
+
+    std::copy( i_lods.begin(), i_lods.begin() + header.m_lod_count, header.m_lods );
+
+    if( !MappedFile::getStamp( i_source_path, header.m_source_size, header.m_source_time ) ||
+        !hashFile( i_source_path, header.m_source_hash ) )
+    {
+        return;
+    }
+
+    for( uint32_t axis = 0; axis < 3; axis++ )
+    {
+        header.m_bounds_min[ axis ] = i_bounds.m_min[ axis ];
+        header.m_bounds_max[ axis ] = i_bounds.m_max[ axis ];
+    }
+
+    std::vector<uint8_t> file( sizeof( Header ), 0 );
+    appendArray( file, i_vertices.data(), sizeof( Vertex   ) * i_vertices.size(), i_compress, header.m_vertices_offset, header.m_vertices_stored_size );
+    appendArray( file, i_indices .data(), sizeof( uint32_t ) * i_indices .size(), i_compress, header.m_indices_offset , header.m_indices_stored_size  );
+
+    memcpy( file.data(), &header, sizeof( Header ) );
+
+    //written aside and moved over the old one, a reader never maps half a file
+    const std::string cache_path = getCachePath( i_source_path );
+    const std::string temp_path  = cache_path + ".tmp";
+
+    {
+        std::ofstream output( temp_path, std::ios::binary | std::ios::trunc );
+        if( !output.is_open() )
+        {
+            std::cout << "Cannot write the mesh cache " << cache_path << std::endl;
+            return;
+        }
+
+        output.write( reinterpret_cast<const char*>( file.data() ), file.size() );
+    }
+
+    std::remove( cache_path.c_str() );
+    if( std::rename( temp_path.c_str(), cache_path.c_str() ) != 0 )
+    {
+        std::remove( temp_path.c_str() );
+    }
+}
+
+
+std::string MeshCache::getCachePath( const std::string& i_source_path )
+{
+    return i_source_path + ".mesh";
+}
+
+
+void MeshCache::readArray( const uint64_t i_offset, const uint64_t i_stored_size, const size_t i_element_size, const uint32_t i_count, const PieceConsumer& i_consumer ) const
+{
+    const uint8_t* stored = m_file.getData() + i_offset;
+    const uint64_t size   = uint64_t( i_element_size ) * i_count;
+
+    if( ( m_header.m_flags & kFLAG_COMPRESSED ) == 0 )
+    {
+        if( i_stored_size != size )
+        {
+            throw MiniEngineException( "Corrupted mesh cache %s", getCachePath( m_source_path ) );
+        }
+
+        //the arrays start aligned inside the mapping, the whole array goes in one piece
+        i_consumer( stored, 0, i_count );
+        return;
+    }
+
+    //a block at a time, the raw ones are copied too since they are not aligned inside the file
+    std::vector<uint8_t> block( static_cast<size_t>( std::min<uint64_t>( kBLOCK_SIZE, size ) ) );
+
+    const uint8_t* end     = stored + i_stored_size;
+    uint64_t       written = 0;
+
+    while( written < size )
+    {
+        uint32_t block_sizes[ 2 ];
+        if( end - stored < static_cast<ptrdiff_t>( sizeof( block_sizes ) ) )
+        {
+            throw MiniEngineException( "Corrupted mesh cache %s", getCachePath( m_source_path ) );
+        }
+
+        memcpy( block_sizes, stored, sizeof( block_sizes ) );
+        stored += sizeof( block_sizes );
+
+        const size_t raw_size    = block_sizes[ 0 ];
+        const size_t stored_size = block_sizes[ 1 ] & ~kRAW_BLOCK;
+
+        //the writer cuts the arrays every kBLOCK_SIZE bytes, a multiple of the element sizes
+        if( stored_size > static_cast<size_t>( end - stored ) || raw_size > size - written || raw_size > block.size() || raw_size % i_element_size != 0 )
+        {
+            throw MiniEngineException( "Corrupted mesh cache %s", getCachePath( m_source_path ) );
+        }
+
+        if( block_sizes[ 1 ] & kRAW_BLOCK )
+        {
+            memcpy( block.data(), stored, raw_size );
+        }
+        else
+        {
+            decompressBlock( stored, stored_size, block.data(), raw_size );
+        }
+
+        i_consumer( block.data(), static_cast<uint32_t>( written / i_element_size ), static_cast<uint32_t>( raw_size / i_element_size ) );
+
+        stored  += stored_size;
+        written += raw_size;
+    }
+}
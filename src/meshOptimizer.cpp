@@ -0,0 +1,386 @@
+#include "meshOptimizer.h"
+
+using namespace MiniEngine;
+
+
+namespace
+{
+    //a cluster is cut once its own ACMR gets this close to the ACMR of the whole mesh, smaller clusters
+    //sort better against overdraw but every cut costs a cold cache
+    constexpr float kCLUSTER_ACMR_THRESHOLD = 1.05f;
+
+    //the triangles around every vertex, flattened
+    struct Adjacency
+    {
+        std::vector<uint32_t> m_counts;
+        std::vector<uint32_t> m_offsets;
+        std::vector<uint32_t> m_triangles;
+    };
+
+
+    void buildAdjacency( const std::vector<uint32_t>& i_indices, const size_t i_vertex_count, Adjacency& o_adjacency )
+    {
+        o_adjacency.m_counts .assign( i_vertex_count, 0 );
+        o_adjacency.m_offsets.assign( i_vertex_count, 0 );
+        o_adjacency.m_triangles.resize( i_indices.size() );
+
+        for( auto index : i_indices )
+        {
+            o_adjacency.m_counts[ index ]++;
+        }
+
+        uint32_t offset = 0;
+        for( size_t vertex = 0; vertex < i_vertex_count; vertex++ )
+        {
+            o_adjacency.m_offsets[ vertex ] = offset;
+            offset                         += o_adjacency.m_counts[ vertex ];
+        }
+
+        //filled through a copy of the offsets used as cursors
+        std::vector<uint32_t> cursors = o_adjacency.m_offsets;
+
+        for( size_t corner = 0; corner < i_indices.size(); corner++ )
+        {
+            o_adjacency.m_triangles[ cursors[ i_indices[ corner ] ]++ ] = static_cast<uint32_t>( corner / 3 );
+        }
+    }
+
+
+    //Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007.
+    //Fans around a vertex at a time, the next one is the candidate that will still be in the cache when
+    //all its triangles are emitted. o_clusters gets the first triangle of every jump to a cold vertex
+    void tipsify( const std::vector<uint32_t>& i_indices, const size_t i_vertex_count, const uint32_t i_cache_size, std::vector<uint32_t>& o_indices, std::vector<uint32_t>& o_clusters )
+    {
+        const size_t triangle_count = i_indices.size() / 3;
+
+        Adjacency adjacency;
+        buildAdjacency( i_indices, i_vertex_count, adjacency );
+
+        std::vector<uint32_t> live       = adjacency.m_counts;
+        std::vector<uint32_t> cache_time( i_vertex_count, 0 );
+        std::vector<bool>     emitted   ( triangle_count, false );
+        std::vector<uint32_t> dead_ends;
+        std::vector<uint32_t> candidates;
+
+        o_indices.clear();
+        o_indices.reserve( i_indices.size() );
+        o_clusters.clear();
+
+        uint32_t time   = i_cache_size + 1;
+        size_t   cursor = 0;
+        int64_t  fan    = i_vertex_count > 0 ? 0 : -1;
+        bool     jumped = true;
+
+        while( fan >= 0 )
+        {
+            const uint32_t emitted_count = static_cast<uint32_t>( o_indices.size() / 3 );
+
+            if( jumped && ( o_clusters.empty() || o_clusters.back() != emitted_count ) )
+            {
+                o_clusters.push_back( emitted_count );
+            }
+
+            candidates.clear();
+
+            const uint32_t begin = adjacency.m_offsets[ fan ];
+            const uint32_t end   = begin + adjacency.m_counts[ fan ];
+
+            for( uint32_t id = begin; id < end; id++ )
+            {
+                const uint32_t triangle = adjacency.m_triangles[ id ];
+
+                if( emitted[ triangle ] )
+                {
+                    continue;
+                }
+
+                for( uint32_t corner = 0; corner < 3; corner++ )
+                {
+                    const uint32_t vertex = i_indices[ 3 * triangle + corner ];
+
+                    o_indices .push_back( vertex );
+                    dead_ends .push_back( vertex );
+                    candidates.push_back( vertex );
+
+                    live[ vertex ]--;
+
+                    if( time - cache_time[ vertex ] > i_cache_size )
+                    {
+                        cache_time[ vertex ] = time++;
+                    }
+                }
+
+                emitted[ triangle ] = true;
+            }
+
+            //the candidate that will be in the cache the longest once its fan is done
+            int64_t  next     = -1;
+            uint32_t priority = 0;
+
+            for( auto vertex : candidates )
+            {
+                if( live[ vertex ] == 0 )
+                {
+                    continue;
+                }
+
+                uint32_t vertex_priority = 0;
+                if( time - cache_time[ vertex ] + 2 * live[ vertex ] <= i_cache_size )
+                {
+                    vertex_priority = time - cache_time[ vertex ];
+                }
+
+                if( next < 0 || vertex_priority > priority )
+                {
+                    next     = vertex;
+                    priority = vertex_priority;
+                }
+            }
+
+            jumped = next < 0;
+
+            //dead end, the most recent vertex with triangles left and then the first one in order
+            while( next < 0 && !dead_ends.empty() )
+            {
+                const uint32_t vertex = dead_ends.back();
+                dead_ends.pop_back();
+
+                if( live[ vertex ] > 0 )
+                {
+                    next = vertex;
+                }
+            }
+
+            while( next < 0 && cursor < i_vertex_count )
+            {
+                if( live[ cursor ] > 0 )
+                {
+                    next = cursor;
+                }
+                cursor++;
+            }
+
+            fan = next;
+        }
+    }
+
+
+    //cuts the Tipsify clusters further where their cache behaviour is already as good as the mesh's
+    void splitClusters( const std::vector<uint32_t>& i_indices, const size_t i_vertex_count, const uint32_t i_cache_size, const std::vector<uint32_t>& i_clusters, std::vector<uint32_t>& o_clusters )
+    {
+        const uint32_t triangle_count = static_cast<uint32_t>( i_indices.size() / 3 );
+        const float    threshold      = MeshOptimizer::analyzeVertexCache( i_indices, i_vertex_count, i_cache_size ).m_acmr * kCLUSTER_ACMR_THRESHOLD;
+
+        std::vector<uint32_t> cache_time( i_vertex_count, 0 );
+        uint32_t              time = i_cache_size + 1;
+
+        o_clusters.clear();
+
+        for( size_t cluster = 0; cluster < i_clusters.size(); cluster++ )
+        {
+            const uint32_t begin = i_clusters[ cluster ];
+            const uint32_t end   = cluster + 1 < i_clusters.size() ? i_clusters[ cluster + 1 ] : triangle_count;
+
+            uint32_t start  = begin;
+            uint32_t misses = 0;
+
+            //a cold cache at every cluster
+            time += i_cache_size + 1;
+            o_clusters.push_back( start );
+
+            for( uint32_t triangle = begin; triangle < end; triangle++ )
+            {
+                for( uint32_t corner = 0; corner < 3; corner++ )
+                {
+                    const uint32_t vertex = i_indices[ 3 * triangle + corner ];
+
+                    if( time - cache_time[ vertex ] > i_cache_size )
+                    {
+                        cache_time[ vertex ] = time++;
+                        misses++;
+                    }
+                }
+
+                const uint32_t triangles = triangle + 1 - start;
+
+                if( triangle + 1 < end && static_cast<float>( misses ) <= threshold * triangles )
+                {
+                    start  = triangle + 1;
+                    misses = 0;
+                    time  += i_cache_size + 1;
+
+                    o_clusters.push_back( start );
+                }
+            }
+        }
+    }
+
+
+    //outward facing clusters first: the further a cluster is from the center along its normal, the more
+    //likely it covers the others
+    void sortClusters( const std::vector<Vertex>& i_vertices, const std::vector<uint32_t>& i_clusters, std::vector<uint32_t>& io_indices )
+    {
+        const uint32_t triangle_count = static_cast<uint32_t>( io_indices.size() / 3 );
+        const uint32_t cluster_count  = static_cast<uint32_t>( i_clusters.size() );
+
+        Vector3f mesh_center( 0.0f );
+        float    mesh_area = 0.0f;
+
+        std::vector<Vector3f> centers( cluster_count, Vector3f( 0.0f ) );
+        std::vector<Vector3f> normals( cluster_count, Vector3f( 0.0f ) );
+        std::vector<float>    areas  ( cluster_count, 0.0f );
+
+        for( uint32_t cluster = 0; cluster < cluster_count; cluster++ )
+        {
+            const uint32_t begin = i_clusters[ cluster ];
+            const uint32_t end   = cluster + 1 < cluster_count ? i_clusters[ cluster + 1 ] : triangle_count;
+
+            for( uint32_t triangle = begin; triangle < end; triangle++ )
+            {
+                const Vector3f& a = i_vertices[ io_indices[ 3 * triangle + 0 ] ].m_position;
+                const Vector3f& b = i_vertices[ io_indices[ 3 * triangle + 1 ] ].m_position;
+                const Vector3f& c = i_vertices[ io_indices[ 3 * triangle + 2 ] ].m_position;
+
+                //twice the area along the normal, the centers are weighted by area
+                const Vector3f normal = glm::cross( b - a, c - a );
+                const float    area   = glm::length( normal );
+
+                centers[ cluster ] += ( a + b + c ) * ( area / 3.0f );
+                normals[ cluster ] += normal;
+                areas  [ cluster ] += area;
+            }
+
+            mesh_center += centers[ cluster ];
+            mesh_area   += areas  [ cluster ];
+        }
+
+        if( mesh_area > 0.0f )
+        {
+            mesh_center /= mesh_area;
+        }
+
+        std::vector<float> keys( cluster_count, 0.0f );
+
+        for( uint32_t cluster = 0; cluster < cluster_count; cluster++ )
+        {
+            if( areas[ cluster ] > 0.0f )
+            {
+                keys[ cluster ] = glm::dot( centers[ cluster ] / areas[ cluster ] - mesh_center, normals[ cluster ] / areas[ cluster ] );
+            }
+        }
+
+        std::vector<uint32_t> order( cluster_count );
+        for( uint32_t cluster = 0; cluster < cluster_count; cluster++ )
+        {
+            order[ cluster ] = cluster;
+        }
+
+        std::stable_sort( order.begin(), order.end(), [ &keys ]( const uint32_t i_a, const uint32_t i_b )
+        {
+            return keys[ i_a ] > keys[ i_b ];
+        } );
+
+        std::vector<uint32_t> indices;
+        indices.reserve( io_indices.size() );
+
+        for( auto cluster : order )
+        {
+            const uint32_t begin = i_clusters[ cluster ];
+            const uint32_t end   = cluster + 1 < cluster_count ? i_clusters[ cluster + 1 ] : triangle_count;
+
+            indices.insert( indices.end(), io_indices.begin() + 3 * begin, io_indices.begin() + 3 * end );
+        }
+
+        io_indices.swap( indices );
+    }
+
+
+    //vertices in the order the indices reach them, unreferenced ones are dropped
+    void reorderVertices( std::vector<Vertex>& io_vertices, std::vector<uint32_t>& io_indices )
+    {
+        std::vector<uint32_t> remap( io_vertices.size(), UINT32_MAX );
+        std::vector<Vertex>   vertices;
+
+        vertices.reserve( io_vertices.size() );
+
+        for( auto& index : io_indices )
+        {
+            if( remap[ index ] == UINT32_MAX )
+            {
+                remap[ index ] = static_cast<uint32_t>( vertices.size() );
+                vertices.push_back( io_vertices[ index ] );
+            }
+
+            index = remap[ index ];
+        }
+
+        io_vertices.swap( vertices );
+    }
+}
+
+
+MeshOptimizer::CacheStatistics MeshOptimizer::analyzeVertexCache( const std::vector<uint32_t>& i_indices, const size_t i_vertex_count, const uint32_t i_cache_size )
+{
+    //a vertex is in the cache while fewer than i_cache_size misses happened after its own
+    std::vector<uint32_t> cache_time( i_vertex_count, 0 );
+    uint32_t              time   = i_cache_size + 1;
+    uint32_t              misses = 0;
+
+    for( auto vertex : i_indices )
+    {
+        if( time - cache_time[ vertex ] > i_cache_size )
+        {
+            cache_time[ vertex ] = time++;
+            misses++;
+        }
+    }
+
+    CacheStatistics statistics;
+    statistics.m_acmr = i_indices.empty() ? 0.0f : static_cast<float>( misses ) / ( i_indices.size() / 3 );
+    statistics.m_atvr = i_vertex_count == 0  ? 0.0f : static_cast<float>( misses ) / i_vertex_count;
+
+    return statistics;
+}
+
+
+void MeshOptimizer::optimize( std::vector<Vertex>& io_vertices, std::vector<uint32_t>& io_indices, const uint32_t i_cache_size )
+{
+    if( io_indices.empty() )
+    {
+        return;
+    }
+
+    std::vector<uint32_t> tipsified;
+    std::vector<uint32_t> hard_clusters;
+    std::vector<uint32_t> clusters;
+
+    tipsify      ( io_indices, io_vertices.size(), i_cache_size, tipsified, hard_clusters );
+    splitClusters( tipsified, io_vertices.size(), i_cache_size, hard_clusters, clusters );
+
+    //the cold caches of the extra cuts add up, past the threshold only the Tipsify clusters are sorted
+    const float max_acmr = analyzeVertexCache( tipsified, io_vertices.size(), i_cache_size ).m_acmr * kCLUSTER_ACMR_THRESHOLD;
+
+    std::vector<uint32_t> indices = tipsified;
+    sortClusters( io_vertices, clusters, indices );
+
+    if( analyzeVertexCache( indices, io_vertices.size(), i_cache_size ).m_acmr > max_acmr )
+    {
+        indices = tipsified;
+        sortClusters( io_vertices, hard_clusters, indices );
+    }
+
+    io_indices.swap( indices );
+
+    reorderVertices( io_vertices, io_indices );
+}
+
+
+void MeshOptimizer::optimizeVertexCache( std::vector<uint32_t>& io_indices, const size_t i_vertex_count, const uint32_t i_cache_size )
+{
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> clusters;
+
+    tipsify( io_indices, i_vertex_count, i_cache_size, indices, clusters );
+
+    io_indices.swap( indices );
+}
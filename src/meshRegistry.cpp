@@ -1,139 +1,498 @@
 #include "meshRegistry.h"
+#include "meshCache.h"
+#include "meshOptimizer.h"
+#include "meshSimplifier.h"
+#include "objParser.h"
+#include "vertexWelder.h"
+#include "runtime.h"
 #include "vulkan/meshVK.h"
+#include "vulkan/geometryPoolVK.h"
+#include "vulkan/commandRecorderVK.h"
 
 using namespace MiniEngine;
 
 
 namespace 
 {
-    bool loadOBJ( const std::string& i_path, std::vector<Vertex>& o_vertices, std::vector<uint32>& o_indices )
+    uint32_t floatBits( const float i_value )
     {
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
+        uint32_t bits;
+        memcpy( &bits, &i_value, sizeof( uint32_t ) );
+        return bits;
+    }
+
+
+    //what the cached arrays depend on besides the source
+    uint64_t getCacheSettings()
+    {
+        const uint32_t settings[] = { floatBits( kWELD_EPSILON ), kVERTEX_CACHE_SIZE, kMAX_MESH_LODS, floatBits( kLOD_MAX_ERROR ) };
+
+        uint64_t hash = 14695981039346656037ull;
+        for( auto setting : settings )
+        {
+            hash ^= setting;
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+
+    //the coarser levels go after the full mesh in the same index array. Each one is simplified from the full
+    //mesh to half the triangles of the previous, the chain ends when the error cap or the seams stop it early
+    void buildLods( const std::vector<Vertex>& i_vertices, const MeshBounds& i_bounds, std::vector<uint32>& io_indices, std::vector<MeshLod>& o_lods )
+    {
+        const std::vector<uint32> full      = io_indices;
+        const float               max_error = kLOD_MAX_ERROR * glm::length( i_bounds.m_max - i_bounds.m_min );
+
+        o_lods.assign( 1, { 0, static_cast<uint32_t>( full.size() ), 0.0f } );
 
-        std::string warn;
-        std::string err;
-        bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, i_path.c_str() );
+        std::vector<uint32> lod;
 
-        if (!err.empty()) 
+        while( o_lods.size() < kMAX_MESH_LODS )
         {
-            throw MiniEngineException( err.c_str() );
+            const MeshLod previous = o_lods.back();
+            const float   error    = MeshSimplifier::simplify( i_vertices, full, previous.m_index_count / 2, max_error, lod );
+
+            if( lod.empty() || lod.size() * 4 > previous.m_index_count * 3 )
+            {
+                break;
+            }
+
+            MeshOptimizer::optimizeVertexCache( lod, i_vertices.size(), kVERTEX_CACHE_SIZE );
+
+            o_lods.push_back( { static_cast<uint32_t>( io_indices.size() ), static_cast<uint32_t>( lod.size() ), std::max( error, previous.m_error ) } );
+            io_indices.insert( io_indices.end(), lod.begin(), lod.end() );
         }
+    }
+
 
-        if(!ret) 
+    bool loadOBJ( const std::string& i_path, WorkerPool* i_workers, std::vector<Vertex>& o_vertices, std::vector<uint32>& o_indices, std::vector<MeshLod>& o_lods, MeshBounds& o_bounds )
+    {
+        ObjParser::Mesh mesh;
+
+        if( !ObjParser::load( i_path, i_workers, mesh ) )
         {
             throw MiniEngineException( "Failed to load/parse .obj.\n");
         }
-        
-        std::vector<Vertex> vertices;
-        std::vector<uint32_t> indices;
-        std::unordered_map<glm::vec3, uint32_t> unique_vertices;
-
-        for( const auto& shape : shapes )
-        {
-            for( const auto& index : shape.mesh.indices )
-            {   
-                Vertex vertex;
-                vertex.m_position =
-                {
-                     attrib.vertices[ 3 * index.vertex_index + 0 ],
-                     attrib.vertices[ 3 * index.vertex_index + 1 ],
-                     attrib.vertices[ 3 * index.vertex_index + 2 ] 
-                };
-
-                if( index.normal_index >= 0 )
-                {
-                    vertex.m_normal =
-                    {
-                         attrib.normals[ 3 * index.normal_index + 0 ],
-                         attrib.normals[ 3 * index.normal_index + 1 ],
-                         attrib.normals[ 3 * index.normal_index + 2 ]
-                    };
-                }
-                
-                if( index.texcoord_index >= 0 )
-                {
-                    vertex.m_uv =
-                    {
-                        attrib.texcoords[ 2 * index.texcoord_index + 0 ],
-                        attrib.texcoords[ 2 * index.texcoord_index + 1 ]
-                    };
-                }
-
-                if( unique_vertices.count( vertex.m_position ) == 0 )
-                {
-                    unique_vertices[ vertex.m_position ] = static_cast< uint32_t >( vertices.size() );
-                    vertices.push_back( vertex );
-#ifdef PRINT_VERTICES
-                    std::cout << "NEW VERTEX" << std::endl;
-                    std::cout << "pos: x: " << vertex.m_position.x << ", y: " << vertex.m_position.y << ", z: " << vertex.m_position.z << std::endl;
-                    std::cout << "normal: x: " << vertex.m_position.x << ", y: " << vertex.m_position.y << ", z: " << vertex.m_position.z << std::endl;
-                    std::cout << "uv: x: " << vertex.m_uv.x << ", y: " << vertex.m_uv.y << std::endl;
-#endif
-                }
-
-                indices.push_back( unique_vertices[ vertex.m_position ] );
+
+        VertexWelder::weld( mesh, kWELD_EPSILON, i_workers, o_vertices, o_indices, o_bounds );
+
+        //once per import, the cache keeps the optimized arrays
+        MeshOptimizer::CacheStatistics before = {};
+        MeshOptimizer::CacheStatistics after  = {};
+
+        if( kLOG_MESH_IMPORT )
+        {
+            before = MeshOptimizer::analyzeVertexCache( o_indices, o_vertices.size(), kVERTEX_CACHE_SIZE );
+        }
+
+        MeshOptimizer::optimize( o_vertices, o_indices, kVERTEX_CACHE_SIZE );
+
+        if( kLOG_MESH_IMPORT )
+        {
+            after = MeshOptimizer::analyzeVertexCache( o_indices, o_vertices.size(), kVERTEX_CACHE_SIZE );
+        }
+
+        buildLods( o_vertices, o_bounds, o_indices, o_lods );
+
+        if( kLOG_MESH_IMPORT )
+        {
+            std::cout << i_path << ": " << o_lods[ 0 ].m_index_count / 3 << " triangles, ACMR " << before.m_acmr << " -> " << after.m_acmr
+                      << ", ATVR " << before.m_atvr << " -> " << after.m_atvr << ", lods";
+
+            for( const auto& lod : o_lods )
+            {
+                std::cout << " " << lod.m_index_count / 3;
             }
+            std::cout << std::endl;
         }
 
-        o_indices = indices;
-        o_vertices = vertices;
         return true;
     }
+
+
+    //a mesh without a cache, read from the obj and cached for the next run
+    void loadSource( const std::string& i_path, WorkerPool* i_workers, std::vector<Vertex>& o_vertices, std::vector<uint32>& o_indices, std::vector<MeshLod>& o_lods, MeshBounds& o_bounds )
+    {
+        if( !::loadOBJ( i_path, i_workers, o_vertices, o_indices, o_lods, o_bounds ) )
+        {
+            throw MiniEngineException( "Error while loading obj" );
+        }
+
+        MeshCache::write( i_path, o_vertices, o_indices, o_lods, o_bounds, getCacheSettings(), kCOMPRESS_MESH_CACHE );
+    }
+
+
+    //the arrays stay owned by the caller, they must outlive the MeshVK::initialize that reads them
+    MeshData getMeshData( const std::vector<Vertex>& i_vertices, const std::vector<uint32>& i_indices, const std::vector<MeshLod>& i_lods, const MeshBounds& i_bounds )
+    {
+        MeshData data;
+        data.m_vertex_count  = static_cast<uint32_t>( i_vertices.size() );
+        data.m_index_count   = static_cast<uint32_t>( i_indices.size() );
+        data.m_bounds        = i_bounds;
+        data.m_lods          = i_lods;
+        data.m_read_vertices = [ &i_vertices ]( const MeshPieceConsumer<Vertex>&   i_consumer ) { i_consumer( i_vertices.data(), 0, static_cast<uint32_t>( i_vertices.size() ) ); };
+        data.m_read_indices  = [ &i_indices  ]( const MeshPieceConsumer<uint32_t>& i_consumer ) { i_consumer( i_indices.data(), 0, static_cast<uint32_t>( i_indices.size() ) ); };
+
+        return data;
+    }
 }
 
 
 
-std::shared_ptr<MeshVK> MeshRegistry::loadMesh( const std::string& i_path )
+std::shared_ptr<MeshVK> MeshRegistry::loadMesh( const std::string& i_path, const VertexLayout i_layout )
 {
-    auto mesh = m_meshes.find( i_path );
+    const std::string key = i_layout == VertexLayout::Packed ? i_path + "#packed" : i_path;
+
+    auto mesh = m_meshes.find( key );
 
     //handle already exist
     if( mesh != m_meshes.end() )
     {
+        //still on the loaders and the caller can't wait for it
+        while( !mesh->second->isResident() )
+        {
+            if( uploadLoaded() == 0 )
+            {
+                std::this_thread::yield();
+            }
+        }
+
         return mesh->second;
     }
 
     //new handle
-    std::vector<uint32> indices;
-    std::vector<Vertex> vertices;
+    const bool reload = m_evicted.erase( key ) != 0;
+    const auto start  = std::chrono::steady_clock::now();
 
-    if( !::loadOBJ( i_path, vertices, indices ) )
+    std::shared_ptr<MeshVK> new_mesh = std::make_shared<MeshVK>( m_runtime, i_path, i_layout );
+
+    //the binary cache goes from the mapped file to the staging buffers, no parsing or welding
+    MeshCache cache( i_path, getCacheSettings() );
+
+    if( cache.open() )
+    {
+        initializeMesh( *new_mesh, cache.getData(), i_path );
+    }
+    else
+    {
+        std::vector<uint32>  indices;
+        std::vector<Vertex>  vertices;
+        std::vector<MeshLod> lods;
+        MeshBounds           bounds;
+
+        loadSource( i_path, m_runtime.m_command_recorder ? &m_runtime.m_command_recorder->getWorkers() : nullptr, vertices, indices, lods, bounds );
+
+        initializeMesh( *new_mesh, getMeshData( vertices, indices, lods, bounds ), i_path );
+    }
+
+    m_meshes.insert( { key, new_mesh } );
+
+    addResident( *new_mesh, reload, start );
+
+    return new_mesh;
+}
+
+
+std::shared_ptr<MeshVK> MeshRegistry::loadMeshAsync( const std::string& i_path, const VertexLayout i_layout )
+{
+    const std::string key = i_layout == VertexLayout::Packed ? i_path + "#packed" : i_path;
+
+    auto mesh = m_meshes.find( key );
+
+    //handle already exist, resident or not
+    if( mesh != m_meshes.end() )
     {
-        throw MiniEngineException( "Error while loading obj" );
+        return mesh->second;
     }
 
-    std::shared_ptr<MeshVK> new_mesh = std::make_shared<MeshVK>( m_runtime, i_path, indices, vertices );
-    new_mesh->initialize();
+    //new handle, empty until update initializes it
+    auto                    job      = createJob( key, i_path, i_layout );
+    std::shared_ptr<MeshVK> new_mesh = job->m_mesh;
 
-    m_meshes.insert( { i_path, new_mesh } );
+    //a std::function has to be copyable, the job goes as a pointer and loadJob owns it again
+    LoadedMesh* posted = job.release();
+    m_loaders.post( [ this, posted ]() { loadJob( std::unique_ptr<LoadedMesh>( posted ) ); } );
+
+    m_loading++;
+
+    m_meshes.insert( { key, new_mesh } );
 
     return new_mesh;
 }
 
 
+void MeshRegistry::waitLoaded()
+{
+    while( m_loading > 0 )
+    {
+        if( uploadLoaded() == 0 )
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+
+uint32_t MeshRegistry::update( const uint64_t i_frame )
+{
+    m_frame = i_frame;
+
+    const uint32_t resident = uploadLoaded();
+
+    //the registry holds one reference, any other one is an entity, a pass or a load in flight
+    for( auto& mesh : m_meshes )
+    {
+        if( mesh.second.use_count() > 1 )
+        {
+            mesh.second->markUsed( i_frame );
+        }
+    }
+
+    evict( m_budget );
+
+    return resident;
+}
+
+
+uint32_t MeshRegistry::uploadLoaded()
+{
+    uint32_t resident = 0;
+
+    //the uploads go through the upload batcher, only this thread may touch it
+    std::unique_ptr<LoadedMesh> loaded;
+    while( m_completed.pop( loaded ) )
+    {
+        m_loading--;
+
+        if( !loaded->m_error.empty() )
+        {
+            throw MiniEngineException( "Error while loading %s: %s", loaded->m_path, loaded->m_error );
+        }
+
+        if( loaded->m_cache )
+        {
+            initializeMesh( *loaded->m_mesh, loaded->m_cache->getData(), loaded->m_path );
+
+            //the copies are in the staging buffers, the mapping isn't read anymore
+            loaded->m_cache->close();
+        }
+        else
+        {
+            initializeMesh( *loaded->m_mesh, getMeshData( loaded->m_vertices, loaded->m_indices, loaded->m_lods, loaded->m_bounds ), loaded->m_path );
+        }
+        addResident( *loaded->m_mesh, loaded->m_reload, loaded->m_start );
+        resident++;
+    }
+
+    return resident;
+}
+
+
 MeshRegistry::MeshRegistry( const Runtime& i_runtime ) :
-    m_runtime( i_runtime ),
-    m_meshes({})
+    m_runtime   ( i_runtime ),
+    m_meshes    ({}         ),
+    m_evicted   ({}         ),
+    m_frame     ( 0         ),
+    m_idle_frame( 0         ),
+    m_budget    ( 0         ),
+    m_statistics(           ),
+    m_stop      ( false     ),
+    m_loading   ( 0         )
 {
 }
 
 
 bool MeshRegistry::initialize()
 {
+    //they sleep until the first loadMeshAsync
+    m_stop = false;
+    m_loaders.initialize( kMESH_LOADER_THREADS );
+
+    //a budget past the pool would never evict, the pool runs out first
+    const uint64_t capacity = m_runtime.m_geometry_pool->getCapacity( kSCENE_VERTEX_LAYOUT );
+
+    m_budget = std::min<uint64_t>( kMESH_MEMORY_BUDGET, capacity );
+
+    if( m_budget < kMESH_MEMORY_BUDGET )
+    {
+        std::cout << "kMESH_MEMORY_BUDGET is past the " << ( capacity >> 20 ) << " MiB of the geometry pool, the budget is clamped to it" << std::endl;
+    }
+
     return true;
 }
  
 
 void MeshRegistry::shutdown()
 {
+    //a mesh still on the loaders is dropped, it was never allocated in the geometry pool
+    stopLoaders();
+
     for( auto mesh_block : m_meshes )
     {
         mesh_block.second->shutdown();
     }
 
     m_meshes.clear();
+    m_evicted.clear();
+
+    m_statistics.m_resident_bytes = 0;
+}
+
+
+std::unique_ptr<MeshRegistry::LoadedMesh> MeshRegistry::createJob( const std::string& i_key, const std::string& i_path, const VertexLayout i_layout )
+{
+    auto job = std::unique_ptr<LoadedMesh>( new LoadedMesh() );
+    job->m_mesh   = std::make_shared<MeshVK>( m_runtime, i_path, i_layout );
+    job->m_path   = i_path;
+    job->m_reload = m_evicted.erase( i_key ) != 0;
+    job->m_start  = std::chrono::steady_clock::now();
+
+    return job;
+}
+
+
+void MeshRegistry::addResident( MeshVK& io_mesh, const bool i_reload, const std::chrono::steady_clock::time_point i_start )
+{
+    //used from now on, a new mesh is not evicted before its first frames are done
+    io_mesh.markUsed( m_frame );
+
+    m_statistics.m_resident_bytes += io_mesh.getByteSize();
+
+    if( i_reload )
+    {
+        const double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - i_start ).count();
+
+        m_statistics.m_reloads++;
+        m_statistics.m_reload_ms     += ms;
+        m_statistics.m_last_reload_ms = ms;
+    }
+
+    evict( m_budget );
+}
+
+
+void MeshRegistry::evict( const uint64_t i_budget )
+{
+    //stops early when everything past the budget is in use
+    while( m_statistics.m_resident_bytes > i_budget && evictLeastRecentlyUsed() )
+    {
+    }
+}
+
+
+void MeshRegistry::markIdle()
+{
+    m_idle_frame = m_frame + 1;
+}
+
+
+bool MeshRegistry::isInFlight( const MeshVK& i_mesh ) const
+{
+    return i_mesh.getLastUsedFrame() + kMAX_NUMBER_OF_FRAMES > m_frame && i_mesh.getLastUsedFrame() >= m_idle_frame;
+}
+
+
+bool MeshRegistry::evictLeastRecentlyUsed()
+{
+    auto victim = m_meshes.end();
+
+    for( auto mesh = m_meshes.begin(); mesh != m_meshes.end(); mesh++ )
+    {
+        const MeshVK& candidate = *mesh->second;
+
+        //held somewhere else, still loading, or drawn by a frame the gpu may not have finished
+        if( mesh->second.use_count() > 1 || !candidate.isResident() || isInFlight( candidate ) )
+        {
+            continue;
+        }
+
+        if( victim == m_meshes.end() || candidate.getLastUsedFrame() < victim->second->getLastUsedFrame() )
+        {
+            victim = mesh;
+        }
+    }
+
+    if( victim == m_meshes.end() )
+    {
+        return false;
+    }
+
+    m_statistics.m_resident_bytes -= victim->second->getByteSize();
+    m_statistics.m_evictions++;
+
+    //the ranges go back to the geometry pool, a later load of the key makes a new mesh
+    victim->second->shutdown();
+
+    m_evicted.insert( victim->first );
+    m_meshes.erase( victim );
+
+    return true;
+}
+
+
+void MeshRegistry::initializeMesh( MeshVK& io_mesh, const MeshData& i_data, const std::string& i_path )
+{
+    //the budget leaves room in most cases, a full or fragmented pool frees the least recently used ranges and tries again
+    while( !io_mesh.initialize( i_data ) )
+    {
+        if( !evictLeastRecentlyUsed() )
+        {
+            throw MiniEngineException( "Geometry pool out of space for %s, raise kGEOMETRY_POOL_VERTICES or kGEOMETRY_POOL_INDICES", i_path );
+        }
+    }
+}
+
+
+void MeshRegistry::readMesh( LoadedMesh& io_mesh, WorkerPool* i_workers )
+{
+    auto cache = std::make_unique<MeshCache>( io_mesh.m_path, getCacheSettings() );
+
+    //stays mapped until the render thread has read it into the staging buffers, nothing is copied here
+    if( cache->open() )
+    {
+        io_mesh.m_cache = std::move( cache );
+        return;
+    }
+
+    loadSource( io_mesh.m_path, i_workers, io_mesh.m_vertices, io_mesh.m_indices, io_mesh.m_lods, io_mesh.m_bounds );
+}
+
+
+void MeshRegistry::stopLoaders()
+{
+    //what is still queued runs through loadJob and returns at once
+    m_stop = true;
+    m_loaders.shutdown();
+
+    std::unique_ptr<LoadedMesh> loaded;
+    while( m_completed.pop( loaded ) )
+    {
+    }
+
+    m_loading = 0;
+}
+
+
+void MeshRegistry::loadJob( std::unique_ptr<LoadedMesh> io_job )
+{
+    if( m_stop )
+    {
+        return;
+    }
+
+    //the parser and the welder split again on the loaders, the one running this job helps until they are done
+    try
+    {
+        readMesh( *io_job, &m_loaders );
+    }
+    catch( const std::exception& e )
+    {
+        io_job->m_error = e.what();
+    }
+
+    m_completed.push( std::move( io_job ) );
 }
 
 
@@ -0,0 +1,422 @@
+#include "meshSimplifier.h"
+
+#include <cmath>
+#include <unordered_set>
+
+using namespace MiniEngine;
+
+
+namespace
+{
+    //border edges are held by a plane through them perpendicular to their face, weighted above the faces
+    //so the silhouette of open meshes survives
+    constexpr double kBORDER_WEIGHT = 10.0;
+
+    //a collapse may turn the faces around the vertex at most this much (cosine), past it the surface folds
+    constexpr float kMIN_FACE_COSINE = 0.25f;
+
+    enum class VertexKind : uint8_t
+    {
+        Manifold,
+        Border,
+        Locked
+    };
+
+    //symmetric 4x4 matrix of the summed squared distances to a set of planes
+    struct Quadric
+    {
+        double m_a00, m_a11, m_a22, m_a01, m_a02, m_a12;
+        double m_b0, m_b1, m_b2;
+        double m_c;
+        double m_weight;
+    };
+
+    struct Collapse
+    {
+        uint32_t m_vertex;
+        uint32_t m_target;
+        float    m_error;
+    };
+
+
+    void addPlane( Quadric& io_quadric, const Vector3f& i_normal, const float i_distance, const double i_weight )
+    {
+        const double x = i_normal.x, y = i_normal.y, z = i_normal.z, d = i_distance;
+
+        io_quadric.m_a00    += i_weight * x * x;
+        io_quadric.m_a11    += i_weight * y * y;
+        io_quadric.m_a22    += i_weight * z * z;
+        io_quadric.m_a01    += i_weight * x * y;
+        io_quadric.m_a02    += i_weight * x * z;
+        io_quadric.m_a12    += i_weight * y * z;
+        io_quadric.m_b0     += i_weight * x * d;
+        io_quadric.m_b1     += i_weight * y * d;
+        io_quadric.m_b2     += i_weight * z * d;
+        io_quadric.m_c      += i_weight * d * d;
+        io_quadric.m_weight += i_weight;
+    }
+
+
+    void addQuadric( Quadric& io_quadric, const Quadric& i_other )
+    {
+        io_quadric.m_a00    += i_other.m_a00;
+        io_quadric.m_a11    += i_other.m_a11;
+        io_quadric.m_a22    += i_other.m_a22;
+        io_quadric.m_a01    += i_other.m_a01;
+        io_quadric.m_a02    += i_other.m_a02;
+        io_quadric.m_a12    += i_other.m_a12;
+        io_quadric.m_b0     += i_other.m_b0;
+        io_quadric.m_b1     += i_other.m_b1;
+        io_quadric.m_b2     += i_other.m_b2;
+        io_quadric.m_c      += i_other.m_c;
+        io_quadric.m_weight += i_other.m_weight;
+    }
+
+
+    //weighted mean distance to the planes
+    float evaluate( const Quadric& i_quadric, const Vector3f& i_point )
+    {
+        if( i_quadric.m_weight <= 0.0 )
+        {
+            return 0.0f;
+        }
+
+        const double x = i_point.x, y = i_point.y, z = i_point.z;
+
+        const double squared = i_quadric.m_a00 * x * x + i_quadric.m_a11 * y * y + i_quadric.m_a22 * z * z +
+                               2.0 * ( i_quadric.m_a01 * x * y + i_quadric.m_a02 * x * z + i_quadric.m_a12 * y * z ) +
+                               2.0 * ( i_quadric.m_b0 * x + i_quadric.m_b1 * y + i_quadric.m_b2 * z ) +
+                               i_quadric.m_c;
+
+        return static_cast<float>( std::sqrt( std::max( squared, 0.0 ) / i_quadric.m_weight ) );
+    }
+
+
+    uint64_t edgeKey( const uint32_t i_from, const uint32_t i_to )
+    {
+        return ( static_cast<uint64_t>( i_from ) << 32 ) | i_to;
+    }
+
+
+    //seams keep their place: moving one side of a split vertex would open the mesh
+    void classifyVertices( const std::vector<Vertex>& i_vertices, const std::unordered_set<uint64_t>& i_border_edges, std::vector<VertexKind>& o_kinds )
+    {
+        o_kinds.assign( i_vertices.size(), VertexKind::Manifold );
+
+        for( auto edge : i_border_edges )
+        {
+            o_kinds[ edge >> 32 ]         = VertexKind::Border;
+            o_kinds[ edge & 0xffffffffu ] = VertexKind::Border;
+        }
+
+        std::vector<uint32_t> order( i_vertices.size() );
+        for( uint32_t vertex = 0; vertex < order.size(); vertex++ )
+        {
+            order[ vertex ] = vertex;
+        }
+
+        auto less = [ &i_vertices ]( const uint32_t i_a, const uint32_t i_b )
+        {
+            const Vector3f& a = i_vertices[ i_a ].m_position;
+            const Vector3f& b = i_vertices[ i_b ].m_position;
+            return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+        };
+
+        std::sort( order.begin(), order.end(), less );
+
+        for( size_t id = 1; id < order.size(); id++ )
+        {
+            if( !less( order[ id - 1 ], order[ id ] ) )
+            {
+                o_kinds[ order[ id - 1 ] ] = VertexKind::Locked;
+                o_kinds[ order[ id ]     ] = VertexKind::Locked;
+            }
+        }
+    }
+
+
+    void buildQuadrics( const std::vector<Vertex>& i_vertices, const std::vector<uint32_t>& i_indices, const std::unordered_set<uint64_t>& i_border_edges, std::vector<Quadric>& o_quadrics )
+    {
+        o_quadrics.assign( i_vertices.size(), Quadric{} );
+
+        for( size_t triangle = 0; triangle < i_indices.size(); triangle += 3 )
+        {
+            const uint32_t corners[ 3 ] = { i_indices[ triangle ], i_indices[ triangle + 1 ], i_indices[ triangle + 2 ] };
+
+            const Vector3f& p0 = i_vertices[ corners[ 0 ] ].m_position;
+            const Vector3f& p1 = i_vertices[ corners[ 1 ] ].m_position;
+            const Vector3f& p2 = i_vertices[ corners[ 2 ] ].m_position;
+
+            const Vector3f cross  = glm::cross( p1 - p0, p2 - p0 );
+            const float    length = glm::length( cross );
+
+            if( length <= 0.0f )
+            {
+                continue;
+            }
+
+            const Vector3f normal = cross / length;
+            const float    area   = 0.5f * length;
+
+            for( auto corner : corners )
+            {
+                addPlane( o_quadrics[ corner ], normal, -glm::dot( normal, p0 ), area );
+            }
+
+            for( uint32_t edge = 0; edge < 3; edge++ )
+            {
+                const uint32_t from = corners[ edge ];
+                const uint32_t to   = corners[ ( edge + 1 ) % 3 ];
+
+                if( i_border_edges.count( edgeKey( from, to ) ) == 0 )
+                {
+                    continue;
+                }
+
+                const Vector3f& p_from = i_vertices[ from ].m_position;
+                const Vector3f  side   = i_vertices[ to ].m_position - p_from;
+                const float     span   = glm::length( side );
+
+                if( span <= 0.0f )
+                {
+                    continue;
+                }
+
+                const Vector3f border_normal = glm::cross( side / span, normal );
+                const double   weight        = kBORDER_WEIGHT * span * span;
+
+                addPlane( o_quadrics[ from ], border_normal, -glm::dot( border_normal, p_from ), weight );
+                addPlane( o_quadrics[ to   ], border_normal, -glm::dot( border_normal, p_from ), weight );
+            }
+        }
+    }
+
+
+    //directed edges without their opposite, open boundaries of the mesh (and the sides of every seam)
+    void findBorderEdges( const std::vector<uint32_t>& i_indices, std::unordered_set<uint64_t>& o_border_edges )
+    {
+        std::unordered_set<uint64_t> edges;
+        edges.reserve( i_indices.size() );
+
+        for( size_t corner = 0; corner < i_indices.size(); corner++ )
+        {
+            const size_t next = corner % 3 == 2 ? corner - 2 : corner + 1;
+            edges.insert( edgeKey( i_indices[ corner ], i_indices[ next ] ) );
+        }
+
+        o_border_edges.clear();
+
+        for( auto edge : edges )
+        {
+            if( edges.count( ( edge << 32 ) | ( edge >> 32 ) ) == 0 )
+            {
+                o_border_edges.insert( edge );
+            }
+        }
+    }
+
+
+    bool canCollapse( const std::vector<VertexKind>& i_kinds, const std::unordered_set<uint64_t>& i_border_edges, const uint32_t i_vertex, const uint32_t i_target )
+    {
+        switch( i_kinds[ i_vertex ] )
+        {
+            case VertexKind::Manifold:
+                return true;
+
+            case VertexKind::Border:
+                return i_kinds[ i_target ] != VertexKind::Manifold &&
+                       ( i_border_edges.count( edgeKey( i_vertex, i_target ) ) || i_border_edges.count( edgeKey( i_target, i_vertex ) ) );
+
+            default:
+                return false;
+        }
+    }
+
+
+    //the faces around the vertex that stay after the collapse must keep facing the same way
+    bool flipsFaces( const std::vector<Vertex>& i_vertices, const std::vector<uint32_t>& i_indices, const std::vector<uint32_t>& i_fan, const uint32_t i_vertex, const uint32_t i_target )
+    {
+        for( auto triangle : i_fan )
+        {
+            const uint32_t* corners = &i_indices[ 3 * triangle ];
+
+            if( corners[ 0 ] == i_target || corners[ 1 ] == i_target || corners[ 2 ] == i_target )
+            {
+                continue;
+            }
+
+            Vector3f before[ 3 ];
+            Vector3f after [ 3 ];
+
+            for( uint32_t corner = 0; corner < 3; corner++ )
+            {
+                before[ corner ] = i_vertices[ corners[ corner ] ].m_position;
+                after [ corner ] = corners[ corner ] == i_vertex ? i_vertices[ i_target ].m_position : before[ corner ];
+            }
+
+            const Vector3f normal_before = glm::cross( before[ 1 ] - before[ 0 ], before[ 2 ] - before[ 0 ] );
+            const Vector3f normal_after  = glm::cross( after [ 1 ] - after [ 0 ], after [ 2 ] - after [ 0 ] );
+
+            if( glm::dot( normal_before, normal_after ) <= kMIN_FACE_COSINE * glm::length( normal_before ) * glm::length( normal_after ) )
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
+
+
+float MeshSimplifier::simplify(
+    const std::vector<Vertex>&   i_vertices,
+    const std::vector<uint32_t>& i_indices,
+    const size_t                 i_target_index_count,
+    const float                  i_max_error,
+    std::vector<uint32_t>&       o_indices )
+{
+    const uint32_t vertex_count = static_cast<uint32_t>( i_vertices.size() );
+
+    std::unordered_set<uint64_t> border_edges;
+    std::vector<VertexKind>      kinds;
+    std::vector<Quadric>         quadrics;
+
+    findBorderEdges ( i_indices, border_edges );
+    classifyVertices( i_vertices, border_edges, kinds );
+    buildQuadrics   ( i_vertices, i_indices, border_edges, quadrics );
+
+    o_indices = i_indices;
+
+    float error = 0.0f;
+
+    std::vector<uint32_t> fan_counts;
+    std::vector<uint32_t> fan_offsets;
+    std::vector<uint32_t> fans;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap( vertex_count );
+    std::vector<bool>     touched;
+
+    //in passes: the cheapest collapses that don't touch each other, then the costs are computed again
+    while( o_indices.size() > i_target_index_count )
+    {
+        const size_t triangle_count = o_indices.size() / 3;
+
+        //triangles around every vertex
+        fan_counts.assign( vertex_count, 0 );
+        for( auto index : o_indices )
+        {
+            fan_counts[ index ]++;
+        }
+
+        fan_offsets.assign( vertex_count + 1, 0 );
+        for( uint32_t vertex = 0; vertex < vertex_count; vertex++ )
+        {
+            fan_offsets[ vertex + 1 ] = fan_offsets[ vertex ] + fan_counts[ vertex ];
+        }
+
+        fans.resize( o_indices.size() );
+        std::vector<uint32_t> cursors( fan_offsets.begin(), fan_offsets.end() - 1 );
+
+        for( size_t corner = 0; corner < o_indices.size(); corner++ )
+        {
+            fans[ cursors[ o_indices[ corner ] ]++ ] = static_cast<uint32_t>( corner / 3 );
+        }
+
+        //both directions of every edge
+        collapses.clear();
+
+        for( size_t corner = 0; corner < o_indices.size(); corner++ )
+        {
+            const uint32_t from = o_indices[ corner ];
+            const uint32_t to   = o_indices[ corner % 3 == 2 ? corner - 2 : corner + 1 ];
+
+            if( canCollapse( kinds, border_edges, from, to ) )
+            {
+                collapses.push_back( { from, to, evaluate( quadrics[ from ], i_vertices[ to ].m_position ) } );
+            }
+            if( canCollapse( kinds, border_edges, to, from ) )
+            {
+                collapses.push_back( { to, from, evaluate( quadrics[ to ], i_vertices[ from ].m_position ) } );
+            }
+        }
+
+        std::sort( collapses.begin(), collapses.end(), []( const Collapse& i_a, const Collapse& i_b )
+        {
+            return i_a.m_error < i_b.m_error;
+        } );
+
+        for( uint32_t vertex = 0; vertex < vertex_count; vertex++ )
+        {
+            remap[ vertex ] = vertex;
+        }
+        touched.assign( vertex_count, false );
+
+        const size_t triangles_to_remove = triangle_count - i_target_index_count / 3;
+        size_t       removed             = 0;
+
+        for( const auto& collapse : collapses )
+        {
+            if( collapse.m_error > i_max_error || removed >= triangles_to_remove )
+            {
+                break;
+            }
+
+            if( touched[ collapse.m_vertex ] || touched[ collapse.m_target ] )
+            {
+                continue;
+            }
+
+            const std::vector<uint32_t> fan( fans.begin() + fan_offsets[ collapse.m_vertex ], fans.begin() + fan_offsets[ collapse.m_vertex + 1 ] );
+
+            if( flipsFaces( i_vertices, o_indices, fan, collapse.m_vertex, collapse.m_target ) )
+            {
+                continue;
+            }
+
+            remap[ collapse.m_vertex ] = collapse.m_target;
+            addQuadric( quadrics[ collapse.m_target ], quadrics[ collapse.m_vertex ] );
+            error = std::max( error, collapse.m_error );
+
+            //the faces that change are locked for the rest of the pass, their costs are stale
+            touched[ collapse.m_target ] = true;
+
+            for( auto triangle : fan )
+            {
+                const uint32_t* corners = &o_indices[ 3 * triangle ];
+
+                touched[ corners[ 0 ] ] = touched[ corners[ 1 ] ] = touched[ corners[ 2 ] ] = true;
+
+                if( corners[ 0 ] == collapse.m_target || corners[ 1 ] == collapse.m_target || corners[ 2 ] == collapse.m_target )
+                {
+                    removed++;
+                }
+            }
+        }
+
+        if( removed == 0 )
+        {
+            break;
+        }
+
+        //apply the pass, the faces that lost an edge go away
+        size_t write = 0;
+
+        for( size_t triangle = 0; triangle < o_indices.size(); triangle += 3 )
+        {
+            const uint32_t a = remap[ o_indices[ triangle + 0 ] ];
+            const uint32_t b = remap[ o_indices[ triangle + 1 ] ];
+            const uint32_t c = remap[ o_indices[ triangle + 2 ] ];
+
+            if( a != b && b != c && a != c )
+            {
+                o_indices[ write++ ] = a;
+                o_indices[ write++ ] = b;
+                o_indices[ write++ ] = c;
+            }
+        }
+
+        o_indices.resize( write );
+    }
+
+    return error;
+}
@@ -0,0 +1,370 @@
+#include "objParser.h"
+#include "mappedFile.h"
+#include "workerPool.h"
+
+#include <charconv>
+#include <cstring>
+
+using namespace MiniEngine;
+
+
+namespace
+{
+    //below this a chunk costs more to schedule than to parse
+    constexpr size_t kMIN_CHUNK_BYTES = 256 * 1024;
+
+    //per thread, so a slow chunk does not leave the other threads idle
+    constexpr size_t kCHUNKS_PER_THREAD = 4;
+
+    //face corner as written in the file, relative indices are resolved against the chunk and fixed in the merge
+    struct Corner
+    {
+        int32_t m_index   [ 3 ]; //vertex, texcoord, normal
+        uint8_t m_relative[ 3 ];
+    };
+
+    struct Chunk
+    {
+        const char* m_begin;
+        const char* m_end;
+
+        std::vector<float>  m_positions;
+        std::vector<float>  m_normals;
+        std::vector<float>  m_texcoords;
+        std::vector<Corner> m_corners;
+        std::vector<size_t> m_shapes; //corners before each o or g record
+
+        //where the chunk goes in the final arrays, in elements
+        size_t m_positions_offset;
+        size_t m_normals_offset;
+        size_t m_texcoords_offset;
+        size_t m_corners_offset;
+    };
+
+
+    bool isSpace( const char i_char )
+    {
+        return i_char == ' ' || i_char == '\t' || i_char == '\r';
+    }
+
+
+    const char* skipSpaces( const char* i_current, const char* i_end )
+    {
+        while( i_current < i_end && isSpace( *i_current ) )
+        {
+            i_current++;
+        }
+        return i_current;
+    }
+
+
+    //parsed as a double and narrowed, the same rounding path as tinyobj
+    float parseFloat( const char*& io_current, const char* i_end )
+    {
+        io_current = skipSpaces( io_current, i_end );
+
+        if( io_current < i_end && *io_current == '+' )
+        {
+            io_current++;
+        }
+
+        double value = 0.0;
+        const std::from_chars_result result = std::from_chars( io_current, i_end, value );
+
+        if( result.ec == std::errc() )
+        {
+            io_current = result.ptr;
+        }
+
+        return static_cast<float>( value );
+    }
+
+
+    void parseFloats( const char* i_current, const char* i_end, const uint32_t i_count, std::vector<float>& o_values )
+    {
+        for( uint32_t id = 0; id < i_count; id++ )
+        {
+            o_values.push_back( parseFloat( i_current, i_end ) );
+        }
+    }
+
+
+    //v, v/t, v//n or v/t/n
+    bool parseCorner( const char*& io_current, const char* i_end, const size_t i_counts[ 3 ], Corner& o_corner )
+    {
+        o_corner = {};
+
+        for( uint32_t component = 0; component < 3; component++ )
+        {
+            o_corner.m_index[ component ] = -1;
+        }
+
+        for( uint32_t component = 0; component < 3; component++ )
+        {
+            if( component > 0 )
+            {
+                if( io_current == i_end || *io_current != '/' )
+                {
+                    break;
+                }
+                io_current++;
+            }
+
+            //v//n leaves the texcoord empty
+            if( io_current == i_end || *io_current == '/' || isSpace( *io_current ) )
+            {
+                continue;
+            }
+
+            int32_t value = 0;
+            const std::from_chars_result result = std::from_chars( io_current, i_end, value );
+
+            if( result.ec != std::errc() || value == 0 )
+            {
+                return false;
+            }
+            io_current = result.ptr;
+
+            if( value > 0 )
+            {
+                o_corner.m_index[ component ] = value - 1;
+            }
+            else
+            {
+                o_corner.m_index   [ component ] = static_cast<int32_t>( i_counts[ component ] ) + value;
+                o_corner.m_relative[ component ] = 1;
+            }
+        }
+
+        return io_current == i_end || isSpace( *io_current );
+    }
+
+
+    void parseChunk( Chunk& io_chunk )
+    {
+        std::vector<Corner> face;
+
+        const char* line = io_chunk.m_begin;
+
+        while( line < io_chunk.m_end )
+        {
+            const char* line_end = static_cast<const char*>( memchr( line, '\n', io_chunk.m_end - line ) );
+            if( line_end == nullptr )
+            {
+                line_end = io_chunk.m_end;
+            }
+
+            const char* current = skipSpaces( line, line_end );
+            const size_t length = line_end - current;
+
+            if( length >= 2 && current[ 0 ] == 'v' && isSpace( current[ 1 ] ) )
+            {
+                parseFloats( current + 2, line_end, 3, io_chunk.m_positions );
+            }
+            else if( length >= 3 && current[ 0 ] == 'v' && current[ 1 ] == 'n' && isSpace( current[ 2 ] ) )
+            {
+                parseFloats( current + 3, line_end, 3, io_chunk.m_normals );
+            }
+            else if( length >= 3 && current[ 0 ] == 'v' && current[ 1 ] == 't' && isSpace( current[ 2 ] ) )
+            {
+                parseFloats( current + 3, line_end, 2, io_chunk.m_texcoords );
+            }
+            else if( length >= 1 && ( current[ 0 ] == 'o' || current[ 0 ] == 'g' ) && ( length == 1 || isSpace( current[ 1 ] ) ) )
+            {
+                io_chunk.m_shapes.push_back( io_chunk.m_corners.size() );
+            }
+            else if( length >= 2 && current[ 0 ] == 'f' && isSpace( current[ 1 ] ) )
+            {
+                //what has been read of each array up to this line, the base of the relative indices
+                const size_t counts[ 3 ] =
+                {
+                    io_chunk.m_positions.size() / 3,
+                    io_chunk.m_texcoords.size() / 2,
+                    io_chunk.m_normals  .size() / 3
+                };
+
+                face.clear();
+                current = skipSpaces( current + 2, line_end );
+
+                while( current < line_end )
+                {
+                    Corner corner;
+                    if( !parseCorner( current, line_end, counts, corner ) )
+                    {
+                        throw MiniEngineException( "Failed to parse face \"%s\"", std::string( line, line_end ) );
+                    }
+
+                    face.push_back( corner );
+                    current = skipSpaces( current, line_end );
+                }
+
+                //convex polygons as a fan, like tinyobj does with them
+                for( size_t id = 2; id < face.size(); id++ )
+                {
+                    io_chunk.m_corners.push_back( face[ 0 ]      );
+                    io_chunk.m_corners.push_back( face[ id - 1 ] );
+                    io_chunk.m_corners.push_back( face[ id ]     );
+                }
+            }
+
+            line = line_end + 1;
+        }
+    }
+
+
+    void runJob( WorkerPool* i_workers, const uint32_t i_count, const std::function<void( uint32_t, uint32_t )>& i_job )
+    {
+        if( i_workers )
+        {
+            i_workers->parallelFor( i_count, 1, i_job );
+        }
+        else
+        {
+            i_job( 0, i_count );
+        }
+    }
+}
+
+
+bool ObjParser::load( const std::string& i_path, WorkerPool* i_workers, Mesh& o_mesh )
+{
+    MappedFile file;
+    if( !file.open( i_path ) )
+    {
+        throw MiniEngineException( "Cannot open %s", i_path );
+    }
+
+    const char*  data = reinterpret_cast<const char*>( file.getData() );
+    const size_t size = file.getSize();
+
+    //split at line boundaries
+    const size_t threads     = i_workers ? i_workers->getThreadCount() : 1;
+    const size_t chunk_count = std::max<size_t>( 1, std::min( size / kMIN_CHUNK_BYTES, threads * kCHUNKS_PER_THREAD ) );
+
+    std::vector<Chunk> chunks( chunk_count );
+    const char*        begin = data;
+
+    for( size_t id = 0; id < chunk_count; id++ )
+    {
+        const char* end = data + size * ( id + 1 ) / chunk_count;
+
+        if( id + 1 < chunk_count )
+        {
+            end = std::max( end, begin );
+
+            const char* line_end = static_cast<const char*>( memchr( end, '\n', data + size - end ) );
+            end = line_end ? line_end + 1 : data + size;
+        }
+        else
+        {
+            end = data + size;
+        }
+
+        chunks[ id ].m_begin = begin;
+        chunks[ id ].m_end   = end;
+        begin                = end;
+    }
+
+    runJob( i_workers, static_cast<uint32_t>( chunk_count ), [ &chunks ]( const uint32_t i_begin, const uint32_t i_end )
+    {
+        for( uint32_t id = i_begin; id < i_end; id++ )
+        {
+            parseChunk( chunks[ id ] );
+        }
+    } );
+
+    //exclusive scan of the chunk sizes, a chunk is copied where the previous ones end
+    size_t positions = 0, normals = 0, texcoords = 0, corners = 0;
+
+    for( auto& chunk : chunks )
+    {
+        chunk.m_positions_offset = positions;
+        chunk.m_normals_offset   = normals;
+        chunk.m_texcoords_offset = texcoords;
+        chunk.m_corners_offset   = corners;
+
+        positions += chunk.m_positions.size();
+        normals   += chunk.m_normals  .size();
+        texcoords += chunk.m_texcoords.size();
+        corners   += chunk.m_corners  .size();
+    }
+
+    o_mesh.m_positions.resize( positions );
+    o_mesh.m_normals  .resize( normals   );
+    o_mesh.m_texcoords.resize( texcoords );
+    o_mesh.m_indices  .resize( corners   );
+
+    const int32_t counts[ 3 ] =
+    {
+        static_cast<int32_t>( positions / 3 ),
+        static_cast<int32_t>( texcoords / 2 ),
+        static_cast<int32_t>( normals   / 3 )
+    };
+
+    runJob( i_workers, static_cast<uint32_t>( chunk_count ), [ & ]( const uint32_t i_begin, const uint32_t i_end )
+    {
+        for( uint32_t id = i_begin; id < i_end; id++ )
+        {
+            Chunk& chunk = chunks[ id ];
+
+            std::copy( chunk.m_positions.begin(), chunk.m_positions.end(), o_mesh.m_positions.begin() + chunk.m_positions_offset );
+            std::copy( chunk.m_normals  .begin(), chunk.m_normals  .end(), o_mesh.m_normals  .begin() + chunk.m_normals_offset   );
+            std::copy( chunk.m_texcoords.begin(), chunk.m_texcoords.end(), o_mesh.m_texcoords.begin() + chunk.m_texcoords_offset );
+
+            //relative indices were taken from the start of the chunk
+            const int32_t bases[ 3 ] =
+            {
+                static_cast<int32_t>( chunk.m_positions_offset / 3 ),
+                static_cast<int32_t>( chunk.m_texcoords_offset / 2 ),
+                static_cast<int32_t>( chunk.m_normals_offset   / 3 )
+            };
+
+            for( size_t corner = 0; corner < chunk.m_corners.size(); corner++ )
+            {
+                const Corner& source = chunk.m_corners[ corner ];
+                int32_t       index[ 3 ];
+
+                for( uint32_t component = 0; component < 3; component++ )
+                {
+                    index[ component ] = source.m_index[ component ];
+
+                    if( source.m_relative[ component ] )
+                    {
+                        index[ component ] += bases[ component ];
+                    }
+
+                    const bool missing = !source.m_relative[ component ] && source.m_index[ component ] == -1;
+                    if( !missing && ( index[ component ] < 0 || index[ component ] >= counts[ component ] ) )
+                    {
+                        throw MiniEngineException( "Face index out of range in %s", i_path );
+                    }
+                }
+
+                if( index[ 0 ] < 0 )
+                {
+                    throw MiniEngineException( "Face without vertex in %s", i_path );
+                }
+
+                o_mesh.m_indices[ chunk.m_corners_offset + corner ] = { index[ 0 ], index[ 2 ], index[ 1 ] };
+            }
+        }
+    } );
+
+    //a shape starts at every o or g record, the ones without faces are dropped
+    o_mesh.m_shapes.assign( 1, 0 );
+
+    for( const auto& chunk : chunks )
+    {
+        for( auto start : chunk.m_shapes )
+        {
+            const uint32_t index = static_cast<uint32_t>( chunk.m_corners_offset + start );
+
+            if( index != o_mesh.m_shapes.back() && index < corners )
+            {
+                o_mesh.m_shapes.push_back( index );
+            }
+        }
+    }
+
+    return true;
+}
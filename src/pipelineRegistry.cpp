@@ -0,0 +1,581 @@
+#include "pipelineRegistry.h"
+#include "runtime.h"
+#include "vulkan/rendererVK.h"
+#include "vulkan/deviceVK.h"
+#include "vulkan/commandRecorderVK.h"
+
+#include <cstring>
+
+
+using namespace MiniEngine;
+
+
+namespace
+{
+    const char* kPIPELINE_CACHE_FILE = "./pipeline_cache.bin";
+
+    constexpr uint32_t kPIPELINE_CACHE_MAGIC   = 0x43504b56; //"VKPC"
+    constexpr uint32_t kPIPELINE_CACHE_VERSION = 1;
+
+    //written in front of the driver blob, a cache from another device or driver is thrown away
+    struct PipelineCacheHeader
+    {
+        uint32_t m_magic;
+        uint32_t m_version;
+        uint32_t m_vendor_id;
+        uint32_t m_device_id;
+        uint32_t m_driver_version;
+        uint8_t  m_uuid[ VK_UUID_SIZE ];
+        uint32_t m_padding; //keeps the layout free of implicit padding, the header is compared as bytes
+        uint64_t m_data_size;
+    };
+
+
+    PipelineCacheHeader makeHeader( const VkPhysicalDeviceProperties& i_properties, const uint64_t i_data_size )
+    {
+        PipelineCacheHeader header{};
+        header.m_magic          = kPIPELINE_CACHE_MAGIC;
+        header.m_version        = kPIPELINE_CACHE_VERSION;
+        header.m_vendor_id      = i_properties.vendorID;
+        header.m_device_id      = i_properties.deviceID;
+        header.m_driver_version = i_properties.driverVersion;
+        header.m_data_size      = i_data_size;
+        memcpy( header.m_uuid, i_properties.pipelineCacheUUID, VK_UUID_SIZE );
+
+        return header;
+    }
+
+
+    //FNV-1a, fed field by field. Pointers are followed and never hashed themselves, the create infos
+    //are rebuilt on the stack by every pass so only what they point at is stable.
+    //The fed bytes are kept next to the hash, the key compares them on a hit
+    class StateHasher
+    {
+    public:
+        template<typename T>
+        void add( const T& i_value )
+        {
+            addBytes( &i_value, sizeof( T ) );
+        }
+
+        void addBytes( const void* i_data, const size_t i_size )
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>( i_data );
+            m_state.insert( m_state.end(), bytes, bytes + i_size );
+
+            for( size_t id = 0; id < i_size; id++ )
+            {
+                m_hash ^= bytes[ id ];
+                m_hash *= 1099511628211ull;
+            }
+        }
+
+        void addString( const char* i_string )
+        {
+            addBytes( i_string, i_string ? strlen( i_string ) + 1 : 0 );
+        }
+
+        //the presence of an optional state is part of the state
+        bool addPresent( const void* i_pointer )
+        {
+            add( i_pointer != nullptr );
+            return i_pointer != nullptr;
+        }
+
+        PipelineStateKey get()
+        {
+            return { m_hash, std::move( m_state ) };
+        }
+
+    private:
+        uint64_t             m_hash = 14695981039346656037ull;
+        std::vector<uint8_t> m_state;
+    };
+
+
+    PipelineStateKey hashDescriptorSetLayout( const VkDescriptorSetLayoutCreateInfo& i_info )
+    {
+        StateHasher hasher;
+        hasher.add( i_info.flags );
+
+        for( uint32_t id = 0; id < i_info.bindingCount; id++ )
+        {
+            const VkDescriptorSetLayoutBinding& binding = i_info.pBindings[ id ];
+
+            hasher.add( binding.binding );
+            hasher.add( binding.descriptorType );
+            hasher.add( binding.descriptorCount );
+            hasher.add( binding.stageFlags );
+
+            if( hasher.addPresent( binding.pImmutableSamplers ) )
+            {
+                hasher.addBytes( binding.pImmutableSamplers, sizeof( VkSampler ) * binding.descriptorCount );
+            }
+        }
+
+        return hasher.get();
+    }
+
+
+    PipelineStateKey hashPipelineLayout( const VkPipelineLayoutCreateInfo& i_info )
+    {
+        //the set layouts come from the registry too, equal layouts already share the handle
+        StateHasher hasher;
+        hasher.add     ( i_info.flags );
+        hasher.add     ( i_info.setLayoutCount );
+        hasher.addBytes( i_info.pSetLayouts, sizeof( VkDescriptorSetLayout ) * i_info.setLayoutCount );
+        hasher.add     ( i_info.pushConstantRangeCount );
+        hasher.addBytes( i_info.pPushConstantRanges, sizeof( VkPushConstantRange ) * i_info.pushConstantRangeCount );
+
+        return hasher.get();
+    }
+
+
+    PipelineStateKey hashGraphicsPipeline( const VkGraphicsPipelineCreateInfo& i_info )
+    {
+        StateHasher hasher;
+        hasher.add( i_info.flags );
+        hasher.add( i_info.stageCount );
+
+        for( uint32_t id = 0; id < i_info.stageCount; id++ )
+        {
+            const VkPipelineShaderStageCreateInfo& stage = i_info.pStages[ id ];
+
+            //modules come from the shader registry, one per file
+            hasher.add      ( stage.flags );
+            hasher.add      ( stage.stage );
+            hasher.add      ( stage.module );
+            hasher.addString( stage.pName );
+
+            if( hasher.addPresent( stage.pSpecializationInfo ) )
+            {
+                const VkSpecializationInfo& specialization = *stage.pSpecializationInfo;
+
+                for( uint32_t entry = 0; entry < specialization.mapEntryCount; entry++ )
+                {
+                    hasher.add( specialization.pMapEntries[ entry ].constantID );
+                    hasher.add( specialization.pMapEntries[ entry ].offset );
+                    hasher.add( specialization.pMapEntries[ entry ].size );
+                }
+                hasher.addBytes( specialization.pData, specialization.dataSize );
+            }
+        }
+
+        if( hasher.addPresent( i_info.pVertexInputState ) )
+        {
+            const VkPipelineVertexInputStateCreateInfo& vertex_input = *i_info.pVertexInputState;
+
+            for( uint32_t id = 0; id < vertex_input.vertexBindingDescriptionCount; id++ )
+            {
+                hasher.add( vertex_input.pVertexBindingDescriptions[ id ].binding );
+                hasher.add( vertex_input.pVertexBindingDescriptions[ id ].stride );
+                hasher.add( vertex_input.pVertexBindingDescriptions[ id ].inputRate );
+            }
+
+            for( uint32_t id = 0; id < vertex_input.vertexAttributeDescriptionCount; id++ )
+            {
+                hasher.add( vertex_input.pVertexAttributeDescriptions[ id ].location );
+                hasher.add( vertex_input.pVertexAttributeDescriptions[ id ].binding );
+                hasher.add( vertex_input.pVertexAttributeDescriptions[ id ].format );
+                hasher.add( vertex_input.pVertexAttributeDescriptions[ id ].offset );
+            }
+        }
+
+        if( hasher.addPresent( i_info.pInputAssemblyState ) )
+        {
+            hasher.add( i_info.pInputAssemblyState->topology );
+            hasher.add( i_info.pInputAssemblyState->primitiveRestartEnable );
+        }
+
+        if( hasher.addPresent( i_info.pTessellationState ) )
+        {
+            hasher.add( i_info.pTessellationState->patchControlPoints );
+        }
+
+        if( hasher.addPresent( i_info.pViewportState ) )
+        {
+            const VkPipelineViewportStateCreateInfo& viewport = *i_info.pViewportState;
+
+            hasher.add( viewport.viewportCount );
+            hasher.add( viewport.scissorCount );
+
+            //null when they are dynamic
+            if( hasher.addPresent( viewport.pViewports ) )
+            {
+                hasher.addBytes( viewport.pViewports, sizeof( VkViewport ) * viewport.viewportCount );
+            }
+            if( hasher.addPresent( viewport.pScissors ) )
+            {
+                hasher.addBytes( viewport.pScissors, sizeof( VkRect2D ) * viewport.scissorCount );
+            }
+        }
+
+        if( hasher.addPresent( i_info.pRasterizationState ) )
+        {
+            const VkPipelineRasterizationStateCreateInfo& raster = *i_info.pRasterizationState;
+
+            hasher.add( raster.depthClampEnable );
+            hasher.add( raster.rasterizerDiscardEnable );
+            hasher.add( raster.polygonMode );
+            hasher.add( raster.cullMode );
+            hasher.add( raster.frontFace );
+            hasher.add( raster.depthBiasEnable );
+            hasher.add( raster.depthBiasConstantFactor );
+            hasher.add( raster.depthBiasClamp );
+            hasher.add( raster.depthBiasSlopeFactor );
+            hasher.add( raster.lineWidth );
+        }
+
+        if( hasher.addPresent( i_info.pMultisampleState ) )
+        {
+            const VkPipelineMultisampleStateCreateInfo& multisample = *i_info.pMultisampleState;
+
+            hasher.add( multisample.rasterizationSamples );
+            hasher.add( multisample.sampleShadingEnable );
+            hasher.add( multisample.minSampleShading );
+            hasher.add( multisample.alphaToCoverageEnable );
+            hasher.add( multisample.alphaToOneEnable );
+
+            if( hasher.addPresent( multisample.pSampleMask ) )
+            {
+                hasher.addBytes( multisample.pSampleMask, sizeof( VkSampleMask ) * ( ( multisample.rasterizationSamples + 31 ) / 32 ) );
+            }
+        }
+
+        if( hasher.addPresent( i_info.pDepthStencilState ) )
+        {
+            const VkPipelineDepthStencilStateCreateInfo& depth_stencil = *i_info.pDepthStencilState;
+
+            hasher.add( depth_stencil.depthTestEnable );
+            hasher.add( depth_stencil.depthWriteEnable );
+            hasher.add( depth_stencil.depthCompareOp );
+            hasher.add( depth_stencil.depthBoundsTestEnable );
+            hasher.add( depth_stencil.stencilTestEnable );
+            hasher.add( depth_stencil.front );
+            hasher.add( depth_stencil.back );
+            hasher.add( depth_stencil.minDepthBounds );
+            hasher.add( depth_stencil.maxDepthBounds );
+        }
+
+        if( hasher.addPresent( i_info.pColorBlendState ) )
+        {
+            const VkPipelineColorBlendStateCreateInfo& blend = *i_info.pColorBlendState;
+
+            hasher.add     ( blend.logicOpEnable );
+            hasher.add     ( blend.logicOp );
+            hasher.add     ( blend.attachmentCount );
+            hasher.addBytes( blend.pAttachments, sizeof( VkPipelineColorBlendAttachmentState ) * blend.attachmentCount );
+            hasher.add     ( blend.blendConstants );
+        }
+
+        if( hasher.addPresent( i_info.pDynamicState ) )
+        {
+            hasher.add     ( i_info.pDynamicState->dynamicStateCount );
+            hasher.addBytes( i_info.pDynamicState->pDynamicStates, sizeof( VkDynamicState ) * i_info.pDynamicState->dynamicStateCount );
+        }
+
+        //passes release their pipelines before destroying the render pass, a reused handle never finds a stale entry
+        hasher.add( i_info.layout );
+        hasher.add( i_info.renderPass );
+        hasher.add( i_info.subpass );
+
+        return hasher.get();
+    }
+
+
+    template<typename Entries, typename Handle, typename Destroy>
+    void releaseEntry( Entries& io_entries, const Handle i_handle, const Destroy& i_destroy )
+    {
+        if( i_handle == VK_NULL_HANDLE )
+        {
+            return;
+        }
+
+        auto entry = std::find_if( io_entries.begin(), io_entries.end(), [ i_handle ]( const auto& i_entry ) { return i_entry.second.m_handle == i_handle; } );
+        assert( entry != io_entries.end() );
+
+        if( entry != io_entries.end() && --entry->second.m_references == 0 )
+        {
+            i_destroy( i_handle );
+            io_entries.erase( entry );
+        }
+    }
+}
+
+
+PipelineRegistry::PipelineRegistry ( const Runtime& i_runtime ) :
+    m_pipeline_cache( VK_NULL_HANDLE ),
+    m_runtime       ( i_runtime      )
+{
+}
+
+
+PipelineRegistry::~PipelineRegistry()
+{
+}
+
+
+bool PipelineRegistry::initialize()
+{
+    std::vector<char> initial_data;
+    loadPipelineCache( initial_data );
+
+    VkPipelineCacheCreateInfo cache_info{};
+    cache_info.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cache_info.initialDataSize = initial_data.size();
+    cache_info.pInitialData    = initial_data.empty() ? nullptr : initial_data.data();
+
+    if( vkCreatePipelineCache( m_runtime.m_renderer->getDevice()->getLogicalDevice(), &cache_info, nullptr, &m_pipeline_cache ) != VK_SUCCESS )
+    {
+        throw MiniEngineException( "Error creating the pipeline cache" );
+    }
+
+    return true;
+}
+
+
+void PipelineRegistry::shutdown()
+{
+    VkDevice device = m_runtime.m_renderer->getDevice()->getLogicalDevice();
+
+    //whatever a pass did not release goes with the registry
+    for( auto& pipeline : m_pipelines )
+    {
+        vkDestroyPipeline( device, pipeline.second.m_handle, nullptr );
+    }
+    for( auto& layout : m_pipeline_layouts )
+    {
+        vkDestroyPipelineLayout( device, layout.second.m_handle, nullptr );
+    }
+    for( auto& layout : m_descriptor_set_layouts )
+    {
+        vkDestroyDescriptorSetLayout( device, layout.second.m_handle, nullptr );
+    }
+
+    m_pipelines             .clear();
+    m_pipeline_layouts      .clear();
+    m_descriptor_set_layouts.clear();
+
+    if( m_pipeline_cache != VK_NULL_HANDLE )
+    {
+        savePipelineCache();
+
+        vkDestroyPipelineCache( device, m_pipeline_cache, nullptr );
+        m_pipeline_cache = VK_NULL_HANDLE;
+    }
+}
+
+
+VkDescriptorSetLayout PipelineRegistry::getDescriptorSetLayout( const VkDescriptorSetLayoutCreateInfo& i_info )
+{
+    PipelineStateKey key = hashDescriptorSetLayout( i_info );
+
+    auto stored_layout = m_descriptor_set_layouts.find( key );
+    if( stored_layout != m_descriptor_set_layouts.end() )
+    {
+        stored_layout->second.m_references++;
+        return stored_layout->second.m_handle;
+    }
+
+    VkDescriptorSetLayout new_layout = VK_NULL_HANDLE;
+    if( vkCreateDescriptorSetLayout( m_runtime.m_renderer->getDevice()->getLogicalDevice(), &i_info, nullptr, &new_layout ) != VK_SUCCESS )
+    {
+        throw MiniEngineException( "Error creating the descriptor set layout" );
+    }
+
+    m_descriptor_set_layouts.insert( { std::move( key ), { new_layout, 1 } } );
+
+    return new_layout;
+}
+
+
+void PipelineRegistry::releaseDescriptorSetLayout( VkDescriptorSetLayout i_layout )
+{
+    VkDevice device = m_runtime.m_renderer->getDevice()->getLogicalDevice();
+
+    releaseEntry( m_descriptor_set_layouts, i_layout, [ device ]( VkDescriptorSetLayout i_handle ) { vkDestroyDescriptorSetLayout( device, i_handle, nullptr ); } );
+}
+
+
+VkPipelineLayout PipelineRegistry::getPipelineLayout( const VkPipelineLayoutCreateInfo& i_info )
+{
+    PipelineStateKey key = hashPipelineLayout( i_info );
+
+    auto stored_layout = m_pipeline_layouts.find( key );
+    if( stored_layout != m_pipeline_layouts.end() )
+    {
+        stored_layout->second.m_references++;
+        return stored_layout->second.m_handle;
+    }
+
+    VkPipelineLayout new_layout = VK_NULL_HANDLE;
+    if( vkCreatePipelineLayout( m_runtime.m_renderer->getDevice()->getLogicalDevice(), &i_info, nullptr, &new_layout ) != VK_SUCCESS )
+    {
+        throw MiniEngineException( "failed to create pipeline layout!" );
+    }
+
+    m_pipeline_layouts.insert( { std::move( key ), { new_layout, 1 } } );
+
+    return new_layout;
+}
+
+
+void PipelineRegistry::releasePipelineLayout( VkPipelineLayout i_layout )
+{
+    VkDevice device = m_runtime.m_renderer->getDevice()->getLogicalDevice();
+
+    releaseEntry( m_pipeline_layouts, i_layout, [ device ]( VkPipelineLayout i_handle ) { vkDestroyPipelineLayout( device, i_handle, nullptr ); } );
+}
+
+
+void PipelineRegistry::getGraphicsPipelines( const std::vector<VkGraphicsPipelineCreateInfo>& i_infos, std::vector<VkPipeline>& o_pipelines )
+{
+    const uint32_t count = static_cast<uint32_t>( i_infos.size() );
+
+    //the first request of every state that is not stored yet, equal states inside the batch are compiled once
+    std::vector<PipelineStateKey>                                        keys( count );
+    std::vector<uint32_t>                                                to_compile;
+    std::unordered_map<PipelineStateKey, uint32_t, PipelineStateKeyHash> first_request;
+
+    for( uint32_t id = 0; id < count; id++ )
+    {
+        keys[ id ] = hashGraphicsPipeline( i_infos[ id ] );
+
+        if( m_pipelines.find( keys[ id ] ) == m_pipelines.end() && first_request.insert( { keys[ id ], id } ).second )
+        {
+            to_compile.push_back( id );
+        }
+    }
+
+    //each worker goes through the shared cache, it is internally synchronized
+    std::vector<VkPipeline> compiled( to_compile.size(), VK_NULL_HANDLE );
+    VkDevice                device = m_runtime.m_renderer->getDevice()->getLogicalDevice();
+
+    auto compile = [ & ]( const uint32_t i_begin, const uint32_t i_end )
+    {
+        for( uint32_t id = i_begin; id < i_end; id++ )
+        {
+            if( vkCreateGraphicsPipelines( device, m_pipeline_cache, 1, &i_infos[ to_compile[ id ] ], nullptr, &compiled[ id ] ) != VK_SUCCESS )
+            {
+                throw MiniEngineException( "Error creating the pipeline" );
+            }
+        }
+    };
+
+    try
+    {
+        if( m_runtime.m_command_recorder )
+        {
+            m_runtime.m_command_recorder->parallelFor( static_cast<uint32_t>( to_compile.size() ), 1, compile );
+        }
+        else
+        {
+            compile( 0, static_cast<uint32_t>( to_compile.size() ) );
+        }
+    }
+    catch( ... )
+    {
+        //every chunk is done by now, what the others compiled is not in m_pipelines and nobody would destroy it
+        for( VkPipeline pipeline : compiled )
+        {
+            if( pipeline != VK_NULL_HANDLE )
+            {
+                vkDestroyPipeline( device, pipeline, nullptr );
+            }
+        }
+
+        throw;
+    }
+
+    for( uint32_t id = 0; id < static_cast<uint32_t>( to_compile.size() ); id++ )
+    {
+        m_pipelines.insert( { keys[ to_compile[ id ] ], { compiled[ id ], 0 } } );
+    }
+
+    o_pipelines.resize( count );
+    for( uint32_t id = 0; id < count; id++ )
+    {
+        Entry<VkPipeline>& entry = m_pipelines.at( keys[ id ] );
+        entry.m_references++;
+
+        o_pipelines[ id ] = entry.m_handle;
+    }
+}
+
+
+VkPipeline PipelineRegistry::getGraphicsPipeline( const VkGraphicsPipelineCreateInfo& i_info )
+{
+    std::vector<VkPipeline> pipelines;
+    getGraphicsPipelines( { i_info }, pipelines );
+
+    return pipelines[ 0 ];
+}
+
+
+void PipelineRegistry::releasePipeline( VkPipeline i_pipeline )
+{
+    VkDevice device = m_runtime.m_renderer->getDevice()->getLogicalDevice();
+
+    releaseEntry( m_pipelines, i_pipeline, [ device ]( VkPipeline i_handle ) { vkDestroyPipeline( device, i_handle, nullptr ); } );
+}
+
+
+void PipelineRegistry::loadPipelineCache( std::vector<char>& o_data ) const
+{
+    o_data.clear();
+
+    std::ifstream file( kPIPELINE_CACHE_FILE, std::ios::binary );
+    if( !file.is_open() )
+    {
+        return;
+    }
+
+    PipelineCacheHeader header{};
+    if( !file.read( reinterpret_cast<char*>( &header ), sizeof( PipelineCacheHeader ) ) )
+    {
+        return;
+    }
+
+    const PipelineCacheHeader expected = makeHeader( m_runtime.m_renderer->getDevice()->getPhysicalDeviceProperties(), header.m_data_size );
+    if( memcmp( &header, &expected, sizeof( PipelineCacheHeader ) ) != 0 )
+    {
+        std::cout << "Pipeline cache from another device or driver, it will be rebuilt" << std::endl;
+        return;
+    }
+
+    o_data.resize( static_cast<size_t>( header.m_data_size ) );
+    if( !file.read( o_data.data(), o_data.size() ) )
+    {
+        o_data.clear();
+    }
+}
+
+
+void PipelineRegistry::savePipelineCache() const
+{
+    VkDevice device = m_runtime.m_renderer->getDevice()->getLogicalDevice();
+
+    size_t data_size = 0;
+    if( vkGetPipelineCacheData( device, m_pipeline_cache, &data_size, nullptr ) != VK_SUCCESS || data_size == 0 )
+    {
+        return;
+    }
+
+    std::vector<char> data( data_size );
+    if( vkGetPipelineCacheData( device, m_pipeline_cache, &data_size, data.data() ) != VK_SUCCESS )
+    {
+        return;
+    }
+
+    const PipelineCacheHeader header = makeHeader( m_runtime.m_renderer->getDevice()->getPhysicalDeviceProperties(), data_size );
+
+    std::ofstream file( kPIPELINE_CACHE_FILE, std::ios::binary | std::ios::trunc );
+    if( !file.is_open() )
+    {
+        std::cout << "Cannot write the pipeline cache " << kPIPELINE_CACHE_FILE << std::endl;
+        return;
+    }
+
+    file.write( reinterpret_cast<const char*>( &header ), sizeof( PipelineCacheHeader ) );
+    file.write( data.data(), data_size );
+}
@@ -0,0 +1,117 @@
+#include "rangeAllocator.h"
+
+using namespace MiniEngine;
+
+
+RangeAllocator::RangeAllocator( const uint32_t i_size ) :
+    m_size     ( 0 ),
+    m_free_size( 0 )
+{
+    reset( i_size );
+}
+
+
+void RangeAllocator::reset( const uint32_t i_size )
+{
+    m_blocks_by_offset.clear();
+    m_blocks_by_size  .clear();
+
+    m_size      = i_size;
+    m_free_size = 0;
+
+    if( i_size > 0 )
+    {
+        insertBlock( 0, i_size );
+    }
+}
+
+
+uint32_t RangeAllocator::allocate( const uint32_t i_size )
+{
+    if( i_size == 0 )
+    {
+        return kINVALID_OFFSET;
+    }
+
+    auto best = m_blocks_by_size.lower_bound( i_size );
+    if( best == m_blocks_by_size.end() )
+    {
+        return kINVALID_OFFSET;
+    }
+
+    const uint32_t offset = best->second;
+    const uint32_t size   = best->first;
+
+    eraseBlock( m_blocks_by_offset.find( offset ) );
+
+    //the rest of the block goes back to the list
+    if( size > i_size )
+    {
+        insertBlock( offset + i_size, size - i_size );
+    }
+
+    return offset;
+}
+
+
+void RangeAllocator::free( const uint32_t i_offset, const uint32_t i_size )
+{
+    assert( i_size > 0 && static_cast<uint64_t>( i_offset ) + i_size <= m_size );
+
+    uint32_t offset = i_offset;
+    uint32_t size   = i_size;
+
+    //merge with the free block right after
+    auto next = m_blocks_by_offset.lower_bound( offset );
+    assert( next == m_blocks_by_offset.end() || next->first >= offset + size );
+
+    if( next != m_blocks_by_offset.end() && next->first == offset + size )
+    {
+        size += next->second;
+        next  = std::next( next );
+        eraseBlock( std::prev( next ) );
+    }
+
+    //and with the one right before
+    if( next != m_blocks_by_offset.begin() )
+    {
+        auto previous = std::prev( next );
+        assert( previous->first + previous->second <= offset );
+
+        if( previous->first + previous->second == offset )
+        {
+            offset  = previous->first;
+            size   += previous->second;
+            eraseBlock( previous );
+        }
+    }
+
+    insertBlock( offset, size );
+}
+
+
+void RangeAllocator::insertBlock( const uint32_t i_offset, const uint32_t i_size )
+{
+    m_blocks_by_offset.emplace( i_offset, i_size );
+    m_blocks_by_size  .emplace( i_size, i_offset );
+
+    m_free_size += i_size;
+}
+
+
+void RangeAllocator::eraseBlock( std::map<uint32_t, uint32_t>::iterator i_block )
+{
+    auto range = m_blocks_by_size.equal_range( i_block->second );
+
+    for( auto it = range.first; it != range.second; ++it )
+    {
+        if( it->second == i_block->first )
+        {
+            m_blocks_by_size.erase( it );
+            break;
+        }
+    }
+
+    m_free_size -= i_block->second;
+    m_blocks_by_offset.erase( i_block );
+}
@@ -2,28 +2,61 @@
 #include "vulkan/rendererVK.h"
 #include "vulkan/deviceVK.h"
 #include "vulkan/utilsVK.h"
+#include "vulkan/frameAllocatorVK.h"
+#include "vulkan/commandRecorderVK.h"
 #include "frame.h"
 
 using namespace MiniEngine;
 
 
+namespace
+{
+    //worst case padding added by the device offset alignments, the spec caps them to 256 bytes
+    constexpr VkDeviceSize kMAX_OFFSET_ALIGNMENT = 256;
+}
+
+
+const std::array<VkBuffer, kMAX_NUMBER_OF_FRAMES> Runtime::getUploadBuffer() const
+{
+    std::array<VkBuffer, kMAX_NUMBER_OF_FRAMES> buffers;
+
+    for( uint32_t id = 0; id < m_frame_allocator.size(); id++ )
+    {
+        buffers[ id ] = m_frame_allocator[ id ] ? m_frame_allocator[ id ]->getBuffer() : VK_NULL_HANDLE;
+    }
+
+    return buffers;
+}
+
+
 void Runtime::createResources()
 {
-    for( uint32_t id = 0; id < m_per_frame_buffer.size(); id++ )
+    //the per object part is the staging of the worst case, every object dirty in the same frame
+    const VkDeviceSize upload_size = sizeof( PerFrameData ) + sizeof( PerObjectData ) * kMAX_NUMBER_OF_OBJECTS + 2 * kMAX_OFFSET_ALIGNMENT;
+
+    for( uint32_t id = 0; id < m_frame_allocator.size(); id++ )
     {
-        if( VK_NULL_HANDLE == m_per_frame_buffer[ id ] )
+        if( !m_frame_allocator[ id ] )
         {
-            UtilsVK::createBuffer( *m_renderer->getDevice(), sizeof( PerFrameData ), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_per_frame_buffer[ id ], m_per_frame_buffer_memory[ id ] );
+            m_frame_allocator[ id ] = std::make_unique<FrameAllocatorVK>( *m_renderer->getDevice() );
+            m_frame_allocator[ id ]->initialize( upload_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT );
         }
+    }
 
-        if( VK_NULL_HANDLE == m_per_object_buffer[ id ] )
-        {
-            UtilsVK::createBuffer( *m_renderer->getDevice(), sizeof( PerObjectData ) * kMAX_NUMBER_OF_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_per_object_buffer[ id ], m_per_object_buffer_memory[ id ] );
-        }
+    if( !m_command_recorder )
+    {
+        //the main thread records too, so one worker less than the hardware threads
+        const uint32_t threads = std::min( kMAX_RECORDING_THREADS, std::max( std::thread::hardware_concurrency(), 1u ) );
 
-        if (VK_NULL_HANDLE == m_kernel_buffer[id]) {
-            UtilsVK::createBuffer(*m_renderer->getDevice(), sizeof(KernelSSAO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_kernel_buffer[id], m_kernel_buffer_mem[id]);
-        }
+        m_command_recorder = std::make_unique<CommandRecorderVK>( *m_renderer->getDevice() );
+        m_command_recorder->initialize( threads - 1 );
+        m_command_recorder->setRecordOnce( kRECORD_ONCE_COMMAND_BUFFERS );
+    }
+
+    if( VK_NULL_HANDLE == m_per_object_buffer )
+    {
+        UtilsVK::createBuffer( *m_renderer->getDevice(), sizeof( PerObjectData ) * kMAX_NUMBER_OF_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_per_object_buffer, m_per_object_buffer_memory );
+        UtilsVK::setObjectName( m_renderer->getDevice()->getLogicalDevice(), (uint64_t)m_per_object_buffer, VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, "Per Object Buffer" );
     }
     
 }
@@ -31,28 +64,27 @@ void Runtime::createResources()
 
 void Runtime::freeResources()
 {
-    for( uint32_t id = 0; id < m_per_frame_buffer.size(); id++ )
+    if( m_command_recorder )
     {
-        if( VK_NULL_HANDLE != m_per_frame_buffer[ id ] )
-        {
-            vkDestroyBuffer( m_renderer->getDevice()->getLogicalDevice(), m_per_frame_buffer       [ id ], nullptr );
-            vkFreeMemory   ( m_renderer->getDevice()->getLogicalDevice(), m_per_frame_buffer_memory[ id ], nullptr );
-
-            m_per_frame_buffer[ id ] = VK_NULL_HANDLE;
-        }
+        m_command_recorder->shutdown();
+        m_command_recorder = nullptr;
+    }
 
-        if( VK_NULL_HANDLE != m_per_object_buffer[ id ] )
+    for( uint32_t id = 0; id < m_frame_allocator.size(); id++ )
+    {
+        if( m_frame_allocator[ id ] )
         {
-            vkDestroyBuffer( m_renderer->getDevice()->getLogicalDevice(), m_per_object_buffer       [ id ], nullptr );
-            vkFreeMemory   ( m_renderer->getDevice()->getLogicalDevice(), m_per_object_buffer_memory[ id ], nullptr );
-
-            m_per_object_buffer[ id ] = VK_NULL_HANDLE;
+            m_frame_allocator[ id ]->shutdown();
+            m_frame_allocator[ id ] = nullptr;
         }
+    }
 
-        if (VK_NULL_HANDLE != m_kernel_buffer[id])
-        {
-            vkDestroyBuffer(m_renderer->getDevice()->getLogicalDevice(), m_kernel_buffer[id], nullptr);
-            vkFreeMemory(m_renderer->getDevice()->getLogicalDevice(), m_kernel_buffer_mem[id], nullptr);
-        }
+    if( VK_NULL_HANDLE != m_per_object_buffer )
+    {
+        vkDestroyBuffer( m_renderer->getDevice()->getLogicalDevice(), m_per_object_buffer       , nullptr );
+        vkFreeMemory   ( m_renderer->getDevice()->getLogicalDevice(), m_per_object_buffer_memory, nullptr );
+
+        m_per_object_buffer        = VK_NULL_HANDLE;
+        m_per_object_buffer_memory = VK_NULL_HANDLE;
     }
 }
\ No newline at end of file
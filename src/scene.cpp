@@ -2,6 +2,8 @@
 #include "camera.h"
 #include "light.h"
 #include "entity.h"
+#include "meshRegistry.h"
+#include "runtime.h"
 #include "common.h"
 
 
@@ -137,6 +139,25 @@ std::shared_ptr<Scene> Scene::loadScene( const Runtime& i_runtime, const std::st
      CameraPtr camera = Camera::createCamera( i_runtime, scene_node.child("camera") );
      scene->m_camera = camera;
      
+     //every mesh of the scene goes to the loaders up front, they import them in parallel and createEntity below
+     //only finds the handles. The entities are still created one by one in document order, their ids don't
+     //depend on the loads
+     for(pugi::xml_node node = scene_node.child("mesh"); node; node = node.next_sibling("mesh"))
+     {
+         auto filename = node.find_child_by_attribute( "name", "filename" );
+
+         if( !node.child("emitter") && strcmp( node.attribute("type").value(), "obj" ) == 0 && filename )
+         {
+             i_runtime.m_mesh_registry->loadMeshAsync( filename.attribute("value").value() );
+         }
+     }
+
+     //without asynchronous loading the scene is whole before its first frame
+     if( !kASYNC_MESH_LOADING )
+     {
+         i_runtime.m_mesh_registry->waitLoaded();
+     }
+
      uint32_t entity_id = 0;
      //parse objects
      for(pugi::xml_node node = scene_node.child("mesh"); node; node = node.next_sibling("mesh"))
@@ -0,0 +1,247 @@
+#include "vertexWelder.h"
+#include "workerPool.h"
+
+#include <cmath>
+#include <cstring>
+
+using namespace MiniEngine;
+
+
+namespace
+{
+    constexpr uint32_t kEMPTY_SLOT = UINT32_MAX;
+
+    //position, normal and uv in grid cells
+    struct VertexKey
+    {
+        int32_t m_cells[ 8 ];
+
+        bool operator==( const VertexKey& i_other ) const
+        {
+            return memcmp( m_cells, i_other.m_cells, sizeof( m_cells ) ) == 0;
+        }
+    };
+
+    //the hash is kept next to the vertex so most probes never touch the keys
+    struct Slot
+    {
+        uint32_t m_hash;
+        uint32_t m_vertex;
+    };
+
+    struct WeldedShape
+    {
+        std::vector<Vertex>   m_vertices;
+        std::vector<uint32_t> m_indices;
+        MeshBounds            m_bounds;
+        size_t                m_vertex_offset;
+        size_t                m_index_offset;
+    };
+
+
+    int32_t toCell( const float i_value, const float i_inverse_epsilon )
+    {
+        //exact comparison, +0 and -0 are the same value
+        if( i_inverse_epsilon == 0.0f )
+        {
+            const float value = i_value == 0.0f ? 0.0f : i_value;
+
+            int32_t bits;
+            memcpy( &bits, &value, sizeof( int32_t ) );
+            return bits;
+        }
+
+        const double cell = std::floor( static_cast<double>( i_value ) * i_inverse_epsilon + 0.5 );
+        return static_cast<int32_t>( std::max( std::min( cell, 2147483647.0 ), -2147483648.0 ) );
+    }
+
+
+    VertexKey makeKey( const Vertex& i_vertex, const float i_inverse_epsilon )
+    {
+        const float values[ 8 ] =
+        {
+            i_vertex.m_position.x, i_vertex.m_position.y, i_vertex.m_position.z,
+            i_vertex.m_normal.x  , i_vertex.m_normal.y  , i_vertex.m_normal.z  ,
+            i_vertex.m_uv.x      , i_vertex.m_uv.y
+        };
+
+        VertexKey key;
+        for( uint32_t id = 0; id < 8; id++ )
+        {
+            key.m_cells[ id ] = toCell( values[ id ], i_inverse_epsilon );
+        }
+
+        return key;
+    }
+
+
+    uint32_t hashKey( const VertexKey& i_key )
+    {
+        uint64_t hash = 0x9e3779b97f4a7c15ull;
+
+        for( auto cell : i_key.m_cells )
+        {
+            hash ^= static_cast<uint32_t>( cell );
+            hash *= 0xff51afd7ed558ccdull;
+            hash ^= hash >> 32;
+        }
+
+        return static_cast<uint32_t>( hash );
+    }
+
+
+    Vertex makeVertex( const ObjParser::Mesh& i_mesh, const ObjParser::Index& i_index )
+    {
+        Vertex vertex;
+        vertex.m_position =
+        {
+             i_mesh.m_positions[ 3 * i_index.m_vertex_index + 0 ],
+             i_mesh.m_positions[ 3 * i_index.m_vertex_index + 1 ],
+             i_mesh.m_positions[ 3 * i_index.m_vertex_index + 2 ]
+        };
+
+        if( i_index.m_normal_index >= 0 )
+        {
+            vertex.m_normal =
+            {
+                 i_mesh.m_normals[ 3 * i_index.m_normal_index + 0 ],
+                 i_mesh.m_normals[ 3 * i_index.m_normal_index + 1 ],
+                 i_mesh.m_normals[ 3 * i_index.m_normal_index + 2 ]
+            };
+        }
+
+        if( i_index.m_texcoord_index >= 0 )
+        {
+            vertex.m_uv =
+            {
+                i_mesh.m_texcoords[ 2 * i_index.m_texcoord_index + 0 ],
+                i_mesh.m_texcoords[ 2 * i_index.m_texcoord_index + 1 ]
+            };
+        }
+
+        return vertex;
+    }
+
+
+    void weldShape( const ObjParser::Mesh& i_mesh, const uint32_t i_begin, const uint32_t i_end, const float i_inverse_epsilon, WeldedShape& o_shape )
+    {
+        const uint32_t corners = i_end - i_begin;
+
+        //never more vertices than corners, at twice that the table stays at most half full
+        uint32_t capacity = 16;
+        while( capacity < 2 * corners )
+        {
+            capacity <<= 1;
+        }
+
+        std::vector<Slot>      slots( capacity, { 0, kEMPTY_SLOT } );
+        std::vector<VertexKey> keys;
+
+        keys              .reserve( corners );
+        o_shape.m_vertices.reserve( corners );
+        o_shape.m_indices .resize ( corners );
+
+        for( uint32_t corner = 0; corner < corners; corner++ )
+        {
+            const Vertex    vertex = makeVertex( i_mesh, i_mesh.m_indices[ i_begin + corner ] );
+            const VertexKey key    = makeKey( vertex, i_inverse_epsilon );
+            const uint32_t  hash   = hashKey( key );
+
+            //linear probing
+            uint32_t slot = hash & ( capacity - 1 );
+
+            while( slots[ slot ].m_vertex != kEMPTY_SLOT && ( slots[ slot ].m_hash != hash || !( keys[ slots[ slot ].m_vertex ] == key ) ) )
+            {
+                slot = ( slot + 1 ) & ( capacity - 1 );
+            }
+
+            if( slots[ slot ].m_vertex == kEMPTY_SLOT )
+            {
+                slots[ slot ] = { hash, static_cast<uint32_t>( keys.size() ) };
+
+                keys              .push_back( key );
+                o_shape.m_vertices.push_back( vertex );
+                o_shape.m_bounds  .extend( vertex.m_position );
+            }
+
+            o_shape.m_indices[ corner ] = slots[ slot ].m_vertex;
+        }
+    }
+
+
+    void runJob( WorkerPool* i_workers, const uint32_t i_count, const std::function<void( uint32_t, uint32_t )>& i_job )
+    {
+        if( i_workers )
+        {
+            i_workers->parallelFor( i_count, 1, i_job );
+        }
+        else
+        {
+            i_job( 0, i_count );
+        }
+    }
+}
+
+
+void VertexWelder::weld(
+    const ObjParser::Mesh& i_mesh,
+    const float            i_epsilon,
+    WorkerPool*            i_workers,
+    std::vector<Vertex>&   o_vertices,
+    std::vector<uint32_t>& o_indices,
+    MeshBounds&            o_bounds )
+{
+    const float    inverse_epsilon = i_epsilon > 0.0f ? 1.0f / i_epsilon : 0.0f;
+    const uint32_t shape_count     = static_cast<uint32_t>( i_mesh.m_shapes.size() );
+
+    std::vector<WeldedShape> shapes( shape_count );
+
+    runJob( i_workers, shape_count, [ & ]( const uint32_t i_begin, const uint32_t i_end )
+    {
+        for( uint32_t id = i_begin; id < i_end; id++ )
+        {
+            const uint32_t begin = i_mesh.m_shapes[ id ];
+            const uint32_t end   = id + 1 < shape_count ? i_mesh.m_shapes[ id + 1 ] : static_cast<uint32_t>( i_mesh.m_indices.size() );
+
+            weldShape( i_mesh, begin, end, inverse_epsilon, shapes[ id ] );
+        }
+    } );
+
+    //exclusive scan, the indices of a shape move by the vertices of the shapes before it
+    size_t vertices = 0;
+    size_t indices  = 0;
+
+    for( auto& shape : shapes )
+    {
+        shape.m_vertex_offset = vertices;
+        shape.m_index_offset  = indices;
+
+        vertices += shape.m_vertices.size();
+        indices  += shape.m_indices .size();
+
+        if( !shape.m_vertices.empty() )
+        {
+            o_bounds.extend( shape.m_bounds.m_min );
+            o_bounds.extend( shape.m_bounds.m_max );
+        }
+    }
+
+    o_vertices.resize( vertices );
+    o_indices .resize( indices  );
+
+    runJob( i_workers, shape_count, [ & ]( const uint32_t i_begin, const uint32_t i_end )
+    {
+        for( uint32_t id = i_begin; id < i_end; id++ )
+        {
+            const WeldedShape& shape  = shapes[ id ];
+            const uint32_t     offset = static_cast<uint32_t>( shape.m_vertex_offset );
+
+            std::copy( shape.m_vertices.begin(), shape.m_vertices.end(), o_vertices.begin() + shape.m_vertex_offset );
+
+            for( size_t index = 0; index < shape.m_indices.size(); index++ )
+            {
+                o_indices[ shape.m_index_offset + index ] = shape.m_indices[ index ] + offset;
+            }
+        }
+    } );
+}
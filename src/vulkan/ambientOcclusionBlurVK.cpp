@@ -1,5 +1,6 @@
 #include "common.h"
 #include "vulkan/utilsVK.h"
+#include "vulkan/commandRecorderVK.h"
 #include "vulkan/ambientOcclusionBlurVK.h"
 #include "vulkan/rendererVK.h"
 #include "vulkan/deviceVK.h"
@@ -7,9 +8,11 @@
 #include "runtime.h"
 #include "frame.h"
 #include "shaderRegistry.h"
+#include "pipelineRegistry.h"
 #include "meshRegistry.h"
 #include "entity.h"
 #include "vulkan/meshVK.h"
+#include "vulkan/geometryPoolVK.h"
 
 using namespace MiniEngine;
 
@@ -23,10 +26,6 @@ AmbientOcclusionBlurVK::AmbientOcclusionBlurVK(
     m_ssao_attachment(i_ssao_attachment),
     m_ssao_blur_attachment(i_ssao_blur_attachment)
 {
-    for (auto cmd : m_command_buffer)
-    {
-        cmd = VK_NULL_HANDLE;
-    }
 }
 
 
@@ -37,10 +36,8 @@ AmbientOcclusionBlurVK::~AmbientOcclusionBlurVK()
 
 bool AmbientOcclusionBlurVK::initialize()
 {
-    RendererVK& renderer = *m_runtime.m_renderer;
-
     // load plane
-    m_plane = m_runtime.m_mesh_registry->loadMesh("./scenes/quad.obj");
+    m_plane = m_runtime.m_mesh_registry->loadMesh("./scenes/quad.obj", VertexLayout::Full);
 
     assert(m_plane != nullptr);
 
@@ -73,15 +70,6 @@ bool AmbientOcclusionBlurVK::initialize()
     createPipelines();
     createFbo();
 
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
-
-    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.commandPool = renderer.getDevice()->getCommandPool();
-    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandBufferAllocateInfo.commandBufferCount = 3;
-
-    vkAllocateCommandBuffers(renderer.getDevice()->getLogicalDevice(), &commandBufferAllocateInfo, m_command_buffer.data());
-
     return true;
 }
 
@@ -90,18 +78,16 @@ void AmbientOcclusionBlurVK::shutdown()
 {
     RendererVK& renderer = *m_runtime.m_renderer;
 
-    vkFreeCommandBuffers(renderer.getDevice()->getLogicalDevice(), renderer.getDevice()->getCommandPool(), m_command_buffer.size(), m_command_buffer.data());
-
     vkDestroyDescriptorPool(renderer.getDevice()->getLogicalDevice(), m_descriptor_pool, nullptr);
-    vkDestroyDescriptorSetLayout(renderer.getDevice()->getLogicalDevice(), m_descriptor_set_layout, nullptr);
+    m_runtime.m_pipeline_registry->releaseDescriptorSetLayout(m_descriptor_set_layout);
 
     for (uint32 id = 0; id < static_cast<uint32>(renderer.getWindow().getImageCount()); id++)
     {
         vkDestroyFramebuffer(renderer.getDevice()->getLogicalDevice(), m_fbos[id], nullptr);
     }
 
-    vkDestroyPipeline(renderer.getDevice()->getLogicalDevice(), m_composition_pipeline, nullptr);
-    vkDestroyPipelineLayout(renderer.getDevice()->getLogicalDevice(), m_pipeline_layouts, nullptr);
+    m_runtime.m_pipeline_registry->releasePipeline(m_composition_pipeline);
+    m_runtime.m_pipeline_registry->releasePipelineLayout(m_pipeline_layouts);
 
     vkDestroyRenderPass(renderer.getDevice()->getLogicalDevice(), m_render_pass, nullptr);
 }
@@ -109,26 +95,18 @@ void AmbientOcclusionBlurVK::shutdown()
 
 VkCommandBuffer AmbientOcclusionBlurVK::draw(const Frame& i_frame)
 {
-    RendererVK& renderer = *m_runtime.m_renderer;
-
-    VkCommandBuffer& current_cmd = m_command_buffer[renderer.getWindow().getCurrentImageId()];
-
-    if (current_cmd != VK_NULL_HANDLE)
-    {
-        VkCommandBufferResetFlags flags{};
-        vkResetCommandBuffer(current_cmd, flags);
-    }
+    VkCommandBuffer current_cmd = m_runtime.m_command_recorder->allocate(i_frame.m_frame_id, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
     VkCommandBufferBeginInfo begin_info{};
     begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-    uint32_t width = 0, height = 0;
-    renderer.getWindow().getWindowSize(width, height);
+    uint32_t width = m_ssao_blur_attachment.m_extent.width;
+    uint32_t height = m_ssao_blur_attachment.m_extent.height;
 
     VkRenderPassBeginInfo render_pass_info{};
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     render_pass_info.renderPass = m_render_pass;
-    render_pass_info.framebuffer = m_fbos[renderer.getWindow().getCurrentImageId()];
+    render_pass_info.framebuffer = m_fbos[i_frame.m_image_id];
     render_pass_info.renderArea.offset = { 0, 0 };
     render_pass_info.renderArea.extent = { width, height };
 
@@ -147,8 +125,10 @@ VkCommandBuffer AmbientOcclusionBlurVK::draw(const Frame& i_frame)
     vkCmdBeginRenderPass(current_cmd, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
 
     vkCmdBindPipeline(current_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_composition_pipeline);
-    vkCmdBindDescriptorSets(current_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layouts, 0, 1, &m_descriptor_sets[renderer.getWindow().getCurrentImageId()].m_textures_descriptor, 0, NULL);
+    UtilsVK::setViewport(current_cmd, width, height);
+    vkCmdBindDescriptorSets(current_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layouts, 0, 1, &m_descriptor_sets[i_frame.m_frame_id].m_textures_descriptor, 1, &i_frame.m_per_frame_offset);
 
+    m_runtime.m_geometry_pool->bind(current_cmd, VertexLayout::Full, VertexStreams::All);
     m_plane->draw(current_cmd, 0);
 
     vkCmdEndRenderPass(current_cmd);
@@ -163,13 +143,27 @@ VkCommandBuffer AmbientOcclusionBlurVK::draw(const Frame& i_frame)
 }
 
 
+void AmbientOcclusionBlurVK::resize()
+{
+    RendererVK& renderer = *m_runtime.m_renderer;
+
+    for (auto fbo : m_fbos)
+    {
+        vkDestroyFramebuffer(renderer.getDevice()->getLogicalDevice(), fbo, nullptr);
+    }
+
+    createFbo();
+    updateDescriptors();
+}
+
+
 
 void AmbientOcclusionBlurVK::createFbo()
 {
     RendererVK& renderer = *m_runtime.m_renderer;
 
-    uint32_t width = 0, height = 0;
-    renderer.getWindow().getWindowSize(width, height);
+    uint32_t width = m_ssao_blur_attachment.m_extent.width;
+    uint32_t height = m_ssao_blur_attachment.m_extent.height;
 
     for (size_t i = 0; i < m_fbos.size(); i++)
     {
@@ -228,11 +222,13 @@ void AmbientOcclusionBlurVK::createRenderPass()
     // Subpass dependencies for layout transitions
     std::array<VkSubpassDependency, 1> dependencies = { {} };
 
+    // the attachment is shared by the frames in flight, wait for the reads of the previous frame before clearing it
     dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
     dependencies[0].dstSubpass = 0;
-    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[0].srcAccessMask = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
     VkRenderPassCreateInfo render_pass_info = {};
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -252,35 +248,16 @@ void AmbientOcclusionBlurVK::createRenderPass()
 
 void AmbientOcclusionBlurVK::createPipelines()
 {
-    RendererVK& renderer = *m_runtime.m_renderer;
-
-    VkVertexInputBindingDescription binding_vertex_descrition{};
-    binding_vertex_descrition.binding = 0;
-    binding_vertex_descrition.stride = sizeof(Vertex);
-    binding_vertex_descrition.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions{};
-
-    attribute_descriptions[0].binding = 0;
-    attribute_descriptions[0].location = 0;
-    attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attribute_descriptions[0].offset = offsetof(Vertex, m_position);
-
-    attribute_descriptions[1].binding = 0;
-    attribute_descriptions[1].location = 1;
-    attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attribute_descriptions[1].offset = offsetof(Vertex, m_normal);
-
-    attribute_descriptions[2].binding = 0;
-    attribute_descriptions[2].location = 2;
-    attribute_descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    attribute_descriptions[2].offset = offsetof(Vertex, m_uv);
+    //the quad is a mesh like any other, full vertices in two streams
+    std::vector<VkVertexInputBindingDescription> binding_vertex_descritions;
+    std::vector<VkVertexInputAttributeDescription> attribute_descriptions;
+    MeshVK::getVertexInput(VertexLayout::Full, VertexStreams::All, binding_vertex_descritions, attribute_descriptions);
 
     VkPipelineVertexInputStateCreateInfo vertex_input_info{};
     vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input_info.vertexBindingDescriptionCount = 1;
+    vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(binding_vertex_descritions.size());
     vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
-    vertex_input_info.pVertexBindingDescriptions = &binding_vertex_descrition;
+    vertex_input_info.pVertexBindingDescriptions = binding_vertex_descritions.data();
     vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data();
     vertex_input_info.flags = 0;
 
@@ -340,30 +317,22 @@ void AmbientOcclusionBlurVK::createPipelines()
     multisampling.flags = 0;
 
 
-    uint32 width = 0, height = 0;
-    renderer.getWindow().getWindowSize(width, height);
-    VkExtent2D extend{ width, height };
-
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)width;
-    viewport.height = (float)height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor{};
-    scissor.offset = { 0, 0 };
-    scissor.extent = extend;
-
+    //viewport and scissor are set when recording, the pipeline does not depend on the size of the window
     VkPipelineViewportStateCreateInfo viewport_state{};
     viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewport_state.viewportCount = 1;
-    viewport_state.pViewports = &viewport;
+    viewport_state.pViewports = nullptr;
     viewport_state.scissorCount = 1;
-    viewport_state.pScissors = &scissor;
+    viewport_state.pScissors = nullptr;
     viewport_state.flags = 0;
 
+    std::array<VkDynamicState, 2> dynamic_states = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    VkPipelineDynamicStateCreateInfo dynamic_state{};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size());
+    dynamic_state.pDynamicStates = dynamic_states.data();
+
     VkPipelineDepthStencilStateCreateInfo depth_stencil{};
     depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
     depth_stencil.depthTestEnable = VK_FALSE;
@@ -373,13 +342,9 @@ void AmbientOcclusionBlurVK::createPipelines()
     depth_stencil.stencilTestEnable = VK_FALSE;
     depth_stencil.flags = 0;
 
-    std::vector<VkGraphicsPipelineCreateInfo> graphic_pipelines;
 
 
-    if (vkCreatePipelineLayout(renderer.getDevice()->getLogicalDevice(), &pipeline_layout_info, nullptr, &m_pipeline_layouts) != VK_SUCCESS)
-    {
-        throw MiniEngineException("failed to create pipeline layout!");
-    }
+    m_pipeline_layouts = m_runtime.m_pipeline_registry->getPipelineLayout(pipeline_layout_info);
 
     VkGraphicsPipelineCreateInfo pipeline_info{};
     pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -393,20 +358,14 @@ void AmbientOcclusionBlurVK::createPipelines()
     pipeline_info.pMultisampleState = &multisampling;
     pipeline_info.pViewportState = &viewport_state;
     pipeline_info.pDepthStencilState = &depth_stencil;
-    pipeline_info.pDynamicState = VK_NULL_HANDLE;
+    pipeline_info.pDynamicState = &dynamic_state;
     pipeline_info.stageCount = m_shader_stages.size();
     pipeline_info.pStages = m_shader_stages.data();
     pipeline_info.flags = 0;
     pipeline_info.pVertexInputState = &vertex_input_info;
     pipeline_info.subpass = 0;
 
-    graphic_pipelines.push_back(pipeline_info);
-
-
-    if (vkCreateGraphicsPipelines(renderer.getDevice()->getLogicalDevice(), VK_NULL_HANDLE, 1, graphic_pipelines.data(), nullptr, &m_composition_pipeline))
-    {
-        throw MiniEngineException("Error creating the pipeline");
-    }
+    m_composition_pipeline = m_runtime.m_pipeline_registry->getGraphicsPipeline(pipeline_info);
 
 
     createDescriptors();
@@ -422,7 +381,7 @@ void AmbientOcclusionBlurVK::createDescriptorLayout()
     layout_bindings[0] = {};
     layout_bindings[0].binding = 0;
     layout_bindings[0].descriptorCount = 1;
-    layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     layout_bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
     //textura de ssao
@@ -439,10 +398,7 @@ void AmbientOcclusionBlurVK::createDescriptorLayout()
     set_attachment_color_info.flags = 0;
     set_attachment_color_info.pBindings = layout_bindings.data();
 
-    if (VK_SUCCESS != vkCreateDescriptorSetLayout(m_runtime.m_renderer->getDevice()->getLogicalDevice(), &set_attachment_color_info, nullptr, &m_descriptor_set_layout))
-    {
-        throw MiniEngineException("Error creating descriptor set");
-    }
+    m_descriptor_set_layout = m_runtime.m_pipeline_registry->getDescriptorSetLayout(set_attachment_color_info);
 }
 
 
@@ -451,7 +407,7 @@ void AmbientOcclusionBlurVK::createDescriptors()
     //create a descriptor pool that will hold 10 uniform buffers
     std::vector<VkDescriptorPoolSize> sizes =
     {
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER        , 10 },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC , 10 },
         { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10 }
     };
 
@@ -468,7 +424,7 @@ void AmbientOcclusionBlurVK::createDescriptors()
     }
 
     //create descriptors for the global buffers
-    for (uint32_t i = 0; i < m_runtime.m_renderer->getWindow().getImageCount(); i++)
+    for (uint32_t i = 0; i < kMAX_NUMBER_OF_FRAMES; i++)
     {
         //globals per frame
         VkDescriptorSetAllocateInfo alloc_per_frame_info = {};
@@ -479,10 +435,20 @@ void AmbientOcclusionBlurVK::createDescriptors()
         alloc_per_frame_info.pSetLayouts = &m_descriptor_set_layout;
 
         vkAllocateDescriptorSets(m_runtime.m_renderer->getDevice()->getLogicalDevice(), &alloc_per_frame_info, &m_descriptor_sets[i].m_textures_descriptor);
+    }
+
+    updateDescriptors();
+}
 
+
+void AmbientOcclusionBlurVK::updateDescriptors()
+{
+    //the attachments are recreated on resize, the sets are only written again
+    for (uint32_t i = 0; i < kMAX_NUMBER_OF_FRAMES; i++)
+    {
         //information about the buffer we want to point at in the descriptor
         VkDescriptorBufferInfo binfo;
-        binfo.buffer = m_runtime.getPerFrameBuffer()[i];
+        binfo.buffer = m_runtime.getUploadBuffer()[i];
         binfo.offset = 0;
         binfo.range = sizeof(PerFrameData);
 
@@ -501,7 +467,7 @@ void AmbientOcclusionBlurVK::createDescriptors()
         set_write[0].dstBinding = 0;
         set_write[0].dstSet = m_descriptor_sets[i].m_textures_descriptor;
         set_write[0].descriptorCount = 1;
-        set_write[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        set_write[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         set_write[0].pImageInfo = nullptr;
         set_write[0].pBufferInfo = &binfo;
 
@@ -1,5 +1,6 @@
 #include "common.h"
 #include "vulkan/utilsVK.h"
+#include "vulkan/commandRecorderVK.h"
 #include "vulkan/ambientOcclusionVK.h"
 #include "vulkan/rendererVK.h"
 #include "vulkan/deviceVK.h"
@@ -7,9 +8,11 @@
 #include "runtime.h"
 #include "frame.h"
 #include "shaderRegistry.h"
+#include "pipelineRegistry.h"
 #include "meshRegistry.h"
 #include "entity.h"
 #include "vulkan/meshVK.h"
+#include "vulkan/geometryPoolVK.h"
 
 using namespace MiniEngine;
 
@@ -18,17 +21,19 @@ AmbientOcclusionVK::AmbientOcclusionVK(
     const Runtime& i_runtime,
     const ImageBlock& i_in_normal_attachment,
     const ImageBlock& i_in_position_attachment,
-    const ImageBlock& i_ssao_attachment
+    const ImageBlock& i_ssao_attachment,
+    const uint32_t i_kernel_size,
+    const KernelDistribution i_kernel_distribution
 ) :
     RenderPassVK(i_runtime),
+    m_kernel_size(std::min(std::max(i_kernel_size, 1u), kSSAO_KERNEL_SIZE)),
+    m_kernel_distribution(i_kernel_distribution),
+    m_kernel_buffer(VK_NULL_HANDLE),
+    m_kernel_memory(VK_NULL_HANDLE),
     m_in_position_depth_attachment(i_in_position_attachment),
     m_in_normal_attachment(i_in_normal_attachment),
     m_ssao_attachment(i_ssao_attachment)
 {
-    for (auto cmd : m_command_buffer)
-    {
-        cmd = VK_NULL_HANDLE;
-    }
 }
 
 
@@ -39,10 +44,8 @@ AmbientOcclusionVK::~AmbientOcclusionVK()
 
 bool AmbientOcclusionVK::initialize()
 {
-    RendererVK& renderer = *m_runtime.m_renderer;
-
     // load plane
-    m_plane = m_runtime.m_mesh_registry->loadMesh("./scenes/quad.obj");
+    m_plane = m_runtime.m_mesh_registry->loadMesh("./scenes/quad.obj", VertexLayout::Full);
 
     assert(m_plane != nullptr);
 
@@ -85,19 +88,11 @@ bool AmbientOcclusionVK::initialize()
 
     UtilsVK::TextureFromBuffer(*m_runtime.m_renderer->getDevice(), text_noise, width * height * 4 * sizeof(uint8_t), VK_FORMAT_R8G8B8A8_UNORM, width, height, m_text_noise);
    
+    createKernel();
     createRenderPass();
     createPipelines();
     createFbo();
 
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
-
-    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.commandPool = renderer.getDevice()->getCommandPool();
-    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandBufferAllocateInfo.commandBufferCount = 3;
-
-    vkAllocateCommandBuffers(renderer.getDevice()->getLogicalDevice(), &commandBufferAllocateInfo, m_command_buffer.data());
-
     return true;
 }
 
@@ -106,18 +101,24 @@ void AmbientOcclusionVK::shutdown()
 {
     RendererVK& renderer = *m_runtime.m_renderer;
 
-    vkFreeCommandBuffers(renderer.getDevice()->getLogicalDevice(), renderer.getDevice()->getCommandPool(), m_command_buffer.size(), m_command_buffer.data());
-
     vkDestroyDescriptorPool(renderer.getDevice()->getLogicalDevice(), m_descriptor_pool, nullptr);
-    vkDestroyDescriptorSetLayout(renderer.getDevice()->getLogicalDevice(), m_descriptor_set_layout, nullptr);
+    m_runtime.m_pipeline_registry->releaseDescriptorSetLayout(m_descriptor_set_layout);
+
+    if (m_kernel_buffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(renderer.getDevice()->getLogicalDevice(), m_kernel_buffer, nullptr);
+        vkFreeMemory(renderer.getDevice()->getLogicalDevice(), m_kernel_memory, nullptr);
+        m_kernel_buffer = VK_NULL_HANDLE;
+        m_kernel_memory = VK_NULL_HANDLE;
+    }
 
     for (uint32 id = 0; id < static_cast<uint32>(renderer.getWindow().getImageCount()); id++)
     {
         vkDestroyFramebuffer(renderer.getDevice()->getLogicalDevice(), m_fbos[id], nullptr);
     }
 
-    vkDestroyPipeline(renderer.getDevice()->getLogicalDevice(), m_composition_pipeline, nullptr);
-    vkDestroyPipelineLayout(renderer.getDevice()->getLogicalDevice(), m_pipeline_layouts, nullptr);
+    m_runtime.m_pipeline_registry->releasePipeline(m_composition_pipeline);
+    m_runtime.m_pipeline_registry->releasePipelineLayout(m_pipeline_layouts);
 
     vkDestroyRenderPass(renderer.getDevice()->getLogicalDevice(), m_render_pass, nullptr);
 }
@@ -125,26 +126,18 @@ void AmbientOcclusionVK::shutdown()
 
 VkCommandBuffer AmbientOcclusionVK::draw(const Frame& i_frame)
 {
-    RendererVK& renderer = *m_runtime.m_renderer;
-
-    VkCommandBuffer& current_cmd = m_command_buffer[renderer.getWindow().getCurrentImageId()];
-
-    if (current_cmd != VK_NULL_HANDLE)
-    {
-        VkCommandBufferResetFlags flags{};
-        vkResetCommandBuffer(current_cmd, flags);
-    }
+    VkCommandBuffer current_cmd = m_runtime.m_command_recorder->allocate(i_frame.m_frame_id, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
     VkCommandBufferBeginInfo begin_info{};
     begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-    uint32_t width = 0, height = 0;
-    renderer.getWindow().getWindowSize(width, height);
+    uint32_t width = m_ssao_attachment.m_extent.width;
+    uint32_t height = m_ssao_attachment.m_extent.height;
 
     VkRenderPassBeginInfo render_pass_info{};
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     render_pass_info.renderPass = m_render_pass;
-    render_pass_info.framebuffer = m_fbos[renderer.getWindow().getCurrentImageId()];
+    render_pass_info.framebuffer = m_fbos[i_frame.m_image_id];
     render_pass_info.renderArea.offset = { 0, 0 };
     render_pass_info.renderArea.extent = { width, height };
 
@@ -163,8 +156,10 @@ VkCommandBuffer AmbientOcclusionVK::draw(const Frame& i_frame)
     vkCmdBeginRenderPass(current_cmd, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
 
     vkCmdBindPipeline(current_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_composition_pipeline);
-    vkCmdBindDescriptorSets(current_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layouts, 0, 1, &m_descriptor_sets[renderer.getWindow().getCurrentImageId()].m_textures_descriptor, 0, NULL);
+    UtilsVK::setViewport(current_cmd, width, height);
+    vkCmdBindDescriptorSets(current_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layouts, 0, 1, &m_descriptor_sets[i_frame.m_frame_id].m_textures_descriptor, 1, &i_frame.m_per_frame_offset);
 
+    m_runtime.m_geometry_pool->bind(current_cmd, VertexLayout::Full, VertexStreams::All);
     m_plane->draw(current_cmd, 0);
 
     vkCmdEndRenderPass(current_cmd);
@@ -179,13 +174,27 @@ VkCommandBuffer AmbientOcclusionVK::draw(const Frame& i_frame)
 }
 
 
+void AmbientOcclusionVK::resize()
+{
+    RendererVK& renderer = *m_runtime.m_renderer;
+
+    for (auto fbo : m_fbos)
+    {
+        vkDestroyFramebuffer(renderer.getDevice()->getLogicalDevice(), fbo, nullptr);
+    }
+
+    createFbo();
+    updateDescriptors();
+}
+
+
 
 void AmbientOcclusionVK::createFbo()
 {
     RendererVK& renderer = *m_runtime.m_renderer;
 
-    uint32_t width = 0, height = 0;
-    renderer.getWindow().getWindowSize(width, height);
+    uint32_t width = m_ssao_attachment.m_extent.width;
+    uint32_t height = m_ssao_attachment.m_extent.height;
 
     for (size_t i = 0; i < m_fbos.size(); i++)
     {
@@ -244,11 +253,13 @@ void AmbientOcclusionVK::createRenderPass()
     // Subpass dependencies for layout transitions
     std::array<VkSubpassDependency, 1> dependencies = { {} };
 
+    // the attachment is shared by the frames in flight, wait for the reads of the previous frame before clearing it
     dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
     dependencies[0].dstSubpass = 0;
-    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[0].srcAccessMask = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
     VkRenderPassCreateInfo render_pass_info = {};
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -268,35 +279,16 @@ void AmbientOcclusionVK::createRenderPass()
 
 void AmbientOcclusionVK::createPipelines()
 {
-    RendererVK& renderer = *m_runtime.m_renderer;
-
-    VkVertexInputBindingDescription binding_vertex_descrition{};
-    binding_vertex_descrition.binding = 0;
-    binding_vertex_descrition.stride = sizeof(Vertex);
-    binding_vertex_descrition.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions{};
-
-    attribute_descriptions[0].binding = 0;
-    attribute_descriptions[0].location = 0;
-    attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attribute_descriptions[0].offset = offsetof(Vertex, m_position);
-
-    attribute_descriptions[1].binding = 0;
-    attribute_descriptions[1].location = 1;
-    attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attribute_descriptions[1].offset = offsetof(Vertex, m_normal);
-
-    attribute_descriptions[2].binding = 0;
-    attribute_descriptions[2].location = 2;
-    attribute_descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    attribute_descriptions[2].offset = offsetof(Vertex, m_uv);
+    //the quad is a mesh like any other, full vertices in two streams
+    std::vector<VkVertexInputBindingDescription> binding_vertex_descritions;
+    std::vector<VkVertexInputAttributeDescription> attribute_descriptions;
+    MeshVK::getVertexInput(VertexLayout::Full, VertexStreams::All, binding_vertex_descritions, attribute_descriptions);
 
     VkPipelineVertexInputStateCreateInfo vertex_input_info{};
     vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input_info.vertexBindingDescriptionCount = 1;
+    vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(binding_vertex_descritions.size());
     vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
-    vertex_input_info.pVertexBindingDescriptions = &binding_vertex_descrition;
+    vertex_input_info.pVertexBindingDescriptions = binding_vertex_descritions.data();
     vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data();
     vertex_input_info.flags = 0;
 
@@ -356,30 +348,22 @@ void AmbientOcclusionVK::createPipelines()
     multisampling.flags = 0;
 
 
-    uint32 width = 0, height = 0;
-    renderer.getWindow().getWindowSize(width, height);
-    VkExtent2D extend{ width, height };
-
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)width;
-    viewport.height = (float)height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor{};
-    scissor.offset = { 0, 0 };
-    scissor.extent = extend;
-
+    //viewport and scissor are set when recording, the pipeline does not depend on the size of the window
     VkPipelineViewportStateCreateInfo viewport_state{};
     viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewport_state.viewportCount = 1;
-    viewport_state.pViewports = &viewport;
+    viewport_state.pViewports = nullptr;
     viewport_state.scissorCount = 1;
-    viewport_state.pScissors = &scissor;
+    viewport_state.pScissors = nullptr;
     viewport_state.flags = 0;
 
+    std::array<VkDynamicState, 2> dynamic_states = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    VkPipelineDynamicStateCreateInfo dynamic_state{};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size());
+    dynamic_state.pDynamicStates = dynamic_states.data();
+
     VkPipelineDepthStencilStateCreateInfo depth_stencil{};
     depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
     depth_stencil.depthTestEnable = VK_FALSE;
@@ -389,13 +373,23 @@ void AmbientOcclusionVK::createPipelines()
     depth_stencil.stencilTestEnable = VK_FALSE;
     depth_stencil.flags = 0;
 
-    std::vector<VkGraphicsPipelineCreateInfo> graphic_pipelines;
+    //numero de muestras del kernel, constant_id = 0 in ambient_occlusion.frag
+    VkSpecializationMapEntry kernel_size_entry{};
+    kernel_size_entry.constantID = 0;
+    kernel_size_entry.offset = 0;
+    kernel_size_entry.size = sizeof(uint32_t);
 
+    VkSpecializationInfo specialization_info{};
+    specialization_info.mapEntryCount = 1;
+    specialization_info.pMapEntries = &kernel_size_entry;
+    specialization_info.dataSize = sizeof(uint32_t);
+    specialization_info.pData = &m_kernel_size;
+
+    std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages = m_shader_stages;
+    shader_stages[1].pSpecializationInfo = &specialization_info;
 
-    if (vkCreatePipelineLayout(renderer.getDevice()->getLogicalDevice(), &pipeline_layout_info, nullptr, &m_pipeline_layouts) != VK_SUCCESS)
-    {
-        throw MiniEngineException("failed to create pipeline layout!");
-    }
+
+    m_pipeline_layouts = m_runtime.m_pipeline_registry->getPipelineLayout(pipeline_layout_info);
 
     VkGraphicsPipelineCreateInfo pipeline_info{};
     pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -409,20 +403,14 @@ void AmbientOcclusionVK::createPipelines()
     pipeline_info.pMultisampleState = &multisampling;
     pipeline_info.pViewportState = &viewport_state;
     pipeline_info.pDepthStencilState = &depth_stencil;
-    pipeline_info.pDynamicState = VK_NULL_HANDLE;
-    pipeline_info.stageCount = m_shader_stages.size();
-    pipeline_info.pStages = m_shader_stages.data();
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.stageCount = shader_stages.size();
+    pipeline_info.pStages = shader_stages.data();
     pipeline_info.flags = 0;
     pipeline_info.pVertexInputState = &vertex_input_info;
     pipeline_info.subpass = 0;
 
-    graphic_pipelines.push_back(pipeline_info);
-
-
-    if (vkCreateGraphicsPipelines(renderer.getDevice()->getLogicalDevice(), VK_NULL_HANDLE, 1, graphic_pipelines.data(), nullptr, &m_composition_pipeline))
-    {
-        throw MiniEngineException("Error creating the pipeline");
-    }
+    m_composition_pipeline = m_runtime.m_pipeline_registry->getGraphicsPipeline(pipeline_info);
 
 
     createDescriptors();
@@ -438,7 +426,7 @@ void AmbientOcclusionVK::createDescriptorLayout()
     layout_bindings[0] = {};
     layout_bindings[0].binding = 0;
     layout_bindings[0].descriptorCount = 1;
-    layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     layout_bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
     //textura de posicion + profundidad
@@ -477,10 +465,7 @@ void AmbientOcclusionVK::createDescriptorLayout()
     set_attachment_color_info.flags = 0;
     set_attachment_color_info.pBindings = layout_bindings.data();
 
-    if (VK_SUCCESS != vkCreateDescriptorSetLayout(m_runtime.m_renderer->getDevice()->getLogicalDevice(), &set_attachment_color_info, nullptr, &m_descriptor_set_layout))
-    {
-        throw MiniEngineException("Error creating descriptor set");
-    }
+    m_descriptor_set_layout = m_runtime.m_pipeline_registry->getDescriptorSetLayout(set_attachment_color_info);
 }
 
 
@@ -489,7 +474,8 @@ void AmbientOcclusionVK::createDescriptors()
     //create a descriptor pool that will hold 10 uniform buffers
     std::vector<VkDescriptorPoolSize> sizes =
     {
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER        , 10 },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC , 10 },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10 },
         { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10 }
     };
 
@@ -506,7 +492,7 @@ void AmbientOcclusionVK::createDescriptors()
     }
 
     //create descriptors for the global buffers
-    for (uint32_t i = 0; i < m_runtime.m_renderer->getWindow().getImageCount(); i++)
+    for (uint32_t i = 0; i < kMAX_NUMBER_OF_FRAMES; i++)
     {
         //globals per frame
         VkDescriptorSetAllocateInfo alloc_per_frame_info = {};
@@ -517,15 +503,25 @@ void AmbientOcclusionVK::createDescriptors()
         alloc_per_frame_info.pSetLayouts = &m_descriptor_set_layout;
 
         vkAllocateDescriptorSets(m_runtime.m_renderer->getDevice()->getLogicalDevice(), &alloc_per_frame_info, &m_descriptor_sets[i].m_textures_descriptor);
+    }
+
+    updateDescriptors();
+}
 
+
+void AmbientOcclusionVK::updateDescriptors()
+{
+    //the attachments are recreated on resize, the sets are only written again
+    for (uint32_t i = 0; i < kMAX_NUMBER_OF_FRAMES; i++)
+    {
         //information about the buffer we want to point at in the descriptor
         VkDescriptorBufferInfo binfo;
-        binfo.buffer = m_runtime.getPerFrameBuffer()[i];
+        binfo.buffer = m_runtime.getUploadBuffer()[i];
         binfo.offset = 0;
         binfo.range = sizeof(PerFrameData);
 
         VkDescriptorBufferInfo bkernel;
-        bkernel.buffer = m_runtime.getKernelBuffer()[i];
+        bkernel.buffer = m_kernel_buffer;
         bkernel.offset = 0;
         bkernel.range = sizeof(KernelSSAO);
 
@@ -551,7 +547,7 @@ void AmbientOcclusionVK::createDescriptors()
         set_write[0].dstBinding = 0;
         set_write[0].dstSet = m_descriptor_sets[i].m_textures_descriptor;
         set_write[0].descriptorCount = 1;
-        set_write[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        set_write[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         set_write[0].pImageInfo = nullptr;
         set_write[0].pBufferInfo = &binfo;
 
@@ -598,4 +594,74 @@ void AmbientOcclusionVK::createDescriptors()
 
         vkUpdateDescriptorSets(m_runtime.m_renderer->getDevice()->getLogicalDevice(), set_write.size(), set_write.data(), 0, nullptr);
     }
-}
\ No newline at end of file
+}
+
+
+void AmbientOcclusionVK::createKernel()
+{
+    const DeviceVK& device = *m_runtime.m_renderer->getDevice();
+
+    // ssao buffer, unused samples stay at zero
+    KernelSSAO kernel_ssao{};
+    std::uniform_real_distribution<float> randomFloats(0.0, 1.0); // random floats between [0.0, 1.0]
+    std::default_random_engine generator;
+
+    auto random_direction = [&]()
+    {
+        glm::vec3 sample(
+            randomFloats(generator) * 2.0 - 1.0,
+            randomFloats(generator) * 2.0 - 1.0,
+            randomFloats(generator)
+        );
+        return glm::normalize(sample + glm::vec3(0.0f, 0.0f, kEPSILON));
+    };
+
+    for (uint32_t i = 0; i < m_kernel_size; ++i)
+    {
+        // mas muestras cerca del fragmento
+        float scale = (float)i / (float)m_kernel_size;
+        scale = glm::mix(0.1f, 1.0f, scale * scale);
+
+        glm::vec3 sample;
+
+        if (m_kernel_distribution == KernelDistribution::Poisson)
+        {
+            // best candidate: keep the direction farthest from the ones already accepted
+            constexpr uint32_t kCandidates = 32;
+
+            float best_distance = -1.0f;
+
+            for (uint32_t c = 0; c < kCandidates; ++c)
+            {
+                const glm::vec3 candidate = random_direction();
+
+                float closest = std::numeric_limits<float>::max();
+                for (uint32_t j = 0; j < i; ++j)
+                {
+                    const glm::vec3 accepted = glm::normalize(glm::vec3(kernel_ssao.m_kernelSSAO[j]));
+                    closest = std::min(closest, glm::distance(candidate, accepted));
+                }
+
+                if (closest > best_distance)
+                {
+                    best_distance = closest;
+                    sample = candidate;
+                }
+            }
+
+            sample *= scale;
+        }
+        else
+        {
+            sample = random_direction() * randomFloats(generator) * scale;
+        }
+
+        kernel_ssao.m_kernelSSAO[i] = glm::vec4(sample.x, sample.y, sample.z, 1.0f);
+    }
+
+    // staging + copy to device local, the kernel is never written again
+    UtilsVK::createBuffer(device, sizeof(KernelSSAO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_kernel_buffer, m_kernel_memory);
+    UtilsVK::uploadBuffer(device, &kernel_ssao, sizeof(KernelSSAO), m_kernel_buffer);
+
+    UtilsVK::setObjectName(device.getLogicalDevice(), (uint64_t)m_kernel_buffer, VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, "SSAO Kernel Buffer");
+}
@@ -0,0 +1,192 @@
+#include "vulkan/commandRecorderVK.h"
+#include "vulkan/deviceVK.h"
+
+using namespace MiniEngine;
+
+
+CommandRecorderVK::CommandRecorderVK( const DeviceVK& i_device ) :
+    m_device          ( i_device ),
+    m_record_once     ( false    ),
+    m_cache_generation( 1        )
+{
+    m_slot_generation.fill( 0 );
+}
+
+
+CommandRecorderVK::~CommandRecorderVK()
+{
+}
+
+
+void CommandRecorderVK::initialize( const uint32_t i_worker_count )
+{
+    assert( m_pools.empty() );
+
+    m_pools.resize( i_worker_count + 1 );
+
+    for( auto& thread_pools : m_pools )
+    {
+        for( auto& pool : thread_pools )
+        {
+            VkCommandPoolCreateInfo pool_info{};
+            pool_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            pool_info.queueFamilyIndex = m_device.getGraphicsQueueIndex();
+            pool_info.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+            if( vkCreateCommandPool( m_device.getLogicalDevice(), &pool_info, nullptr, &pool.m_pool ) != VK_SUCCESS )
+            {
+                throw MiniEngineException( "Error creating the recording command pools" );
+            }
+        }
+    }
+
+    m_workers.initialize( i_worker_count );
+}
+
+
+void CommandRecorderVK::shutdown()
+{
+    m_workers.shutdown();
+
+    //destroying the pool frees its command buffers
+    for( auto& thread_pools : m_pools )
+    {
+        for( auto& pool : thread_pools )
+        {
+            vkDestroyCommandPool( m_device.getLogicalDevice(), pool.m_pool, nullptr );
+        }
+    }
+    m_pools.clear();
+}
+
+
+void CommandRecorderVK::beginFrame( const uint32_t i_frame_id )
+{
+    assert( i_frame_id < kMAX_NUMBER_OF_FRAMES );
+
+    //the cached command buffers of this slot live in its pools until the cache is invalidated
+    if( m_record_once && m_slot_generation[ i_frame_id ] == m_cache_generation )
+    {
+        return;
+    }
+
+    for( auto& thread_pools : m_pools )
+    {
+        ThreadPool& pool = thread_pools[ i_frame_id ];
+
+        vkResetCommandPool( m_device.getLogicalDevice(), pool.m_pool, 0 );
+        pool.m_used = {};
+    }
+
+    m_slot_generation[ i_frame_id ] = m_cache_generation;
+}
+
+
+void CommandRecorderVK::setRecordOnce( const bool i_record_once )
+{
+    m_record_once = i_record_once;
+    invalidateCache();
+}
+
+
+void CommandRecorderVK::invalidateCache()
+{
+    //the pools are reset lazily in beginFrame, after the timeline value of each slot has been waited
+    m_cache_generation++;
+}
+
+
+VkCommandBuffer CommandRecorderVK::allocate( const uint32_t i_frame_id, const VkCommandBufferLevel i_level )
+{
+    //0 for the main thread, the workers of the recorder after it
+    const uint32_t thread_index = WorkerPool::getThreadIndex();
+    assert( thread_index < m_pools.size() );
+
+    ThreadPool&    pool  = m_pools[ thread_index ][ i_frame_id ];
+    const uint32_t level = i_level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1;
+
+    if( pool.m_used[ level ] == pool.m_buffers[ level ].size() )
+    {
+        VkCommandBufferAllocateInfo alloc_info{};
+        alloc_info.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool        = pool.m_pool;
+        alloc_info.level              = i_level;
+        alloc_info.commandBufferCount = 1;
+
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        if( vkAllocateCommandBuffers( m_device.getLogicalDevice(), &alloc_info, &command_buffer ) != VK_SUCCESS )
+        {
+            throw MiniEngineException( "Error allocating recording command buffer" );
+        }
+
+        pool.m_buffers[ level ].push_back( command_buffer );
+    }
+
+    return pool.m_buffers[ level ][ pool.m_used[ level ]++ ];
+}
+
+
+std::vector<VkCommandBuffer> CommandRecorderVK::recordSecondaries(
+    const uint32_t                                                              i_frame_id,
+    const VkCommandBufferInheritanceInfo&                                       i_inheritance,
+    const std::vector<uint32_t>&                                                i_bucket_sizes,
+    const uint32_t                                                              i_min_chunk,
+    const std::function<void( VkCommandBuffer, uint32_t, uint32_t, uint32_t )>& i_record )
+{
+    struct Chunk
+    {
+        uint32_t m_bucket;
+        uint32_t m_begin;
+        uint32_t m_end;
+    };
+
+    uint32_t total = 0;
+    for( auto size : i_bucket_sizes )
+    {
+        total += size;
+    }
+
+    //one chunk per thread at most, but never smaller than i_min_chunk
+    const uint32_t chunk_size = std::max( std::max( i_min_chunk, 1u ), ( total + getThreadCount() - 1 ) / getThreadCount() );
+
+    std::vector<Chunk> chunks;
+    for( uint32_t bucket = 0; bucket < static_cast<uint32_t>( i_bucket_sizes.size() ); bucket++ )
+    {
+        for( uint32_t begin = 0; begin < i_bucket_sizes[ bucket ]; begin += chunk_size )
+        {
+            chunks.push_back( { bucket, begin, std::min( i_bucket_sizes[ bucket ], begin + chunk_size ) } );
+        }
+    }
+
+    std::vector<VkCommandBuffer> secondaries( chunks.size(), VK_NULL_HANDLE );
+
+    parallelFor( static_cast<uint32_t>( chunks.size() ), 1, [ & ]( const uint32_t i_begin, const uint32_t i_end )
+    {
+        for( uint32_t id = i_begin; id < i_end; id++ )
+        {
+            VkCommandBuffer command_buffer = allocate( i_frame_id, VK_COMMAND_BUFFER_LEVEL_SECONDARY );
+
+            VkCommandBufferBeginInfo begin_info{};
+            begin_info.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            begin_info.flags            = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | ( m_record_once ? 0 : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT );
+            begin_info.pInheritanceInfo = &i_inheritance;
+
+            if( vkBeginCommandBuffer( command_buffer, &begin_info ) != VK_SUCCESS )
+            {
+                throw MiniEngineException( "failed to begin recording secondary command buffer!" );
+            }
+
+            i_record( command_buffer, chunks[ id ].m_bucket, chunks[ id ].m_begin, chunks[ id ].m_end );
+
+            if( vkEndCommandBuffer( command_buffer ) != VK_SUCCESS )
+            {
+                throw MiniEngineException( "failed to record secondary command buffer!" );
+            }
+
+            secondaries[ id ] = command_buffer;
+        }
+    } );
+
+    return secondaries;
+}
+
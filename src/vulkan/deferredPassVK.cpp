@@ -1,5 +1,6 @@
 #include "common.h"
 #include "vulkan/utilsVK.h"
+#include "vulkan/commandRecorderVK.h"
 #include "vulkan/deferredPassVK.h"
 #include "vulkan/rendererVK.h"
 #include "vulkan/deviceVK.h"
@@ -7,8 +8,11 @@
 #include "runtime.h"
 #include "frame.h"
 #include "shaderRegistry.h"
+#include "pipelineRegistry.h"
 #include "entity.h"
 #include "vulkan/meshVK.h"
+#include "vulkan/geometryPoolVK.h"
+#include "vulkan/indirectDrawsVK.h"
 #include "material.h"
 
 
@@ -29,10 +33,6 @@ DeferredPassVK::DeferredPassVK(
     m_position_attachment(i_position_attachment),
     m_material_attachment(i_material_attachment)
 {
-    for (auto cmd : m_command_buffer)
-    {
-        cmd = VK_NULL_HANDLE;
-    }
 }
 
 
@@ -43,8 +43,6 @@ DeferredPassVK::~DeferredPassVK()
 
 bool DeferredPassVK::initialize()
 {
-    RendererVK& renderer = *m_runtime.m_renderer;
-
     m_entities_to_draw = {
                             { static_cast<uint32_t>(Material::TMaterial::Diffuse), {} },
                             { static_cast<uint32_t>(Material::TMaterial::Microfacets), {} }
@@ -52,7 +50,7 @@ bool DeferredPassVK::initialize()
 
     //SHADER STAGES
     {
-        VkShaderModule vert_module = m_runtime.m_shader_registry->loadShader("./shaders/vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+        VkShaderModule vert_module = m_runtime.m_shader_registry->loadShader(MeshVK::getVertexShader(kSCENE_VERTEX_LAYOUT), VK_SHADER_STAGE_VERTEX_BIT);
         VkShaderModule diffuse_module = m_runtime.m_shader_registry->loadShader("./shaders/diffuse.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
         VkShaderModule microfacets_module = m_runtime.m_shader_registry->loadShader("./shaders/microfacets.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
         
@@ -99,14 +97,11 @@ bool DeferredPassVK::initialize()
     createPipelines();
     createFbo();
 
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
-
-    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.commandPool = renderer.getDevice()->getCommandPool();
-    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandBufferAllocateInfo.commandBufferCount = 3;
-
-    vkAllocateCommandBuffers(renderer.getDevice()->getLogicalDevice(), &commandBufferAllocateInfo, m_command_buffer.data());
+    if (IndirectDrawsVK::isSupported(*m_runtime.m_renderer->getDevice()))
+    {
+        m_indirect_draws = std::make_unique<IndirectDrawsVK>(*m_runtime.m_renderer->getDevice(), *m_runtime.m_geometry_pool);
+        m_indirect_draws->initialize();
+    }
 
     return true;
 }
@@ -116,16 +111,20 @@ void DeferredPassVK::shutdown()
 {
     RendererVK& renderer = *m_runtime.m_renderer;
 
-    vkFreeCommandBuffers(renderer.getDevice()->getLogicalDevice(), renderer.getDevice()->getCommandPool(), m_command_buffer.size(), m_command_buffer.data());
+    if (m_indirect_draws)
+    {
+        m_indirect_draws->shutdown();
+        m_indirect_draws = nullptr;
+    }
 
     vkDestroyDescriptorPool(renderer.getDevice()->getLogicalDevice(), m_descriptor_pool, nullptr);
 
     for (auto& pipeline : m_pipelines)
     {
-        vkDestroyDescriptorSetLayout(renderer.getDevice()->getLogicalDevice(), pipeline.m_descriptor_set_layout[0], nullptr);
-        vkDestroyDescriptorSetLayout(renderer.getDevice()->getLogicalDevice(), pipeline.m_descriptor_set_layout[1], nullptr);
-        vkDestroyPipeline(renderer.getDevice()->getLogicalDevice(), pipeline.m_pipeline, nullptr);
-        vkDestroyPipelineLayout(renderer.getDevice()->getLogicalDevice(), pipeline.m_pipeline_layouts, nullptr);
+        m_runtime.m_pipeline_registry->releaseDescriptorSetLayout(pipeline.m_descriptor_set_layout[0]);
+        m_runtime.m_pipeline_registry->releaseDescriptorSetLayout(pipeline.m_descriptor_set_layout[1]);
+        m_runtime.m_pipeline_registry->releasePipeline(pipeline.m_pipeline);
+        m_runtime.m_pipeline_registry->releasePipelineLayout(pipeline.m_pipeline_layouts);
     }
 
 
@@ -142,26 +141,18 @@ void DeferredPassVK::shutdown()
 
 VkCommandBuffer DeferredPassVK::draw(const Frame& i_frame)
 {
-    RendererVK& renderer = *m_runtime.m_renderer;
-
-    VkCommandBuffer& current_cmd = m_command_buffer[renderer.getWindow().getCurrentImageId()];
-
-    if (current_cmd != VK_NULL_HANDLE)
-    {
-        VkCommandBufferResetFlags flags{};
-        vkResetCommandBuffer(current_cmd, flags);
-    }
+    VkCommandBuffer current_cmd = m_runtime.m_command_recorder->allocate(i_frame.m_frame_id, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
     VkCommandBufferBeginInfo begin_info{};
     begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-    uint32_t width = 0, height = 0;
-    renderer.getWindow().getWindowSize(width, height);
+    uint32_t width = m_color_attachment.m_extent.width;
+    uint32_t height = m_color_attachment.m_extent.height;
 
     VkRenderPassBeginInfo render_pass_info{};
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     render_pass_info.renderPass = m_render_pass;
-    render_pass_info.framebuffer = m_fbos[renderer.getWindow().getCurrentImageId()];
+    render_pass_info.framebuffer = m_fbos[i_frame.m_image_id];
     render_pass_info.renderArea.offset = { 0, 0 };
     render_pass_info.renderArea.extent = { width, height };
 
@@ -180,21 +171,60 @@ VkCommandBuffer DeferredPassVK::draw(const Frame& i_frame)
     }
 
     UtilsVK::beginRegion(current_cmd, "GBuffer Pass", Vector4f(0.0f, 0.5f, 0.0f, 1.0f));
-    vkCmdBeginRenderPass(current_cmd, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(current_cmd, &render_pass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    //the entity lists are split in secondary command buffers recorded in parallel by the workers
+    VkCommandBufferInheritanceInfo inheritance_info{};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.renderPass = m_render_pass;
+    inheritance_info.subpass = 0;
+    inheritance_info.framebuffer = m_fbos[i_frame.m_image_id];
+
+    //lookups done here, the workers must not touch the map
+    std::vector<const std::vector<EntityPtr>*> entities(m_pipelines.size(), nullptr);
+    std::vector<uint32_t> bucket_sizes(m_pipelines.size(), 0);
 
     for (uint32_t mat_id = static_cast<uint32_t>(Material::TMaterial::Diffuse); mat_id < static_cast<uint32_t>(m_pipelines.size()); mat_id++)
     {
-        UtilsVK::beginRegion(current_cmd, mat_id == 0 ? "Diffuse GBuffer Pass" : mat_id == 1 ? "Dielectric GBuffer Pass" : "Microfacets GBuffer Pass", Vector4f(0.0f, 0.5f, 0.5f, 1.0f));
+        auto it = m_entities_to_draw.find(mat_id);
+        if (it != m_entities_to_draw.end())
+        {
+            entities[mat_id] = &it->second;
+            bucket_sizes[mat_id] = static_cast<uint32_t>(it->second.size());
+        }
+    }
 
-        vkCmdBindPipeline(current_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines[mat_id].m_pipeline);
-        vkCmdBindDescriptorSets(current_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines[mat_id].m_pipeline_layouts, 0, 2, &m_pipelines[mat_id].m_descriptor_sets[renderer.getWindow().getCurrentImageId()].m_per_frame_descriptor, 0, nullptr);
+    //the indirect draws of a bucket are a single call, one secondary per bucket is enough
+    const uint32_t min_chunk = m_indirect_draws ? std::numeric_limits<uint32_t>::max() : kMIN_DRAWS_PER_SECONDARY;
+
+    std::vector<VkCommandBuffer> secondaries = m_runtime.m_command_recorder->recordSecondaries(i_frame.m_frame_id, inheritance_info, bucket_sizes, min_chunk,
+        [&](VkCommandBuffer i_cmd, const uint32_t mat_id, const uint32_t i_begin, const uint32_t i_end)
+    {
+        UtilsVK::beginRegion(i_cmd, mat_id == 0 ? "Diffuse GBuffer Pass" : mat_id == 1 ? "Dielectric GBuffer Pass" : "Microfacets GBuffer Pass", Vector4f(0.0f, 0.5f, 0.5f, 1.0f));
 
-        for (auto entity : m_entities_to_draw[mat_id])
+        vkCmdBindPipeline(i_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines[mat_id].m_pipeline);
+        UtilsVK::setViewport(i_cmd, width, height);
+        vkCmdBindDescriptorSets(i_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines[mat_id].m_pipeline_layouts, 0, 2, &m_pipelines[mat_id].m_descriptor_sets[i_frame.m_frame_id].m_per_frame_descriptor, 1, &i_frame.m_per_frame_offset);
+        m_runtime.m_geometry_pool->bind(i_cmd, kSCENE_VERTEX_LAYOUT, VertexStreams::All);
+
+        if (m_indirect_draws)
+        {
+            m_indirect_draws->draw(i_cmd, i_frame.m_frame_id, mat_id);
+        }
+        else
         {
-            entity->draw(current_cmd, i_frame);
+            for (uint32_t id = i_begin; id < i_end; id++)
+            {
+                (*entities[mat_id])[id]->draw(i_cmd, i_frame);
+            }
         }
 
-        UtilsVK::endRegion(current_cmd);
+        UtilsVK::endRegion(i_cmd);
+    });
+
+    if (!secondaries.empty())
+    {
+        vkCmdExecuteCommands(current_cmd, static_cast<uint32_t>(secondaries.size()), secondaries.data());
     }
 
     vkCmdEndRenderPass(current_cmd);
@@ -209,19 +239,42 @@ VkCommandBuffer DeferredPassVK::draw(const Frame& i_frame)
 }
 
 
+void DeferredPassVK::resize()
+{
+    RendererVK& renderer = *m_runtime.m_renderer;
+
+    for (auto fbo : m_fbos)
+    {
+        vkDestroyFramebuffer(renderer.getDevice()->getLogicalDevice(), fbo, nullptr);
+    }
+
+    createFbo();
+}
+
+
 void DeferredPassVK::addEntityToDraw(const EntityPtr i_entity)
 {
     m_entities_to_draw[static_cast<uint32_t>(i_entity->getMaterial().getType())].push_back(i_entity);
 }
 
 
+void DeferredPassVK::update(const Frame& i_frame)
+{
+    //the levels of detail can change every frame, the recorded indirect draws read them from here
+    if (m_indirect_draws)
+    {
+        m_indirect_draws->update(i_frame.m_frame_id, m_entities_to_draw, static_cast<uint32_t>(m_pipelines.size()), LodTarget::Camera);
+    }
+}
+
+
 
 void DeferredPassVK::createFbo()
 {
     RendererVK& renderer = *m_runtime.m_renderer;
 
-    uint32_t width = 0, height = 0;
-    renderer.getWindow().getWindowSize(width, height);
+    uint32_t width = m_color_attachment.m_extent.width;
+    uint32_t height = m_color_attachment.m_extent.height;
 
     for (size_t i = 0; i < m_fbos.size(); i++)
     {
@@ -379,35 +432,16 @@ void DeferredPassVK::createRenderPass()
 
 void DeferredPassVK::createPipelines()
 {
-    RendererVK& renderer = *m_runtime.m_renderer;
-
-    VkVertexInputBindingDescription binding_vertex_descrition{};
-    binding_vertex_descrition.binding = 0;
-    binding_vertex_descrition.stride = sizeof(Vertex);
-    binding_vertex_descrition.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions{};
-
-    attribute_descriptions[0].binding = 0;
-    attribute_descriptions[0].location = 0;
-    attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attribute_descriptions[0].offset = offsetof(Vertex, m_position);
-
-    attribute_descriptions[1].binding = 0;
-    attribute_descriptions[1].location = 1;
-    attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attribute_descriptions[1].offset = offsetof(Vertex, m_normal);
-
-    attribute_descriptions[2].binding = 0;
-    attribute_descriptions[2].location = 2;
-    attribute_descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    attribute_descriptions[2].offset = offsetof(Vertex, m_uv);
+    //the layout of the scene meshes picks the formats
+    std::vector<VkVertexInputBindingDescription> binding_vertex_descritions;
+    std::vector<VkVertexInputAttributeDescription> attribute_descriptions;
+    MeshVK::getVertexInput(kSCENE_VERTEX_LAYOUT, VertexStreams::All, binding_vertex_descritions, attribute_descriptions);
 
     VkPipelineVertexInputStateCreateInfo vertex_input_info{};
     vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input_info.vertexBindingDescriptionCount = 1;
+    vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(binding_vertex_descritions.size());
     vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
-    vertex_input_info.pVertexBindingDescriptions = &binding_vertex_descrition;
+    vertex_input_info.pVertexBindingDescriptions = binding_vertex_descritions.data();
     vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data();
     vertex_input_info.flags = 0;
 
@@ -473,33 +507,28 @@ void DeferredPassVK::createPipelines()
     multisampling.flags = 0;
 
 
-    uint32 width = 0, height = 0;
-    renderer.getWindow().getWindowSize(width, height);
-    VkExtent2D extend{ width, height };
-
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)width;
-    viewport.height = (float)height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor{};
-    scissor.offset = { 0, 0 };
-    scissor.extent = extend;
-
+    //viewport and scissor are set when recording, the pipeline does not depend on the size of the window
     VkPipelineViewportStateCreateInfo viewport_state{};
     viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewport_state.viewportCount = 1;
-    viewport_state.pViewports = &viewport;
+    viewport_state.pViewports = nullptr;
     viewport_state.scissorCount = 1;
-    viewport_state.pScissors = &scissor;
+    viewport_state.pScissors = nullptr;
     viewport_state.flags = 0;
 
+    std::array<VkDynamicState, 2> dynamic_states = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    VkPipelineDynamicStateCreateInfo dynamic_state{};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size());
+    dynamic_state.pDynamicStates = dynamic_states.data();
+
     //create unfiorms 
     createDescriptorLayout();
 
+    //all the pipelines of the pass in one batch, the registry compiles the missing ones in parallel
+    std::vector<VkGraphicsPipelineCreateInfo> graphic_pipelines;
+
     for (auto& pipeline : m_pipelines)
     {
 
@@ -511,13 +540,7 @@ void DeferredPassVK::createPipelines()
         pipeline_layout_info.pushConstantRangeCount = 0;
         pipeline_layout_info.flags = 0;
 
-        std::vector<VkGraphicsPipelineCreateInfo> graphic_pipelines;
-
-
-        if (vkCreatePipelineLayout(renderer.getDevice()->getLogicalDevice(), &pipeline_layout_info, nullptr, &pipeline.m_pipeline_layouts) != VK_SUCCESS)
-        {
-            throw MiniEngineException("failed to create pipeline layout!");
-        }
+        pipeline.m_pipeline_layouts = m_runtime.m_pipeline_registry->getPipelineLayout(pipeline_layout_info);
 
         VkGraphicsPipelineCreateInfo pipeline_info{};
         pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -531,7 +554,7 @@ void DeferredPassVK::createPipelines()
         pipeline_info.pMultisampleState = &multisampling;
         pipeline_info.pViewportState = &viewport_state;
         pipeline_info.pDepthStencilState = &depth_stencil;
-        pipeline_info.pDynamicState = VK_NULL_HANDLE;
+        pipeline_info.pDynamicState = &dynamic_state;
         pipeline_info.stageCount = pipeline.m_shader_stages.size();
         pipeline_info.pStages = pipeline.m_shader_stages.data();
         pipeline_info.flags = 0;
@@ -539,12 +562,14 @@ void DeferredPassVK::createPipelines()
         pipeline_info.subpass = 0;
 
         graphic_pipelines.push_back(pipeline_info);
+    }
 
+    std::vector<VkPipeline> created_pipelines;
+    m_runtime.m_pipeline_registry->getGraphicsPipelines(graphic_pipelines, created_pipelines);
 
-        if (vkCreateGraphicsPipelines(renderer.getDevice()->getLogicalDevice(), VK_NULL_HANDLE, 1, graphic_pipelines.data(), nullptr, &pipeline.m_pipeline))
-        {
-            throw MiniEngineException("Error creating the pipeline");
-        }
+    for (uint32_t id = 0; id < m_pipelines.size(); id++)
+    {
+        m_pipelines[id].m_pipeline = created_pipelines[id];
     }
     createDescriptors();
 }
@@ -556,7 +581,7 @@ void DeferredPassVK::createDescriptorLayout()
     VkDescriptorSetLayoutBinding per_frame_binding = {};
     per_frame_binding.binding = 0;
     per_frame_binding.descriptorCount = 1;
-    per_frame_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    per_frame_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     per_frame_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
     VkDescriptorSetLayoutCreateInfo set_per_frame_info = {};
@@ -582,15 +607,9 @@ void DeferredPassVK::createDescriptorLayout()
 
     for (auto& pipeline : m_pipelines)
     {
-        if (VK_SUCCESS != vkCreateDescriptorSetLayout(m_runtime.m_renderer->getDevice()->getLogicalDevice(), &set_per_frame_info, nullptr, &pipeline.m_descriptor_set_layout[0]))
-        {
-            throw MiniEngineException("Error creating descriptor set");
-        }
+        pipeline.m_descriptor_set_layout[0] = m_runtime.m_pipeline_registry->getDescriptorSetLayout(set_per_frame_info);
 
-        if (VK_SUCCESS != vkCreateDescriptorSetLayout(m_runtime.m_renderer->getDevice()->getLogicalDevice(), &set_per_object_info, nullptr, &pipeline.m_descriptor_set_layout[1]))
-        {
-            throw MiniEngineException("Error creating descriptor set");
-        }
+        pipeline.m_descriptor_set_layout[1] = m_runtime.m_pipeline_registry->getDescriptorSetLayout(set_per_object_info);
     }
 }
 
@@ -600,7 +619,7 @@ void DeferredPassVK::createDescriptors()
     //create a descriptor pool that will hold 10 uniform buffers
     std::vector<VkDescriptorPoolSize> sizes =
     {
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 30 },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 30 },
         { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 30 }
     };
 
@@ -619,7 +638,7 @@ void DeferredPassVK::createDescriptors()
     //create descriptors for the global buffers
     for (auto& pipeline : m_pipelines)
     {
-        for (uint32_t id = 0; id < m_runtime.m_renderer->getWindow().getImageCount(); id++)
+        for (uint32_t id = 0; id < kMAX_NUMBER_OF_FRAMES; id++)
         {
 
             //globals per frame
@@ -644,11 +663,11 @@ void DeferredPassVK::createDescriptors()
 
             //information about the buffer we want to point at in the descriptor
             VkDescriptorBufferInfo binfo[2];
-            binfo[0].buffer = m_runtime.getPerFrameBuffer()[id];
+            binfo[0].buffer = m_runtime.getUploadBuffer()[id];
             binfo[0].offset = 0;
             binfo[0].range = sizeof(PerFrameData);
 
-            binfo[1].buffer = m_runtime.getPerObjectBuffer()[id];
+            binfo[1].buffer = m_runtime.getPerObjectBuffer();
             binfo[1].offset = 0;
             binfo[1].range = sizeof(PerObjectData) * kMAX_NUMBER_OF_OBJECTS;
 
@@ -658,7 +677,7 @@ void DeferredPassVK::createDescriptors()
             set_write[0].dstBinding = 0;
             set_write[0].dstSet = pipeline.m_descriptor_sets[id].m_per_frame_descriptor;
             set_write[0].descriptorCount = 1;
-            set_write[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            set_write[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             set_write[0].pBufferInfo = &binfo[0];
 
             set_write[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
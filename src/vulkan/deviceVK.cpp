@@ -2,6 +2,7 @@
 #include "vulkan/rendererVK.h"
 #include "vulkan/windowVK.h"
 #include "vulkan/utilsVK.h"
+#include "vulkan/submitQueueVK.h"
 #include "common.h"
 
 
@@ -14,6 +15,8 @@ DeviceVK::DeviceVK( const RendererVK& i_renderer ) :
     m_graphics_queue_index             ( 0              ),
     m_command_pool                     ( VK_NULL_HANDLE ),
     m_graphics_queue                   ( VK_NULL_HANDLE ),
+    m_transfer_queue_index             ( UINT32_MAX     ),
+    m_transfer_queue                   ( VK_NULL_HANDLE ),
     m_phyisical_device_properties      ( {}             ),
     m_physical_device_features         ( {}             ),
     m_physical_device_memory_properties( {}             )
@@ -80,6 +83,40 @@ uint32_t DeviceVK::getQueueFamilyIndex( VkQueueFlagBits i_queue_flags ) const
 }
 
 
+uint32_t DeviceVK::getTransferQueueFamilyIndex() const
+{
+    if( !kTRANSFER_QUEUE )
+    {
+        return UINT32_MAX;
+    }
+
+    //a family with transfer and nothing else is the copy engine, next best is one without graphics
+    uint32_t transfer_queue_index = UINT32_MAX;
+
+    for( uint32_t i = 0; i < m_queue_family_properties.size(); i++ )
+    {
+        const VkQueueFlags flags = m_queue_family_properties[ i ].queueFlags;
+
+        if( ( flags & VK_QUEUE_TRANSFER_BIT ) == 0 || ( flags & VK_QUEUE_GRAPHICS_BIT ) != 0 )
+        {
+            continue;
+        }
+
+        if( ( flags & VK_QUEUE_COMPUTE_BIT ) == 0 )
+        {
+            return i;
+        }
+
+        if( transfer_queue_index == UINT32_MAX )
+        {
+            transfer_queue_index = i;
+        }
+    }
+
+    return transfer_queue_index;
+}
+
+
 void DeviceVK::createPhysicalDevice()
 {
     // Physical device
@@ -177,6 +214,15 @@ void DeviceVK::createDevice()
     queue_info.queueCount       = 1;
     queue_info.pQueuePriorities = &default_queue_priority;
     queue_create_infos.push_back( queue_info );
+
+    // Transfer queue, uploads run on it next to the rendering when the device has one
+    m_transfer_queue_index = getTransferQueueFamilyIndex();
+
+    if( m_transfer_queue_index != UINT32_MAX )
+    {
+        queue_info.queueFamilyIndex = m_transfer_queue_index;
+        queue_create_infos.push_back( queue_info );
+    }
     
 
     // Create the logical device representation
@@ -189,6 +235,13 @@ void DeviceVK::createDevice()
     bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
     bufferDeviceAddressFeatures.bufferDeviceAddress = VK_TRUE;
 
+    //core in 1.2, the submission layer tracks the graphics queue with it
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{};
+    timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+
+    bufferDeviceAddressFeatures.pNext = &timelineSemaphoreFeatures;
+
 
     VkDeviceCreateInfo device_create_info = {};
     device_create_info.sType                = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -239,6 +292,18 @@ void DeviceVK::createDevice()
 #endif
 
     vkGetDeviceQueue( m_logical_device, m_graphics_queue_index, 0, &m_graphics_queue );
+
+    if( m_transfer_queue_index != UINT32_MAX )
+    {
+        vkGetDeviceQueue( m_logical_device, m_transfer_queue_index, 0, &m_transfer_queue );
+
+        m_transfer_submit_queue = std::make_unique<SubmitQueueVK>( *this );
+        m_transfer_submit_queue->initialize( m_transfer_queue, m_transfer_queue_index );
+    }
+
+    m_submit_queue = std::make_unique<SubmitQueueVK>( *this );
+    m_submit_queue->initialize( m_graphics_queue, m_graphics_queue_index );
+    m_submit_queue->createUploadBatcher( m_transfer_submit_queue.get() );
 }
 
 
@@ -277,6 +342,19 @@ uint32_t DeviceVK::getMemoryTypeIndex( uint32_t typeBits, VkMemoryPropertyFlags
 
 void DeviceVK::destroyDevice()
 {
+    //the graphics queue first, its upload batcher hands its last resources to the transfer queue
+    if( m_submit_queue )
+    {
+        m_submit_queue->shutdown();
+        m_submit_queue = nullptr;
+    }
+
+    if( m_transfer_submit_queue )
+    {
+        m_transfer_submit_queue->shutdown();
+        m_transfer_submit_queue = nullptr;
+    }
+
     vkDestroyCommandPool( m_logical_device, m_command_pool, nullptr );
     vkDestroyDevice( m_logical_device, nullptr );
 }
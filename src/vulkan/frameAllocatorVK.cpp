@@ -0,0 +1,78 @@
+#include "vulkan/frameAllocatorVK.h"
+#include "vulkan/deviceVK.h"
+#include "vulkan/utilsVK.h"
+
+using namespace MiniEngine;
+
+
+FrameAllocatorVK::FrameAllocatorVK( const DeviceVK& i_device ) :
+    m_device( i_device       ),
+    m_buffer( VK_NULL_HANDLE ),
+    m_memory( VK_NULL_HANDLE ),
+    m_mapped( nullptr        ),
+    m_size  ( 0              ),
+    m_head  ( 0              )
+{
+}
+
+
+void FrameAllocatorVK::initialize( const VkDeviceSize i_size, const VkBufferUsageFlags i_usage )
+{
+    assert( m_buffer == VK_NULL_HANDLE );
+
+    UtilsVK::createBuffer( m_device, i_size, i_usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_buffer, m_memory );
+
+    //mapped once for the whole life of the buffer, coherent memory so no flush is needed
+    if( VK_SUCCESS != vkMapMemory( m_device.getLogicalDevice(), m_memory, 0, i_size, 0, reinterpret_cast<void**>( &m_mapped ) ) )
+    {
+        throw MiniEngineException( "Error mapping frame allocator buffer" );
+    }
+
+    m_size = i_size;
+    m_head = 0;
+
+    UtilsVK::setObjectName( m_device.getLogicalDevice(), (uint64_t)m_buffer, VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, "Frame Upload Buffer" );
+}
+
+
+void FrameAllocatorVK::shutdown()
+{
+    if( m_buffer != VK_NULL_HANDLE )
+    {
+        vkUnmapMemory  ( m_device.getLogicalDevice(), m_memory );
+        vkDestroyBuffer( m_device.getLogicalDevice(), m_buffer, nullptr );
+        vkFreeMemory   ( m_device.getLogicalDevice(), m_memory, nullptr );
+    }
+
+    m_buffer = VK_NULL_HANDLE;
+    m_memory = VK_NULL_HANDLE;
+    m_mapped = nullptr;
+    m_size   = 0;
+    m_head   = 0;
+}
+
+
+void FrameAllocatorVK::reset()
+{
+    m_head = 0;
+}
+
+
+void* FrameAllocatorVK::allocate( const VkDeviceSize i_size, const VkDeviceSize i_alignment, uint32_t& o_offset )
+{
+    assert( m_mapped );
+
+    //alignments reported by the device are always power of two
+    const VkDeviceSize alignment = std::max<VkDeviceSize>( i_alignment, 1 );
+    const VkDeviceSize offset    = ( m_head + alignment - 1 ) & ~( alignment - 1 );
+
+    if( offset + i_size > m_size )
+    {
+        throw MiniEngineException( "Frame allocator out of memory, requested %d bytes", i_size );
+    }
+
+    m_head   = offset + i_size;
+    o_offset = static_cast<uint32_t>( offset );
+
+    return m_mapped + offset;
+}
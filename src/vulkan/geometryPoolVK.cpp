@@ -0,0 +1,158 @@
+#include "vulkan/geometryPoolVK.h"
+#include "vulkan/deviceVK.h"
+#include "vulkan/meshVK.h"
+#include "vulkan/utilsVK.h"
+
+using namespace MiniEngine;
+
+
+GeometryPoolVK::GeometryPoolVK( const DeviceVK& i_device ) :
+    m_device         ( i_device ),
+    m_vertex_capacity( 0        ),
+    m_index_capacity ( 0        )
+{
+}
+
+
+void GeometryPoolVK::initialize( const uint32_t i_vertex_capacity, const uint32_t i_index_capacity )
+{
+    m_vertex_capacity = i_vertex_capacity;
+    m_index_capacity  = i_index_capacity;
+
+    for( uint32_t heap_id = 0; heap_id < m_index_heaps.size(); heap_id++ )
+    {
+        IndexHeap& heap = m_index_heaps[ heap_id ];
+        assert( heap.m_buffer == VK_NULL_HANDLE );
+
+        const VkDeviceSize index_size = heap_id == 0 ? sizeof( uint16_t ) : sizeof( uint32_t );
+
+        UtilsVK::createBuffer( m_device, index_size * i_index_capacity, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, heap.m_buffer, heap.m_memory );
+        UtilsVK::setObjectName( m_device.getLogicalDevice(), (uint64_t) heap.m_buffer, VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, heap_id == 0 ? "Geometry Pool 16 Bit Indices" : "Geometry Pool 32 Bit Indices" );
+
+        heap.m_allocator.reset( i_index_capacity );
+    }
+}
+
+
+void GeometryPoolVK::shutdown()
+{
+    for( VertexHeap& heap : m_vertex_heaps )
+    {
+        if( heap.m_positions_buffer != VK_NULL_HANDLE )
+        {
+            vkDestroyBuffer( m_device.getLogicalDevice(), heap.m_positions_buffer , nullptr );
+            vkDestroyBuffer( m_device.getLogicalDevice(), heap.m_attributes_buffer, nullptr );
+            vkFreeMemory   ( m_device.getLogicalDevice(), heap.m_positions_memory , nullptr );
+            vkFreeMemory   ( m_device.getLogicalDevice(), heap.m_attributes_memory, nullptr );
+        }
+
+        heap = VertexHeap();
+    }
+
+    for( IndexHeap& heap : m_index_heaps )
+    {
+        if( heap.m_buffer != VK_NULL_HANDLE )
+        {
+            vkDestroyBuffer( m_device.getLogicalDevice(), heap.m_buffer, nullptr );
+            vkFreeMemory   ( m_device.getLogicalDevice(), heap.m_memory, nullptr );
+        }
+
+        heap = IndexHeap();
+    }
+}
+
+
+GeometryAllocation GeometryPoolVK::allocate( const VertexLayout i_layout, const uint32_t i_vertex_count, const VkIndexType i_index_type, const uint32_t i_index_count )
+{
+    VertexHeap& heap = m_vertex_heaps[ static_cast<uint32_t>( i_layout ) ];
+
+    if( heap.m_positions_buffer == VK_NULL_HANDLE )
+    {
+        createVertexHeap( i_layout );
+    }
+
+    GeometryAllocation allocation;
+    allocation.m_layout       = i_layout;
+    allocation.m_index_type   = i_index_type;
+    allocation.m_vertex_count = i_vertex_count;
+    allocation.m_index_count  = i_index_count;
+
+    allocation.m_vertex_offset = heap.m_allocator.allocate( i_vertex_count );
+    if( allocation.m_vertex_offset == RangeAllocator::kINVALID_OFFSET )
+    {
+        return GeometryAllocation();
+    }
+
+    allocation.m_index_offset = m_index_heaps[ getIndexHeap( i_index_type ) ].m_allocator.allocate( i_index_count );
+    if( allocation.m_index_offset == RangeAllocator::kINVALID_OFFSET )
+    {
+        heap.m_allocator.free( allocation.m_vertex_offset, i_vertex_count );
+        return GeometryAllocation();
+    }
+
+    return allocation;
+}
+
+
+VkDeviceSize GeometryPoolVK::getCapacity( const VertexLayout i_layout ) const
+{
+    const VkDeviceSize vertex_size = MeshVK::getPositionStride( i_layout ) + MeshVK::getAttributesStride( i_layout );
+
+    return vertex_size * m_vertex_capacity + VkDeviceSize( sizeof( uint16_t ) + sizeof( uint32_t ) ) * m_index_capacity;
+}
+
+
+void GeometryPoolVK::free( const GeometryAllocation& i_allocation )
+{
+    if( i_allocation.m_vertex_offset != RangeAllocator::kINVALID_OFFSET )
+    {
+        m_vertex_heaps[ static_cast<uint32_t>( i_allocation.m_layout ) ].m_allocator.free( i_allocation.m_vertex_offset, i_allocation.m_vertex_count );
+    }
+
+    if( i_allocation.m_index_offset != RangeAllocator::kINVALID_OFFSET )
+    {
+        m_index_heaps[ getIndexHeap( i_allocation.m_index_type ) ].m_allocator.free( i_allocation.m_index_offset, i_allocation.m_index_count );
+    }
+}
+
+
+void GeometryPoolVK::bind( VkCommandBuffer i_command_buffer, const VertexLayout i_layout, const VertexStreams i_streams ) const
+{
+    const VertexHeap& heap = m_vertex_heaps[ static_cast<uint32_t>( i_layout ) ];
+
+    if( heap.m_positions_buffer == VK_NULL_HANDLE )
+    {
+        return;
+    }
+
+    VkBuffer     buffers[] = { heap.m_positions_buffer, heap.m_attributes_buffer };
+    VkDeviceSize offsets[] = { 0, 0 };
+
+    const uint32_t stream_count = i_streams == VertexStreams::Positions ? 1 : 2;
+
+    vkCmdBindVertexBuffers( i_command_buffer, 0, stream_count, buffers, offsets );
+}
+
+
+void GeometryPoolVK::bindIndices( VkCommandBuffer i_command_buffer, const VkIndexType i_index_type ) const
+{
+    vkCmdBindIndexBuffer( i_command_buffer, m_index_heaps[ getIndexHeap( i_index_type ) ].m_buffer, 0, i_index_type );
+}
+
+
+void GeometryPoolVK::createVertexHeap( const VertexLayout i_layout )
+{
+    VertexHeap& heap = m_vertex_heaps[ static_cast<uint32_t>( i_layout ) ];
+
+    const VkDeviceSize positions_size  = VkDeviceSize( MeshVK::getPositionStride  ( i_layout ) ) * m_vertex_capacity;
+    const VkDeviceSize attributes_size = VkDeviceSize( MeshVK::getAttributesStride( i_layout ) ) * m_vertex_capacity;
+
+    UtilsVK::createBuffer( m_device, positions_size , VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, heap.m_positions_buffer , heap.m_positions_memory  );
+    UtilsVK::createBuffer( m_device, attributes_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, heap.m_attributes_buffer, heap.m_attributes_memory );
+
+    const bool packed = i_layout == VertexLayout::Packed;
+    UtilsVK::setObjectName( m_device.getLogicalDevice(), (uint64_t) heap.m_positions_buffer , VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, packed ? "Geometry Pool Packed Positions"  : "Geometry Pool Positions"  );
+    UtilsVK::setObjectName( m_device.getLogicalDevice(), (uint64_t) heap.m_attributes_buffer, VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, packed ? "Geometry Pool Packed Attributes" : "Geometry Pool Attributes" );
+
+    heap.m_allocator.reset( m_vertex_capacity );
+}
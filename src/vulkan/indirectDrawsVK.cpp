@@ -0,0 +1,171 @@
+#include "vulkan/indirectDrawsVK.h"
+#include "vulkan/deviceVK.h"
+#include "vulkan/geometryPoolVK.h"
+#include "vulkan/utilsVK.h"
+#include "entity.h"
+
+using namespace MiniEngine;
+
+
+IndirectDrawsVK::IndirectDrawsVK( const DeviceVK& i_device, const GeometryPoolVK& i_geometry_pool ) :
+    m_device       ( i_device        ),
+    m_geometry_pool( i_geometry_pool ),
+    m_multi_draw   ( false           )
+{
+}
+
+
+void IndirectDrawsVK::initialize()
+{
+    m_multi_draw = m_device.getPhysicalDeviceFeatures().multiDrawIndirect == VK_TRUE;
+}
+
+
+void IndirectDrawsVK::shutdown()
+{
+    for( Slot& slot : m_slots )
+    {
+        destroySlot( slot );
+    }
+
+    m_buckets.clear();
+}
+
+
+void IndirectDrawsVK::update( const uint32_t i_frame_id, const std::unordered_map<uint32_t, std::vector<EntityPtr>>& i_buckets, const uint32_t i_bucket_count, const LodTarget i_target )
+{
+    assert( i_frame_id < m_slots.size() );
+
+    uint32_t total = 0;
+    for( const auto& bucket : i_buckets )
+    {
+        for( const EntityPtr& entity : bucket.second )
+        {
+            total += entity->getDrawCount();
+        }
+    }
+
+    Slot& slot = m_slots[ i_frame_id ];
+
+    if( slot.m_buffer == VK_NULL_HANDLE )
+    {
+        createSlot( slot, total );
+    }
+    else if( total > slot.m_capacity )
+    {
+        //entities that finished loading, nothing in flight reads this slot anymore
+        const uint32_t capacity = std::max( total, slot.m_capacity * 2 );
+        destroySlot( slot );
+        createSlot ( slot, capacity );
+    }
+
+    m_buckets.assign( i_bucket_count, Bucket() );
+
+    uint32_t count = 0;
+    for( uint32_t bucket_id = 0; bucket_id < i_bucket_count; bucket_id++ )
+    {
+        Bucket& bucket = m_buckets[ bucket_id ];
+        bucket.m_offset = count;
+
+        auto it = i_buckets.find( bucket_id );
+        if( it == i_buckets.end() )
+        {
+            continue;
+        }
+
+        //one pass per index type, the bucket draws each with a single index buffer bind
+        for( const VkIndexType index_type : { VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32 } )
+        {
+            for( const EntityPtr& entity : it->second )
+            {
+                if( entity->getIndexType() == index_type )
+                {
+                    entity->getDrawCommands( i_target, slot.m_mapped + count );
+                    count += entity->getDrawCount();
+                }
+            }
+
+            if( index_type == VK_INDEX_TYPE_UINT16 )
+            {
+                bucket.m_short_count = count - bucket.m_offset;
+            }
+        }
+
+        bucket.m_count = count - bucket.m_offset;
+    }
+}
+
+
+void IndirectDrawsVK::draw( VkCommandBuffer i_command_buffer, const uint32_t i_frame_id, const uint32_t i_bucket ) const
+{
+    assert( i_bucket < m_buckets.size() );
+
+    const Bucket& bucket = m_buckets[ i_bucket ];
+    VkBuffer      buffer = m_slots[ i_frame_id ].m_buffer;
+
+    if( bucket.m_short_count > 0 )
+    {
+        m_geometry_pool.bindIndices( i_command_buffer, VK_INDEX_TYPE_UINT16 );
+        drawRange( i_command_buffer, buffer, bucket.m_offset, bucket.m_short_count );
+    }
+
+    if( bucket.m_count > bucket.m_short_count )
+    {
+        m_geometry_pool.bindIndices( i_command_buffer, VK_INDEX_TYPE_UINT32 );
+        drawRange( i_command_buffer, buffer, bucket.m_offset + bucket.m_short_count, bucket.m_count - bucket.m_short_count );
+    }
+}
+
+
+bool IndirectDrawsVK::isSupported( const DeviceVK& i_device )
+{
+    return kINDIRECT_DRAWS && i_device.getPhysicalDeviceFeatures().drawIndirectFirstInstance == VK_TRUE;
+}
+
+
+void IndirectDrawsVK::createSlot( Slot& io_slot, const uint32_t i_capacity )
+{
+    io_slot.m_capacity = std::max( i_capacity, 1u );
+
+    const VkDeviceSize size = sizeof( VkDrawIndexedIndirectCommand ) * VkDeviceSize( io_slot.m_capacity );
+
+    UtilsVK::createBuffer( m_device, size, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, io_slot.m_buffer, io_slot.m_memory );
+
+    //mapped once for the whole life of the buffer, coherent memory so no flush is needed
+    if( VK_SUCCESS != vkMapMemory( m_device.getLogicalDevice(), io_slot.m_memory, 0, size, 0, reinterpret_cast<void**>( &io_slot.m_mapped ) ) )
+    {
+        throw MiniEngineException( "Error mapping indirect draws buffer" );
+    }
+
+    UtilsVK::setObjectName( m_device.getLogicalDevice(), (uint64_t)io_slot.m_buffer, VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, "Indirect Draws Buffer" );
+}
+
+
+void IndirectDrawsVK::destroySlot( Slot& io_slot )
+{
+    if( io_slot.m_buffer != VK_NULL_HANDLE )
+    {
+        vkUnmapMemory  ( m_device.getLogicalDevice(), io_slot.m_memory );
+        vkDestroyBuffer( m_device.getLogicalDevice(), io_slot.m_buffer, nullptr );
+        vkFreeMemory   ( m_device.getLogicalDevice(), io_slot.m_memory, nullptr );
+    }
+
+    io_slot = Slot();
+}
+
+
+void IndirectDrawsVK::drawRange( VkCommandBuffer i_command_buffer, VkBuffer i_buffer, const uint32_t i_offset, const uint32_t i_count ) const
+{
+    const VkDeviceSize stride = sizeof( VkDrawIndexedIndirectCommand );
+
+    if( m_multi_draw )
+    {
+        vkCmdDrawIndexedIndirect( i_command_buffer, i_buffer, stride * i_offset, i_count, static_cast<uint32_t>( stride ) );
+        return;
+    }
+
+    for( uint32_t id = 0; id < i_count; id++ )
+    {
+        vkCmdDrawIndexedIndirect( i_command_buffer, i_buffer, stride * ( i_offset + id ), 1, static_cast<uint32_t>( stride ) );
+    }
+}
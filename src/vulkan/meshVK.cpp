@@ -3,126 +3,514 @@
 #include "vulkan/meshVK.h"
 #include "vulkan/rendererVK.h"
 #include "vulkan/deviceVK.h"
+#include "vulkan/geometryPoolVK.h"
+#include "vulkan/submitQueueVK.h"
+#include "vulkan/uploadBatcherVK.h"
 #include "vulkan/utilsVK.h"
 
 using namespace MiniEngine;
 
 
+namespace
+{
+    //vertices reachable by a 16 bit index
+    constexpr uint32_t kSHORT_INDEX_RANGE = 1 << 16;
+
+    //positions go to the cube around the bounds, one scale for the three axes so the dequantization is a
+    //uniform scale and the normal matrix built from the model keeps the normals' direction
+    void getQuantization( const MeshBounds& i_bounds, Vector3f& o_origin, float& o_extent )
+    {
+        const Vector3f size = i_bounds.m_max - i_bounds.m_min;
+
+        o_origin = i_bounds.m_min;
+        o_extent = std::max( { size.x, size.y, size.z } );
 
-MeshVK::MeshVK( const Runtime& i_runtime, const std::string& i_path, const std::vector<uint32_t> i_indices, const std::vector<Vertex> i_vertices ) :
-    m_runtime       ( i_runtime   ),
-    m_path          ( i_path      ),
-    m_indices       ( i_indices   ),
-    m_vertices      ( i_vertices  ),
-    m_indices_buffer( VK_NULL_HANDLE ),
-    m_data_buffer   ( VK_NULL_HANDLE )
+        if( !( o_extent > 0.0f ) )
+        {
+            o_extent = 1.0f;
+        }
+    }
+
+
+    //the octahedron folded on the z = 0 plane, the lower half over the corners
+    uint32_t packOctahedral( const Vector3f& i_normal )
+    {
+        Vector3f normal = i_normal / std::max( std::abs( i_normal.x ) + std::abs( i_normal.y ) + std::abs( i_normal.z ), kEPSILON );
+
+        Vector2f encoded( normal.x, normal.y );
+
+        if( normal.z < 0.0f )
+        {
+            encoded.x = ( 1.0f - std::abs( normal.y ) ) * ( normal.x >= 0.0f ? 1.0f : -1.0f );
+            encoded.y = ( 1.0f - std::abs( normal.x ) ) * ( normal.y >= 0.0f ? 1.0f : -1.0f );
+        }
+
+        return glm::packSnorm2x16( encoded );
+    }
+
+
+    //one vertex array to the position and attribute streams of i_layout
+    void splitVertices( const Vertex* i_vertices, const uint32_t i_count, const VertexLayout i_layout, const MeshBounds& i_bounds, void* o_positions, void* o_attributes )
+    {
+        if( i_layout == VertexLayout::Full )
+        {
+            Vector3f*         positions  = static_cast<Vector3f*>        ( o_positions  );
+            VertexAttributes* attributes = static_cast<VertexAttributes*>( o_attributes );
+
+            for( uint32_t id = 0; id < i_count; id++ )
+            {
+                positions [ id ]          = i_vertices[ id ].m_position;
+                attributes[ id ].m_normal = i_vertices[ id ].m_normal;
+                attributes[ id ].m_uv     = i_vertices[ id ].m_uv;
+            }
+
+            return;
+        }
+
+        Vector3f origin;
+        float    extent;
+        getQuantization( i_bounds, origin, extent );
+
+        const float scale = 65535.0f / extent;
+
+        for( uint32_t id = 0; id < i_count; id++ )
+        {
+            const Vertex&    vertex = i_vertices[ id ];
+            PackedPosition   position;
+            PackedAttributes attributes;
+
+            for( uint32_t axis = 0; axis < 3; axis++ )
+            {
+                const float value = ( vertex.m_position[ axis ] - origin[ axis ] ) * scale + 0.5f;
+                position.m_position[ axis ] = static_cast<uint16_t>( std::min( std::max( value, 0.0f ), 65535.0f ) );
+            }
+            position.m_position[ 3 ] = 0;
+
+            const uint32_t normal = packOctahedral( vertex.m_normal );
+            const uint32_t uv     = glm::packHalf2x16( vertex.m_uv );
+
+            memcpy( attributes.m_normal, &normal, sizeof( uint32_t ) );
+            memcpy( attributes.m_uv    , &uv    , sizeof( uint32_t ) );
+
+            memcpy( static_cast<PackedPosition*>  ( o_positions  ) + id, &position  , sizeof( PackedPosition   ) );
+            memcpy( static_cast<PackedAttributes*>( o_attributes ) + id, &attributes, sizeof( PackedAttributes ) );
+        }
+    }
+
+}
+
+
+
+MeshVK::MeshVK( const Runtime& i_runtime, const std::string& i_path, const VertexLayout i_layout ) :
+    m_runtime        ( i_runtime   ),
+    m_path           ( i_path      ),
+    m_index_count    ( 0           ),
+    m_vertex_count   ( 0           ),
+    m_layout         ( i_layout    ),
+    m_dequantization ( 1.0f        ),
+    m_allocation     (             ),
+    m_chunks_per_lod ( 0           ),
+    m_last_used_frame( 0           ),
+    m_upload_value   ( 0           )
 {
 
 }
 
 
-bool MeshVK::initialize()
+bool MeshVK::initialize( const MeshData& i_data )
 {
-    assert( !m_indices.empty() && !m_vertices.empty() );
+    assert( i_data.m_index_count > 0 && i_data.m_vertex_count > 0 );
 
-    if( !m_indices.empty() )
-    {
-        createIndexBuffer();
+    m_index_count  = i_data.m_index_count;
+    m_vertex_count = i_data.m_vertex_count;
+    m_bounds       = i_data.m_bounds;
+    m_lods         = i_data.m_lods;
 
-        UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t) m_indices_buffer, VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, "Indices Buffer" );
-        UtilsVK::setObjectTag ( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t) m_indices_buffer, VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, 0, m_path.size(), m_path.c_str() );
+    if( m_lods.empty() )
+    {
+        m_lods.push_back( { 0, m_index_count, 0.0f } );
     }
 
-    if( !m_vertices.empty() )
+    if( m_layout == VertexLayout::Packed )
     {
-        m_data_buffer = createVertexBuffer( m_vertices, m_data_memory );
+        Vector3f origin;
+        float    extent;
+        getQuantization( m_bounds, origin, extent );
 
-        UtilsVK::setObjectName( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t) m_indices_buffer, VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, "Vertex Buffer"                  );
-        UtilsVK::setObjectTag ( m_runtime.m_renderer->getDevice()->getLogicalDevice(), (uint64_t) m_indices_buffer, VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, 0, m_path.size(), m_path.c_str() );
+        m_dequantization = glm::scale( glm::translate( Matrix4f( 1.0f ), origin ), Vector3f( extent ) );
     }
 
+    //16 bit indices when they reach every vertex, bigger meshes only get them cut in chunks. The indices are
+    //never kept here, the chunks are found on a first pass over the reader and the upload goes through it again
+    const bool split       = kSPLIT_INDEX_CHUNKS && m_vertex_count > kSHORT_INDEX_RANGE;
+    const bool fits        = createChunks( i_data, split );
+    const bool short_index = split ? fits : m_vertex_count <= kSHORT_INDEX_RANGE;
+
+    //one range of the pool for the vertices and one for the indices, the buffers are shared by every mesh
+    m_allocation = m_runtime.m_geometry_pool->allocate( m_layout, m_vertex_count, short_index ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32, m_index_count );
+
+    if( !isResident() )
+    {
+        return false;
+    }
+
+    createIndexBuffer ( i_data );
+    createVertexBuffer( i_data );
+
+    //a full staging ring may have submitted part of the copies already, the rest go with the next submit
+    m_upload_value = m_runtime.m_renderer->getDevice()->getSubmitQueue().getSubmittedValue() + 1;
+
     return true;
 }
 
 
 void MeshVK::shutdown()
 {
-    const RendererVK&  renderer = *m_runtime.m_renderer;
+    if( m_allocation.m_vertex_offset != RangeAllocator::kINVALID_OFFSET )
+    {
+        m_runtime.m_geometry_pool->free( m_allocation );
+        m_allocation = GeometryAllocation();
+    }
+}
+
+
+void MeshVK::draw( VkCommandBuffer& i_command_buffer, const uint32_t i_instance_id, const uint32_t i_lod )
+{
+    assert( i_lod < m_lods.size() );
 
-    if( m_indices_buffer )
+    UtilsVK::beginRegion( i_command_buffer, m_path.c_str(), Vector4f( 0.0f, 0.0f, 1.0f, 1.0f ) );
+    UtilsVK::insert( i_command_buffer, m_path.c_str(), Vector4f( 0.0f, 0.5f, 0.5f, 1.0f ) );
+
+    m_runtime.m_geometry_pool->bindIndices( i_command_buffer, getIndexType() );
+
+    for( uint32_t chunk_id = i_lod * m_chunks_per_lod; chunk_id < ( i_lod + 1 ) * m_chunks_per_lod; chunk_id++ )
     {
-        vkDestroyBuffer( renderer.getDevice()->getLogicalDevice(), m_indices_buffer, nullptr );
-        vkFreeMemory   ( renderer.getDevice()->getLogicalDevice(), m_indices_memory, nullptr );
+        if( m_chunks[ chunk_id ].m_index_count == 0 )
+        {
+            continue;
+        }
+
+        const VkDrawIndexedIndirectCommand command = getChunkCommand( i_instance_id, m_chunks[ chunk_id ] );
+        vkCmdDrawIndexed( i_command_buffer, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance );
     }
 
-    if( m_data_buffer )
+    UtilsVK::endRegion( i_command_buffer );
+}
+
+
+void MeshVK::getDrawCommands( const uint32_t i_instance_id, const uint32_t i_lod, VkDrawIndexedIndirectCommand* o_commands ) const
+{
+    assert( i_lod < m_lods.size() );
+
+    for( uint32_t id = 0; id < m_chunks_per_lod; id++ )
     {
-        vkDestroyBuffer( renderer.getDevice()->getLogicalDevice(), m_data_buffer, nullptr );
-        vkFreeMemory   ( renderer.getDevice()->getLogicalDevice(), m_data_memory, nullptr );
+        o_commands[ id ] = getChunkCommand( i_instance_id, m_chunks[ i_lod * m_chunks_per_lod + id ] );
     }
 }
 
 
-void MeshVK::draw( VkCommandBuffer& i_command_buffer, const uint32_t i_instance_id )
+VkDrawIndexedIndirectCommand MeshVK::getChunkCommand( const uint32_t i_instance_id, const IndexChunk& i_chunk ) const
 {
-    VkBuffer data_buffers[] = { m_data_buffer };
-    VkDeviceSize offsets [] = { 0 };
+    //the indices are local to the chunk, vertexOffset moves them to its vertices inside the pool
+    VkDrawIndexedIndirectCommand command;
+    command.indexCount    = i_chunk.m_index_count;
+    command.instanceCount = 1;
+    command.firstIndex    = m_allocation.m_index_offset + i_chunk.m_index_offset;
+    command.vertexOffset  = static_cast<int32_t>( m_allocation.m_vertex_offset + i_chunk.m_base_vertex );
+    command.firstInstance = i_instance_id;
+
+    return command;
+}
 
-    UtilsVK::beginRegion( i_command_buffer, m_path.c_str(), Vector4f( 0.0f, 0.0f, 1.0f, 1.0f ) );
-    UtilsVK::insert( i_command_buffer, m_path.c_str(), Vector4f( 0.0f, 0.5f, 0.5f, 1.0f ) );
 
-    vkCmdBindIndexBuffer( i_command_buffer, m_indices_buffer, 0, VK_INDEX_TYPE_UINT32 );
-    vkCmdBindVertexBuffers( i_command_buffer, 0, 1, data_buffers, offsets );
-    vkCmdDrawIndexed( i_command_buffer, static_cast<uint32_t>( m_indices.size() ), 1, 0, 0, i_instance_id );
+void MeshVK::getVertexInput( const VertexLayout i_layout, const VertexStreams i_streams, std::vector<VkVertexInputBindingDescription>& o_bindings, std::vector<VkVertexInputAttributeDescription>& o_attributes )
+{
+    const bool packed = i_layout == VertexLayout::Packed;
 
-    UtilsVK::endRegion( i_command_buffer );
+    o_bindings  .clear();
+    o_attributes.clear();
+
+    //positions
+    o_bindings  .push_back( { 0, getPositionStride( i_layout ), VK_VERTEX_INPUT_RATE_VERTEX } );
+    o_attributes.push_back( { 0, 0, packed ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32_SFLOAT, 0 } );
+
+    if( i_streams == VertexStreams::Positions )
+    {
+        return;
+    }
+
+    //normals and uvs
+    o_bindings.push_back( { 1, getAttributesStride( i_layout ), VK_VERTEX_INPUT_RATE_VERTEX } );
+
+    if( packed )
+    {
+        o_attributes.push_back( { 1, 1, VK_FORMAT_R16G16_SNORM, offsetof( PackedAttributes, m_normal ) } );
+        o_attributes.push_back( { 2, 1, VK_FORMAT_R16G16_SFLOAT, offsetof( PackedAttributes, m_uv ) } );
+    }
+    else
+    {
+        o_attributes.push_back( { 1, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof( VertexAttributes, m_normal ) } );
+        o_attributes.push_back( { 2, 1, VK_FORMAT_R32G32_SFLOAT, offsetof( VertexAttributes, m_uv ) } );
+    }
+}
+
+
+const char* MeshVK::getVertexShader( const VertexLayout i_layout, const VertexStreams i_streams )
+{
+    const bool packed = i_layout == VertexLayout::Packed;
+
+    if( i_streams == VertexStreams::Positions )
+    {
+        return packed ? "./shaders/depth_packed.spv" : "./shaders/depth.spv";
+    }
+
+    return packed ? "./shaders/vert_packed.spv" : "./shaders/vert.spv";
+}
+
+
+uint32_t MeshVK::getPositionStride( const VertexLayout i_layout )
+{
+    return i_layout == VertexLayout::Packed ? sizeof( PackedPosition ) : sizeof( Vector3f );
+}
+
+
+uint32_t MeshVK::getAttributesStride( const VertexLayout i_layout )
+{
+    return i_layout == VertexLayout::Packed ? sizeof( PackedAttributes ) : sizeof( VertexAttributes );
+}
+
+
+VkDeviceSize MeshVK::getByteSize() const
+{
+    if( !isResident() )
+    {
+        return 0;
+    }
+
+    const VkDeviceSize index_size = getIndexType() == VK_INDEX_TYPE_UINT16 ? sizeof( uint16_t ) : sizeof( uint32_t );
+
+    return VkDeviceSize( getPositionStride( m_layout ) + getAttributesStride( m_layout ) ) * m_vertex_count + index_size * m_index_count;
 }
 
 
-VkBuffer MeshVK::createVertexBuffer( const std::vector<Vertex>& i_data, VkDeviceMemory& i_memory )
+uint32_t MeshVK::selectLod( const float i_pixels_per_unit, const float i_max_pixel_error ) const
 {
-    VkBuffer staging_buffer, vertex_buffer;
-    VkDeviceMemory staging_memory;
+    uint32_t lod = 0;
 
-    size_t size = sizeof( Vertex )*i_data.size();
+    while( lod + 1 < m_lods.size() && m_lods[ lod + 1 ].m_error * i_pixels_per_unit <= i_max_pixel_error )
+    {
+        lod++;
+    }
 
-    UtilsVK::createBuffer( *m_runtime.m_renderer->getDevice(), size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_memory );
+    return lod;
+}
 
-    void* data;
-    vkMapMemory( m_runtime.m_renderer->getDevice()->getLogicalDevice(), staging_memory, 0, size, 0, &data );
-    memcpy( data, i_data.data(), size );
-    vkUnmapMemory( m_runtime.m_renderer->getDevice()->getLogicalDevice(), staging_memory );
 
+bool MeshVK::createChunks( const MeshData& i_data, const bool i_split )
+{
+    std::vector<std::vector<IndexChunk>> lod_chunks( m_lods.size() );
+    bool                                 fits = true;
 
-    UtilsVK::createBuffer( *m_runtime.m_renderer->getDevice(), size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertex_buffer, i_memory );
+    if( !i_split )
+    {
+        for( uint32_t lod = 0; lod < m_lods.size(); lod++ )
+        {
+            lod_chunks[ lod ].push_back( { m_lods[ lod ].m_index_offset, m_lods[ lod ].m_index_count, 0 } );
+        }
+    }
+    else
+    {
+        //the levels are disjoint ranges of the index array, the pieces of the reader go through them in index order
+        std::vector<uint32_t> order( m_lods.size() );
+        for( uint32_t lod = 0; lod < m_lods.size(); lod++ )
+        {
+            order[ lod ] = lod;
+        }
+
+        std::sort( order.begin(), order.end(), [ this ]( const uint32_t i_a, const uint32_t i_b ) { return m_lods[ i_a ].m_index_offset < m_lods[ i_b ].m_index_offset; } );
+
+        //triangles in order, a chunk ends when the next one would stretch its vertex range past 16 bits
+        IndexChunk chunk      = { 0, 0, 0 };
+        uint32_t   min_vertex = std::numeric_limits<uint32_t>::max();
+        uint32_t   max_vertex = 0;
+        uint32_t   triangle[ 3 ];
+        uint32_t   corner     = 0; //a triangle can straddle two pieces
+        uint32_t   order_id   = 0;
+
+        auto closeChunk = [ & ]( const uint32_t i_lod )
+        {
+            if( chunk.m_index_count > 0 )
+            {
+                chunk.m_base_vertex = min_vertex;
+                lod_chunks[ i_lod ].push_back( chunk );
+            }
+
+            chunk      = { 0, 0, 0 };
+            min_vertex = std::numeric_limits<uint32_t>::max();
+            max_vertex = 0;
+        };
+
+        i_data.m_read_indices( [ & ]( const uint32_t* i_indices, const uint32_t i_first, const uint32_t i_count )
+        {
+            for( uint32_t id = 0; id < i_count; id++ )
+            {
+                const uint32_t index = i_first + id;
+
+                //past the end of the level, a trailing partial triangle is dropped like the draw drops it
+                while( order_id < order.size() && index >= m_lods[ order[ order_id ] ].m_index_offset + m_lods[ order[ order_id ] ].m_index_count )
+                {
+                    closeChunk( order[ order_id ] );
+                    order_id++;
+                    corner = 0;
+                }
+
+                if( order_id == order.size() || index < m_lods[ order[ order_id ] ].m_index_offset )
+                {
+                    continue;
+                }
+
+                triangle[ corner++ ] = i_indices[ id ];
+                if( corner < 3 )
+                {
+                    continue;
+                }
+                corner = 0;
+
+                const uint32_t triangle_min = std::min( { triangle[ 0 ], triangle[ 1 ], triangle[ 2 ] } );
+                const uint32_t triangle_max = std::max( { triangle[ 0 ], triangle[ 1 ], triangle[ 2 ] } );
+
+                fits = fits && triangle_max - triangle_min < kSHORT_INDEX_RANGE;
+
+                if( chunk.m_index_count > 0 && std::max( max_vertex, triangle_max ) - std::min( min_vertex, triangle_min ) >= kSHORT_INDEX_RANGE )
+                {
+                    closeChunk( order[ order_id ] );
+                }
+
+                if( chunk.m_index_count == 0 )
+                {
+                    chunk.m_index_offset = index - 2;
+                }
+
+                min_vertex = std::min( min_vertex, triangle_min );
+                max_vertex = std::max( max_vertex, triangle_max );
+                chunk.m_index_count += 3;
+            }
+        } );
+
+        //the levels that end with the array
+        for( ; order_id < order.size(); order_id++ )
+        {
+            closeChunk( order[ order_id ] );
+        }
+    }
 
-    UtilsVK::copyBuffer( *m_runtime.m_renderer->getDevice(), staging_buffer, vertex_buffer, size );
+    //the same number of draws for every level, an entity keeps its indirect commands when its level changes
+    m_chunks_per_lod = 1;
+    for( const std::vector<IndexChunk>& chunks : lod_chunks )
+    {
+        m_chunks_per_lod = std::max( m_chunks_per_lod, static_cast<uint32_t>( chunks.size() ) );
+    }
 
-    vkDestroyBuffer( m_runtime.m_renderer->getDevice()->getLogicalDevice(), staging_buffer, nullptr );
-    vkFreeMemory   ( m_runtime.m_renderer->getDevice()->getLogicalDevice(), staging_memory, nullptr );
+    m_chunks.clear();
+    for( std::vector<IndexChunk>& chunks : lod_chunks )
+    {
+        chunks.resize( m_chunks_per_lod, { 0, 0, 0 } );
+        m_chunks.insert( m_chunks.end(), chunks.begin(), chunks.end() );
+    }
 
-    return vertex_buffer;
+    //the chunks still draw right with 32 bit indices, vertexOffset carries their base either way
+    return fits;
 }
 
-void MeshVK::createIndexBuffer()
+
+void MeshVK::createVertexBuffer( const MeshData& i_data )
 {
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_memory;
+    UploadBatcherVK&      upload_batcher = m_runtime.m_renderer->getDevice()->getSubmitQueue().getUploadBatcher();
+    const GeometryPoolVK& pool           = *m_runtime.m_geometry_pool;
 
-    size_t size = sizeof( uint32_t )*m_indices.size();
+    const VkDeviceSize positions_stride  = getPositionStride  ( m_layout );
+    const VkDeviceSize attributes_stride = getAttributesStride( m_layout );
 
-    UtilsVK::createBuffer( *m_runtime.m_renderer->getDevice(), size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_memory );
+    const VkDeviceSize positions_size  = positions_stride *m_vertex_count;
+    const VkDeviceSize attributes_size = attributes_stride*m_vertex_count;
 
-    void* data;
-    vkMapMemory( m_runtime.m_renderer->getDevice()->getLogicalDevice(), staging_memory, 0, size, 0, &data );
-    memcpy( data, m_indices.data(), size );
-    vkUnmapMemory( m_runtime.m_renderer->getDevice()->getLogicalDevice(), staging_memory );
+    //one region for both streams, a second stage could submit the first one before its copy is recorded
+    const VkDeviceSize attributes_offset = ( positions_size + kUPLOAD_ALIGNMENT - 1 ) / kUPLOAD_ALIGNMENT * kUPLOAD_ALIGNMENT;
 
+    const StagingRegion positions  = upload_batcher.stage( attributes_offset + attributes_size );
+    StagingRegion       attributes = positions;
+    attributes.m_offset += attributes_offset;
+    attributes.m_data    = static_cast<uint8_t*>( positions.m_data ) + attributes_offset;
 
-    UtilsVK::createBuffer( *m_runtime.m_renderer->getDevice(), size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indices_buffer, m_indices_memory );
+    //every piece of the reader is split straight into the two streams, from the mapped cache when there is one
+    uint8_t* positions_data  = static_cast<uint8_t*>( positions .m_data );
+    uint8_t* attributes_data = static_cast<uint8_t*>( attributes.m_data );
 
-    UtilsVK::copyBuffer( *m_runtime.m_renderer->getDevice(), staging_buffer, m_indices_buffer, size );
+    i_data.m_read_vertices( [ & ]( const Vertex* i_vertices, const uint32_t i_first, const uint32_t i_count )
+    {
+        splitVertices( i_vertices, i_count, m_layout, m_bounds, positions_data + positions_stride * i_first, attributes_data + attributes_stride * i_first );
+    } );
+
+    upload_batcher.copyToBuffer( positions , positions_size , pool.getPositionsBuffer ( m_layout ), positions_stride  * m_allocation.m_vertex_offset );
+    upload_batcher.copyToBuffer( attributes, attributes_size, pool.getAttributesBuffer( m_layout ), attributes_stride * m_allocation.m_vertex_offset );
+}
+
+void MeshVK::createIndexBuffer( const MeshData& i_data )
+{
+    UploadBatcherVK& upload_batcher = m_runtime.m_renderer->getDevice()->getSubmitQueue().getUploadBatcher();
+
+    const bool         short_index = getIndexType() == VK_INDEX_TYPE_UINT16;
+    const VkDeviceSize index_size  = short_index ? sizeof( uint16_t ) : sizeof( uint32_t );
+
+    const VkDeviceSize  size    = index_size*m_index_count;
+    const StagingRegion staging = upload_batcher.stage( size );
 
-    vkDestroyBuffer( m_runtime.m_renderer->getDevice()->getLogicalDevice(), staging_buffer, nullptr );
-    vkFreeMemory   ( m_runtime.m_renderer->getDevice()->getLogicalDevice(), staging_memory, nullptr );
-}
\ No newline at end of file
+    //the chunks that do not start at vertex 0, in index order, the indices inside one are made relative to its base
+    std::vector<IndexChunk> chunks;
+    for( const IndexChunk& chunk : m_chunks )
+    {
+        if( chunk.m_index_count > 0 && chunk.m_base_vertex > 0 )
+        {
+            chunks.push_back( chunk );
+        }
+    }
+
+    std::sort( chunks.begin(), chunks.end(), []( const IndexChunk& i_a, const IndexChunk& i_b ) { return i_a.m_index_offset < i_b.m_index_offset; } );
+
+    uint32_t chunk_id = 0;
+
+    //every piece of the reader is converted straight into the staging memory
+    i_data.m_read_indices( [ & ]( const uint32_t* i_indices, const uint32_t i_first, const uint32_t i_count )
+    {
+        if( chunks.empty() && !short_index )
+        {
+            memcpy( static_cast<uint32_t*>( staging.m_data ) + i_first, i_indices, sizeof( uint32_t ) * i_count );
+            return;
+        }
+
+        for( uint32_t id = 0; id < i_count; id++ )
+        {
+            const uint32_t index = i_first + id;
+
+            while( chunk_id < chunks.size() && index >= chunks[ chunk_id ].m_index_offset + chunks[ chunk_id ].m_index_count )
+            {
+                chunk_id++;
+            }
+
+            const bool     in_chunk = chunk_id < chunks.size() && index >= chunks[ chunk_id ].m_index_offset;
+            const uint32_t value    = i_indices[ id ] - ( in_chunk ? chunks[ chunk_id ].m_base_vertex : 0 );
+
+            if( short_index )
+            {
+                assert( value < kSHORT_INDEX_RANGE );
+                static_cast<uint16_t*>( staging.m_data )[ index ] = static_cast<uint16_t>( value );
+            }
+            else
+            {
+                static_cast<uint32_t*>( staging.m_data )[ index ] = value;
+            }
+        }
+    } );
+
+    upload_batcher.copyToBuffer( staging, size, m_runtime.m_geometry_pool->getIndexBuffer( getIndexType() ), index_size * VkDeviceSize( m_allocation.m_index_offset ) );
+}
@@ -0,0 +1,34 @@
+#include "vulkan/renderPassVK.h"
+#include "vulkan/commandRecorderVK.h"
+#include "runtime.h"
+#include "frame.h"
+
+using namespace MiniEngine;
+
+
+VkCommandBuffer RenderPassVK::record( const Frame& i_frame )
+{
+    const CommandRecorderVK& recorder = *m_runtime.m_command_recorder;
+
+    update( i_frame );
+
+    if( !recorder.isRecordOnce() )
+    {
+        return draw( i_frame );
+    }
+
+    assert( i_frame.m_image_id < kMAX_NUMBER_OF_SWAPCHAIN_IMAGES );
+
+    CachedCommandBuffer& cached = m_cached_command_buffers[ i_frame.m_frame_id ][ i_frame.m_image_id ];
+
+    if( cached.m_command_buffer   == VK_NULL_HANDLE                  ||
+        cached.m_generation       != recorder.getCacheGeneration()   ||
+        cached.m_per_frame_offset != i_frame.m_per_frame_offset )
+    {
+        cached.m_command_buffer   = draw( i_frame );
+        cached.m_generation       = recorder.getCacheGeneration();
+        cached.m_per_frame_offset = i_frame.m_per_frame_offset;
+    }
+
+    return cached.m_command_buffer;
+}
@@ -1,13 +1,17 @@
 #include "common.h"
 #include "vulkan/utilsVK.h"
+#include "vulkan/commandRecorderVK.h"
 #include "vulkan/rendererVK.h"
 #include "vulkan/deviceVK.h"
 #include "vulkan/windowVK.h"
 #include "runtime.h"
 #include "frame.h"
 #include "shaderRegistry.h"
+#include "pipelineRegistry.h"
 #include "entity.h"
 #include "vulkan/meshVK.h"
+#include "vulkan/geometryPoolVK.h"
+#include "vulkan/indirectDrawsVK.h"
 #include "material.h"
 #include "vulkan/shadowPassVK.h"
 
@@ -23,19 +27,12 @@ ShadowPassVK::ShadowPassVK(
     m_shadowMapResolution(i_shadowMapResolution),
     m_numShadowMaps(i_numShadowMaps)
 {
-    // Inicializamos los command buffers a VK_NULL_HANDLE
-    for (auto& cmd : m_command_buffer)
-    {
-        cmd = VK_NULL_HANDLE;
-    }
 }
 
 ShadowPassVK::~ShadowPassVK() {}
 
 bool ShadowPassVK::initialize()
 {
-    RendererVK& renderer = *m_runtime.m_renderer;
-
     
     m_entities_to_draw = {
         { static_cast<uint32_t>(Material::TMaterial::Diffuse), {} },
@@ -44,7 +41,7 @@ bool ShadowPassVK::initialize()
 
     {
 
-        VkShaderModule vert_module = m_runtime.m_shader_registry->loadShader("./shaders/vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+        VkShaderModule vert_module = m_runtime.m_shader_registry->loadShader(MeshVK::getVertexShader(kSCENE_VERTEX_LAYOUT, kDEPTH_VERTEX_STREAMS), VK_SHADER_STAGE_VERTEX_BIT);
         VkShaderModule geom_module = m_runtime.m_shader_registry->loadShader("./shaders/shadows.geom.spv", VK_SHADER_STAGE_GEOMETRY_BIT);
 
 
@@ -93,16 +90,10 @@ bool ShadowPassVK::initialize()
     createPipelines();
     createFbo();
 
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
-    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.commandPool = renderer.getDevice()->getCommandPool();
-    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    // Se puede ajustar la cantidad de command buffers segn la cantidad de imgenes de la ventana
-    commandBufferAllocateInfo.commandBufferCount = 3;
-
-    if (vkAllocateCommandBuffers(renderer.getDevice()->getLogicalDevice(), &commandBufferAllocateInfo, m_command_buffer.data()) != VK_SUCCESS)
+    if (IndirectDrawsVK::isSupported(*m_runtime.m_renderer->getDevice()))
     {
-        throw MiniEngineException("Error al asignar los command buffers para ShadowPassVK");
+        m_indirect_draws = std::make_unique<IndirectDrawsVK>(*m_runtime.m_renderer->getDevice(), *m_runtime.m_geometry_pool);
+        m_indirect_draws->initialize();
     }
 
     return true;
@@ -112,16 +103,20 @@ void ShadowPassVK::shutdown()
 {
     RendererVK& renderer = *m_runtime.m_renderer;
 
-    vkFreeCommandBuffers(renderer.getDevice()->getLogicalDevice(), renderer.getDevice()->getCommandPool(), m_command_buffer.size(), m_command_buffer.data());
+    if (m_indirect_draws)
+    {
+        m_indirect_draws->shutdown();
+        m_indirect_draws = nullptr;
+    }
 
     // Liberar otros recursos, similar a DepthPrePassVK
     vkDestroyDescriptorPool(renderer.getDevice()->getLogicalDevice(), m_descriptor_pool, nullptr);
     for (auto& pipeline : m_pipelines)
     {
-        vkDestroyDescriptorSetLayout(renderer.getDevice()->getLogicalDevice(), pipeline.m_descriptor_set_layout[0], nullptr);
-        vkDestroyDescriptorSetLayout(renderer.getDevice()->getLogicalDevice(), pipeline.m_descriptor_set_layout[1], nullptr);
-        vkDestroyPipeline(renderer.getDevice()->getLogicalDevice(), pipeline.m_pipeline, nullptr);
-        vkDestroyPipelineLayout(renderer.getDevice()->getLogicalDevice(), pipeline.m_pipeline_layouts, nullptr);
+        m_runtime.m_pipeline_registry->releaseDescriptorSetLayout(pipeline.m_descriptor_set_layout[0]);
+        m_runtime.m_pipeline_registry->releaseDescriptorSetLayout(pipeline.m_descriptor_set_layout[1]);
+        m_runtime.m_pipeline_registry->releasePipeline(pipeline.m_pipeline);
+        m_runtime.m_pipeline_registry->releasePipelineLayout(pipeline.m_pipeline_layouts);
     }
 
     // Se destruyen todos los FBO creados
@@ -137,12 +132,7 @@ void ShadowPassVK::shutdown()
 VkCommandBuffer ShadowPassVK::draw(const Frame& i_frame)
 {
     RendererVK& renderer = *m_runtime.m_renderer;
-    VkCommandBuffer& current_cmd = m_command_buffer[renderer.getWindow().getCurrentImageId()];
-
-    if (current_cmd != VK_NULL_HANDLE)
-    {
-        vkResetCommandBuffer(current_cmd, 0);
-    }
+    VkCommandBuffer current_cmd = m_runtime.m_command_recorder->allocate(i_frame.m_frame_id, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
     VkCommandBufferBeginInfo begin_info{};
     begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -157,7 +147,7 @@ VkCommandBuffer ShadowPassVK::draw(const Frame& i_frame)
     VkRenderPassBeginInfo render_pass_info{};
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     render_pass_info.renderPass = m_render_pass;
-    render_pass_info.framebuffer = m_fbos[renderer.getWindow().getCurrentImageId()];
+    render_pass_info.framebuffer = m_fbos[i_frame.m_image_id];
     render_pass_info.renderArea.offset = { 0, 0 };
     render_pass_info.renderArea.extent = { width, height };
 
@@ -167,33 +157,64 @@ VkCommandBuffer ShadowPassVK::draw(const Frame& i_frame)
     render_pass_info.pClearValues = clear_values;
 
     UtilsVK::beginRegion(current_cmd, "Shadow Pass", Vector4f(0.1f, 0.1f, 0.1f, 1.0f));
-    vkCmdBeginRenderPass(current_cmd, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(current_cmd, &render_pass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    //the entity lists are split in secondary command buffers recorded in parallel by the workers
+    VkCommandBufferInheritanceInfo inheritance_info{};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.renderPass = m_render_pass;
+    inheritance_info.subpass = 0;
+    inheritance_info.framebuffer = m_fbos[i_frame.m_image_id];
+
+    //lookups done here, the workers must not touch the map
+    std::vector<const std::vector<EntityPtr>*> entities(m_pipelines.size(), nullptr);
+    std::vector<uint32_t> bucket_sizes(m_pipelines.size(), 0);
 
-    // Bucle de dibujo para las entidades que generan sombras
     for (uint32_t mat_id = static_cast<uint32_t>(Material::TMaterial::Diffuse); mat_id < static_cast<uint32_t>(m_pipelines.size()); mat_id++)
     {
-        UtilsVK::beginRegion(current_cmd, "Shadow Pass - Material " + mat_id, Vector4f(0.2f, 0.2f, 0.2f, 1.0f));
+        auto it = m_entities_to_draw.find(mat_id);
+        if (it != m_entities_to_draw.end())
+        {
+            entities[mat_id] = &it->second;
+            bucket_sizes[mat_id] = static_cast<uint32_t>(it->second.size());
+        }
+    }
 
-        VkDescriptorSet descriptor_sets[] = {
-         m_pipelines[mat_id].m_descriptor_sets[renderer.getWindow().getCurrentImageId()].m_per_frame_descriptor,
-         m_pipelines[mat_id].m_descriptor_sets[renderer.getWindow().getCurrentImageId()].m_per_object_descriptor,
-        };
+    //the indirect draws of a bucket are a single call, one secondary per bucket is enough
+    const uint32_t min_chunk = m_indirect_draws ? std::numeric_limits<uint32_t>::max() : kMIN_DRAWS_PER_SECONDARY;
 
+    std::vector<VkCommandBuffer> secondaries = m_runtime.m_command_recorder->recordSecondaries(i_frame.m_frame_id, inheritance_info, bucket_sizes, min_chunk,
+        [&](VkCommandBuffer i_cmd, const uint32_t mat_id, const uint32_t i_begin, const uint32_t i_end)
+    {
+        UtilsVK::beginRegion(i_cmd, "Shadow Pass - Material " + mat_id, Vector4f(0.2f, 0.2f, 0.2f, 1.0f));
 
-        vkCmdBindPipeline(current_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines[mat_id].m_pipeline);
-        vkCmdBindDescriptorSets(current_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        vkCmdBindPipeline(i_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines[mat_id].m_pipeline);
+        UtilsVK::setViewport(i_cmd, width, height);
+        vkCmdBindDescriptorSets(i_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
             m_pipelines[mat_id].m_pipeline_layouts, 0, 2,
-            &m_pipelines[mat_id].m_descriptor_sets[renderer.getWindow().getCurrentImageId()].m_per_frame_descriptor,
-            0, nullptr);
-
+            &m_pipelines[mat_id].m_descriptor_sets[i_frame.m_frame_id].m_per_frame_descriptor,
+            1, &i_frame.m_per_frame_offset);
+        m_runtime.m_geometry_pool->bind(i_cmd, kSCENE_VERTEX_LAYOUT, kDEPTH_VERTEX_STREAMS);
 
-        for (auto entity : m_entities_to_draw[mat_id])
+        if (m_indirect_draws)
         {
-            // Dibuja la entidad desde la perspectiva de la luz
-            entity->draw(current_cmd, i_frame);
+            m_indirect_draws->draw(i_cmd, i_frame.m_frame_id, mat_id);
         }
+        else
+        {
+            // Dibuja las entidades desde la perspectiva de la luz
+            for (uint32_t id = i_begin; id < i_end; id++)
+            {
+                (*entities[mat_id])[id]->draw(i_cmd, i_frame, LodTarget::Shadow);
+            }
+        }
+
+        UtilsVK::endRegion(i_cmd);
+    });
 
-        UtilsVK::endRegion(current_cmd);
+    if (!secondaries.empty())
+    {
+        vkCmdExecuteCommands(current_cmd, static_cast<uint32_t>(secondaries.size()), secondaries.data());
     }
 
     vkCmdEndRenderPass(current_cmd);
@@ -212,6 +233,16 @@ void ShadowPassVK::addEntityToDraw(const EntityPtr i_entity)
     m_entities_to_draw[static_cast<uint32_t>(i_entity->getMaterial().getType())].push_back(i_entity);
 }
 
+
+void ShadowPassVK::update(const Frame& i_frame)
+{
+    //the levels of detail can change every frame, the recorded indirect draws read them from here
+    if (m_indirect_draws)
+    {
+        m_indirect_draws->update(i_frame.m_frame_id, m_entities_to_draw, static_cast<uint32_t>(m_pipelines.size()), LodTarget::Shadow);
+    }
+}
+
 void ShadowPassVK::createFbo()
 {
     RendererVK& renderer = *m_runtime.m_renderer;
@@ -280,7 +311,7 @@ void ShadowPassVK::createRenderPass()
     dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
     dependencies[0].dstSubpass = 0;
     dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
     dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
     dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
@@ -310,35 +341,16 @@ void ShadowPassVK::createRenderPass()
 
 void ShadowPassVK::createPipelines()
 {
-    RendererVK& renderer = *m_runtime.m_renderer;
-
-    VkVertexInputBindingDescription binding_vertex_descrition{};
-    binding_vertex_descrition.binding = 0;
-    binding_vertex_descrition.stride = sizeof(Vertex);
-    binding_vertex_descrition.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions{};
-
-    attribute_descriptions[0].binding = 0;
-    attribute_descriptions[0].location = 0;
-    attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attribute_descriptions[0].offset = offsetof(Vertex, m_position);
-
-    attribute_descriptions[1].binding = 0;
-    attribute_descriptions[1].location = 1;
-    attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attribute_descriptions[1].offset = offsetof(Vertex, m_normal);
-
-    attribute_descriptions[2].binding = 0;
-    attribute_descriptions[2].location = 2;
-    attribute_descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    attribute_descriptions[2].offset = offsetof(Vertex, m_uv);
+    //the layout of the scene meshes picks the formats
+    std::vector<VkVertexInputBindingDescription> binding_vertex_descritions;
+    std::vector<VkVertexInputAttributeDescription> attribute_descriptions;
+    MeshVK::getVertexInput(kSCENE_VERTEX_LAYOUT, kDEPTH_VERTEX_STREAMS, binding_vertex_descritions, attribute_descriptions);
 
     VkPipelineVertexInputStateCreateInfo vertex_input_info{};
     vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input_info.vertexBindingDescriptionCount = 1;
+    vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(binding_vertex_descritions.size());
     vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
-    vertex_input_info.pVertexBindingDescriptions = &binding_vertex_descrition;
+    vertex_input_info.pVertexBindingDescriptions = binding_vertex_descritions.data();
     vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data();
     vertex_input_info.flags = 0;
 
@@ -401,31 +413,28 @@ void ShadowPassVK::createPipelines()
     multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
     multisampling.flags = 0;
 
-    VkExtent2D extend{ m_shadowMapResolution, m_shadowMapResolution };
-
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = m_shadowMapResolution;
-    viewport.height = m_shadowMapResolution;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor{};
-    scissor.offset = { 0, 0 };
-    scissor.extent = extend;
-
+    //the resolution of the shadow map is set when recording, the pipeline does not depend on it
     VkPipelineViewportStateCreateInfo viewport_state{};
     viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewport_state.viewportCount = 1;
-    viewport_state.pViewports = &viewport;
+    viewport_state.pViewports = nullptr;
     viewport_state.scissorCount = 1;
-    viewport_state.pScissors = &scissor;
+    viewport_state.pScissors = nullptr;
     viewport_state.flags = 0;
 
+    std::array<VkDynamicState, 2> dynamic_states = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    VkPipelineDynamicStateCreateInfo dynamic_state{};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size());
+    dynamic_state.pDynamicStates = dynamic_states.data();
+
     //create unfiorms 
     createDescriptorLayout();
 
+    //all the pipelines of the pass in one batch, the registry compiles the missing ones in parallel
+    std::vector<VkGraphicsPipelineCreateInfo> graphic_pipelines;
+
     for (auto& pipeline : m_pipelines)
     {
 
@@ -437,13 +446,7 @@ void ShadowPassVK::createPipelines()
         pipeline_layout_info.pushConstantRangeCount = 0;
         pipeline_layout_info.flags = 0;
 
-        std::vector<VkGraphicsPipelineCreateInfo> graphic_pipelines;
-
-
-        if (vkCreatePipelineLayout(renderer.getDevice()->getLogicalDevice(), &pipeline_layout_info, nullptr, &pipeline.m_pipeline_layouts) != VK_SUCCESS)
-        {
-            throw MiniEngineException("failed to create pipeline layout!");
-        }
+        pipeline.m_pipeline_layouts = m_runtime.m_pipeline_registry->getPipelineLayout(pipeline_layout_info);
 
         VkGraphicsPipelineCreateInfo pipeline_info{};
         pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -457,7 +460,7 @@ void ShadowPassVK::createPipelines()
         pipeline_info.pMultisampleState = &multisampling;
         pipeline_info.pViewportState = &viewport_state;
         pipeline_info.pDepthStencilState = &depth_stencil;
-        pipeline_info.pDynamicState = VK_NULL_HANDLE;
+        pipeline_info.pDynamicState = &dynamic_state;
         pipeline_info.stageCount = pipeline.m_shader_stages.size();
         pipeline_info.pStages = pipeline.m_shader_stages.data();
         pipeline_info.flags = 0;
@@ -465,12 +468,14 @@ void ShadowPassVK::createPipelines()
         pipeline_info.subpass = 0;
 
         graphic_pipelines.push_back(pipeline_info);
+    }
 
+    std::vector<VkPipeline> created_pipelines;
+    m_runtime.m_pipeline_registry->getGraphicsPipelines(graphic_pipelines, created_pipelines);
 
-        if (vkCreateGraphicsPipelines(renderer.getDevice()->getLogicalDevice(), VK_NULL_HANDLE, 1, graphic_pipelines.data(), nullptr, &pipeline.m_pipeline))
-        {
-            throw MiniEngineException("Error creating the pipeline");
-        }
+    for (uint32_t id = 0; id < m_pipelines.size(); id++)
+    {
+        m_pipelines[id].m_pipeline = created_pipelines[id];
     }
     createDescriptors();
 }
@@ -483,7 +488,7 @@ void ShadowPassVK::createDescriptorLayout()
     VkDescriptorSetLayoutBinding per_frame_binding = {};
     per_frame_binding.binding = 0;
     per_frame_binding.descriptorCount = 1;
-    per_frame_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    per_frame_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     per_frame_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT;
 
     VkDescriptorSetLayoutCreateInfo set_per_frame_info = {};
@@ -505,14 +510,8 @@ void ShadowPassVK::createDescriptorLayout()
 
     for (auto& pipeline : m_pipelines)
     {
-        if (vkCreateDescriptorSetLayout(m_runtime.m_renderer->getDevice()->getLogicalDevice(), &set_per_frame_info, nullptr, &pipeline.m_descriptor_set_layout[0]) != VK_SUCCESS)
-        {
-            throw MiniEngineException("Error creando descriptor set layout per frame en ShadowPassVK");
-        }
-        if (vkCreateDescriptorSetLayout(m_runtime.m_renderer->getDevice()->getLogicalDevice(), &set_per_object_info, nullptr, &pipeline.m_descriptor_set_layout[1]) != VK_SUCCESS)
-        {
-            throw MiniEngineException("Error creando descriptor set layout per object en ShadowPassVK");
-        }
+        pipeline.m_descriptor_set_layout[0] = m_runtime.m_pipeline_registry->getDescriptorSetLayout(set_per_frame_info);
+        pipeline.m_descriptor_set_layout[1] = m_runtime.m_pipeline_registry->getDescriptorSetLayout(set_per_object_info);
     }
 }
 
@@ -521,7 +520,7 @@ void ShadowPassVK::createDescriptors()
 {
     // Creacin del descriptor pool y la asignacin de descriptor sets, muy similar a DepthPrePassVK
     std::vector<VkDescriptorPoolSize> sizes = {
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 30 },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 30 },
         { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 30 }
     };
 
@@ -538,7 +537,7 @@ void ShadowPassVK::createDescriptors()
 
     for (auto& pipeline : m_pipelines)
     {
-        for (uint32_t id = 0; id < m_runtime.m_renderer->getWindow().getImageCount(); id++)
+        for (uint32_t id = 0; id < kMAX_NUMBER_OF_FRAMES; id++)
         {
             //globals per frame
             //allocate one descriptor set for each frame
@@ -560,11 +559,11 @@ void ShadowPassVK::createDescriptors()
 
             //information about the buffer we want to point at in the descriptor
             VkDescriptorBufferInfo binfo[2];
-            binfo[0].buffer = m_runtime.getPerFrameBuffer()[id];
+            binfo[0].buffer = m_runtime.getUploadBuffer()[id];
             binfo[0].offset = 0;
             binfo[0].range = sizeof(PerFrameData);
 
-            binfo[1].buffer = m_runtime.getPerObjectBuffer()[id];
+            binfo[1].buffer = m_runtime.getPerObjectBuffer();
             binfo[1].offset = 0;
             binfo[1].range = sizeof(PerObjectData) * kMAX_NUMBER_OF_OBJECTS;
 
@@ -573,7 +572,7 @@ void ShadowPassVK::createDescriptors()
             set_write[0].dstBinding = 0;
             set_write[0].dstSet = pipeline.m_descriptor_sets[id].m_per_frame_descriptor;
             set_write[0].descriptorCount = 1;
-            set_write[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            set_write[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             set_write[0].pBufferInfo = &binfo[0];
 
             set_write[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
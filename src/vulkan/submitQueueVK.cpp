@@ -0,0 +1,306 @@
+#include "vulkan/submitQueueVK.h"
+#include "vulkan/uploadBatcherVK.h"
+#include "vulkan/deviceVK.h"
+#include "vulkan/utilsVK.h"
+
+using namespace MiniEngine;
+
+
+SubmitQueueVK::SubmitQueueVK( const DeviceVK& i_device ) :
+    m_device         ( i_device       ),
+    m_queue          ( VK_NULL_HANDLE ),
+    m_queue_family   ( 0              ),
+    m_timeline       ( VK_NULL_HANDLE ),
+    m_upload_pool    ( VK_NULL_HANDLE ),
+    m_submitted_value( 0              )
+{
+}
+
+
+SubmitQueueVK::~SubmitQueueVK()
+{
+}
+
+
+void SubmitQueueVK::initialize( const VkQueue i_queue, const uint32_t i_queue_family )
+{
+    m_queue        = i_queue;
+    m_queue_family = i_queue_family;
+
+    VkSemaphoreTypeCreateInfo type_info{};
+    type_info.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue  = 0;
+
+    VkSemaphoreCreateInfo semaphore_info{};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = &type_info;
+
+    if( vkCreateSemaphore( m_device.getLogicalDevice(), &semaphore_info, nullptr, &m_timeline ) != VK_SUCCESS )
+    {
+        throw MiniEngineException( "Cannot create timeline semaphore" );
+    }
+
+    VkCommandPoolCreateInfo pool_info{};
+    pool_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.queueFamilyIndex = i_queue_family;
+    pool_info.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    if( vkCreateCommandPool( m_device.getLogicalDevice(), &pool_info, nullptr, &m_upload_pool ) != VK_SUCCESS )
+    {
+        throw MiniEngineException( "Error creating the upload command pool" );
+    }
+
+    m_submitted_value = 0;
+}
+
+
+void SubmitQueueVK::createUploadBatcher( SubmitQueueVK* i_transfer_queue )
+{
+    assert( !m_upload_batcher );
+
+    m_upload_batcher = std::make_unique<UploadBatcherVK>( m_device, *this, i_transfer_queue );
+    m_upload_batcher->initialize( kUPLOAD_RING_SIZE );
+}
+
+
+void SubmitQueueVK::shutdown()
+{
+    wait( m_submitted_value );
+    collect();
+
+    if( m_upload_batcher )
+    {
+        m_upload_batcher->shutdown();
+        m_upload_batcher = nullptr;
+    }
+
+    //never submitted, their destinations may already be gone
+    for( auto command_buffer : m_pending_uploads )
+    {
+        vkFreeCommandBuffers( m_device.getLogicalDevice(), m_upload_pool, 1, &command_buffer );
+    }
+    for( auto& staging : m_pending_releases )
+    {
+        vkDestroyBuffer( m_device.getLogicalDevice(), staging.m_buffer, nullptr );
+        vkFreeMemory   ( m_device.getLogicalDevice(), staging.m_memory, nullptr );
+    }
+    m_pending_uploads .clear();
+    m_pending_releases.clear();
+    m_pending_waits   .clear();
+
+    assert( m_retired_uploads.empty() && m_retired_releases.empty() );
+
+    vkDestroyCommandPool( m_device.getLogicalDevice(), m_upload_pool, nullptr );
+    vkDestroySemaphore  ( m_device.getLogicalDevice(), m_timeline   , nullptr );
+
+    m_upload_pool = VK_NULL_HANDLE;
+    m_timeline    = VK_NULL_HANDLE;
+}
+
+
+VkCommandBuffer SubmitQueueVK::beginUpload()
+{
+    VkCommandBufferAllocateInfo alloc_info{};
+    alloc_info.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandPool        = m_upload_pool;
+    alloc_info.commandBufferCount = 1;
+
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    if( vkAllocateCommandBuffers( m_device.getLogicalDevice(), &alloc_info, &command_buffer ) != VK_SUCCESS )
+    {
+        throw MiniEngineException( "Error allocating upload command buffer" );
+    }
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer( command_buffer, &begin_info );
+    UtilsVK::beginRegion( command_buffer, "Upload", Vector4f( 0.0f, 0.0f, 0.5f, 1.0f ) );
+
+    return command_buffer;
+}
+
+
+void SubmitQueueVK::endUpload( VkCommandBuffer i_command_buffer )
+{
+    //whatever is submitted after the upload sees its writes
+    VkMemoryBarrier barrier{};
+    barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+    vkCmdPipelineBarrier( i_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr );
+
+    UtilsVK::endRegion( i_command_buffer );
+    vkEndCommandBuffer( i_command_buffer );
+
+    m_pending_uploads.push_back( i_command_buffer );
+}
+
+
+void SubmitQueueVK::releaseBuffer( const VkBuffer i_buffer, const VkDeviceMemory i_memory )
+{
+    m_pending_releases.push_back( { i_buffer, i_memory } );
+}
+
+
+void SubmitQueueVK::addWait( const VkSemaphore i_timeline, const uint64_t i_value, const VkPipelineStageFlags i_stage )
+{
+    m_pending_waits.push_back( { i_timeline, i_value, i_stage } );
+}
+
+
+uint64_t SubmitQueueVK::submit(
+    const std::vector<VkCommandBuffer>& i_command_buffers,
+    const VkSemaphore                   i_wait_semaphore,
+    const VkPipelineStageFlags          i_wait_stage,
+    const VkSemaphore                   i_signal_semaphore )
+{
+    const uint64_t value = m_submitted_value + 1;
+
+    //may add uploads and waits of its own to this submit
+    if( m_upload_batcher )
+    {
+        m_upload_batcher->close( value );
+    }
+
+    std::vector<VkCommandBuffer> command_buffers( m_pending_uploads );
+    command_buffers.insert( command_buffers.end(), i_command_buffers.begin(), i_command_buffers.end() );
+
+    //the value of a binary semaphore is ignored, the timeline goes last
+    std::vector<VkSemaphore> signal_semaphores;
+    std::vector<uint64_t>    signal_values;
+
+    if( i_signal_semaphore != VK_NULL_HANDLE )
+    {
+        signal_semaphores.push_back( i_signal_semaphore );
+        signal_values    .push_back( 0 );
+    }
+    signal_semaphores.push_back( m_timeline );
+    signal_values    .push_back( value );
+
+    //same for the waits, the binary one first and then the timelines of other queues
+    std::vector<VkSemaphore>          wait_semaphores;
+    std::vector<uint64_t>             wait_values;
+    std::vector<VkPipelineStageFlags> wait_stages;
+
+    if( i_wait_semaphore != VK_NULL_HANDLE )
+    {
+        wait_semaphores.push_back( i_wait_semaphore );
+        wait_values    .push_back( 0 );
+        wait_stages    .push_back( i_wait_stage );
+    }
+    for( const TimelineWait& wait : m_pending_waits )
+    {
+        wait_semaphores.push_back( wait.m_timeline );
+        wait_values    .push_back( wait.m_value );
+        wait_stages    .push_back( wait.m_stage );
+    }
+
+    VkTimelineSemaphoreSubmitInfo timeline_info{};
+    timeline_info.sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.waitSemaphoreValueCount   = static_cast<uint32_t>( wait_values.size() );
+    timeline_info.pWaitSemaphoreValues      = wait_values.data();
+    timeline_info.signalSemaphoreValueCount = static_cast<uint32_t>( signal_values.size() );
+    timeline_info.pSignalSemaphoreValues    = signal_values.data();
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext                = &timeline_info;
+    submit_info.waitSemaphoreCount   = static_cast<uint32_t>( wait_semaphores.size() );
+    submit_info.pWaitSemaphores      = wait_semaphores.data();
+    submit_info.pWaitDstStageMask    = wait_stages.data();
+    submit_info.commandBufferCount   = static_cast<uint32_t>( command_buffers.size() );
+    submit_info.pCommandBuffers      = command_buffers.data();
+    submit_info.signalSemaphoreCount = static_cast<uint32_t>( signal_semaphores.size() );
+    submit_info.pSignalSemaphores    = signal_semaphores.data();
+
+    if( vkQueueSubmit( m_queue, 1, &submit_info, VK_NULL_HANDLE ) != VK_SUCCESS )
+    {
+        throw MiniEngineException( "Error submitting to the queue" );
+    }
+
+    m_submitted_value = value;
+
+    for( auto command_buffer : m_pending_uploads )
+    {
+        m_retired_uploads.push_back( { value, command_buffer } );
+    }
+    for( auto& staging : m_pending_releases )
+    {
+        m_retired_releases.push_back( { value, staging } );
+    }
+
+    m_pending_uploads .clear();
+    m_pending_releases.clear();
+    m_pending_waits   .clear();
+
+    collect();
+
+    return value;
+}
+
+
+uint64_t SubmitQueueVK::flush()
+{
+    if( !hasPendingUploads() && m_pending_releases.empty() )
+    {
+        return m_submitted_value;
+    }
+
+    return submit( {} );
+}
+
+
+bool SubmitQueueVK::hasPendingUploads() const
+{
+    return !m_pending_uploads.empty() || ( m_upload_batcher && m_upload_batcher->isOpen() );
+}
+
+
+void SubmitQueueVK::wait( const uint64_t i_value ) const
+{
+    if( i_value == 0 )
+    {
+        return;
+    }
+
+    VkSemaphoreWaitInfo wait_info{};
+    wait_info.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores    = &m_timeline;
+    wait_info.pValues        = &i_value;
+
+    vkWaitSemaphores( m_device.getLogicalDevice(), &wait_info, UINT64_MAX );
+}
+
+
+uint64_t SubmitQueueVK::getCompletedValue() const
+{
+    uint64_t value = 0;
+    vkGetSemaphoreCounterValue( m_device.getLogicalDevice(), m_timeline, &value );
+
+    return value;
+}
+
+
+void SubmitQueueVK::collect()
+{
+    const uint64_t completed = getCompletedValue();
+
+    while( !m_retired_uploads.empty() && m_retired_uploads.front().m_value <= completed )
+    {
+        vkFreeCommandBuffers( m_device.getLogicalDevice(), m_upload_pool, 1, &m_retired_uploads.front().m_resource );
+        m_retired_uploads.pop_front();
+    }
+
+    while( !m_retired_releases.empty() && m_retired_releases.front().m_value <= completed )
+    {
+        vkDestroyBuffer( m_device.getLogicalDevice(), m_retired_releases.front().m_resource.m_buffer, nullptr );
+        vkFreeMemory   ( m_device.getLogicalDevice(), m_retired_releases.front().m_resource.m_memory, nullptr );
+        m_retired_releases.pop_front();
+    }
+}
@@ -0,0 +1,296 @@
+#include "vulkan/uploadBatcherVK.h"
+#include "vulkan/submitQueueVK.h"
+#include "vulkan/deviceVK.h"
+#include "vulkan/utilsVK.h"
+
+using namespace MiniEngine;
+
+
+UploadBatcherVK::UploadBatcherVK( const DeviceVK& i_device, SubmitQueueVK& i_graphics_queue, SubmitQueueVK* i_transfer_queue ) :
+    m_device        ( i_device                                                ),
+    m_graphics_queue( i_graphics_queue                                        ),
+    m_copy_queue    ( i_transfer_queue ? *i_transfer_queue : i_graphics_queue ),
+    m_ring_buffer   ( VK_NULL_HANDLE                                          ),
+    m_ring_memory   ( VK_NULL_HANDLE                                          ),
+    m_ring_data     ( nullptr                                                 ),
+    m_ring_size     ( 0                                                       ),
+    m_head          ( 0                                                       ),
+    m_tail          ( 0                                                       ),
+    m_command_buffer( VK_NULL_HANDLE                                          )
+{
+}
+
+
+void UploadBatcherVK::initialize( const VkDeviceSize i_ring_size )
+{
+    assert( m_ring_buffer == VK_NULL_HANDLE );
+
+    m_ring_size = i_ring_size;
+
+    UtilsVK::createBuffer( m_device, m_ring_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_ring_buffer, m_ring_memory );
+
+    //mapped once for the whole life of the ring, coherent memory so no flush is needed
+    if( VK_SUCCESS != vkMapMemory( m_device.getLogicalDevice(), m_ring_memory, 0, m_ring_size, 0, reinterpret_cast<void**>( &m_ring_data ) ) )
+    {
+        throw MiniEngineException( "Error mapping the staging ring" );
+    }
+
+    UtilsVK::setObjectName( m_device.getLogicalDevice(), (uint64_t)m_ring_buffer, VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, "Staging Ring" );
+
+    m_head = 0;
+    m_tail = 0;
+}
+
+
+void UploadBatcherVK::shutdown()
+{
+    //the submit queue frees an open batch with the rest of its never submitted uploads
+    if( m_command_buffer != VK_NULL_HANDLE )
+    {
+        m_copy_queue.endUpload( m_command_buffer );
+        m_command_buffer = VK_NULL_HANDLE;
+    }
+
+    for( const StagingBuffer& staging : m_dedicated )
+    {
+        m_copy_queue.releaseBuffer( staging.m_buffer, staging.m_memory );
+    }
+    m_dedicated      .clear();
+    m_batches        .clear();
+    m_buffer_barriers.clear();
+    m_image_barriers .clear();
+
+    if( m_ring_buffer != VK_NULL_HANDLE )
+    {
+        vkUnmapMemory  ( m_device.getLogicalDevice(), m_ring_memory );
+        vkDestroyBuffer( m_device.getLogicalDevice(), m_ring_buffer, nullptr );
+        vkFreeMemory   ( m_device.getLogicalDevice(), m_ring_memory, nullptr );
+    }
+
+    m_ring_buffer = VK_NULL_HANDLE;
+    m_ring_memory = VK_NULL_HANDLE;
+    m_ring_data   = nullptr;
+}
+
+
+StagingRegion UploadBatcherVK::stage( const VkDeviceSize i_size, const VkDeviceSize i_alignment )
+{
+    StagingRegion region;
+
+    if( i_size + i_alignment > m_ring_size )
+    {
+        StagingBuffer staging;
+        UtilsVK::createBuffer( m_device, i_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging.m_buffer, staging.m_memory );
+
+        if( VK_SUCCESS != vkMapMemory( m_device.getLogicalDevice(), staging.m_memory, 0, i_size, 0, &region.m_data ) )
+        {
+            throw MiniEngineException( "Error mapping a staging buffer" );
+        }
+
+        //freeing the memory unmaps it, the buffer lives until the batch has run
+        m_dedicated.push_back( staging );
+
+        region.m_buffer = staging.m_buffer;
+        region.m_offset = 0;
+
+        return region;
+    }
+
+    region.m_buffer = m_ring_buffer;
+    region.m_offset = reserve( i_size, i_alignment );
+    region.m_data   = m_ring_data + region.m_offset;
+
+    //the region belongs to the open batch from now on, even before its copies are recorded
+    getCommandBuffer();
+
+    return region;
+}
+
+
+void UploadBatcherVK::copyToBuffer( const StagingRegion& i_region, const VkDeviceSize i_size, VkBuffer i_dst_buffer, const VkDeviceSize i_dst_offset )
+{
+    VkBufferCopy copy_region{};
+    copy_region.srcOffset = i_region.m_offset;
+    copy_region.dstOffset = i_dst_offset;
+    copy_region.size      = i_size;
+
+    vkCmdCopyBuffer( getCommandBuffer(), i_region.m_buffer, i_dst_buffer, 1, &copy_region );
+
+    if( isTransfer() )
+    {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = m_copy_queue    .getQueueFamily();
+        barrier.dstQueueFamilyIndex = m_graphics_queue.getQueueFamily();
+        barrier.buffer              = i_dst_buffer;
+        barrier.offset              = i_dst_offset;
+        barrier.size                = i_size;
+
+        m_buffer_barriers.push_back( barrier );
+    }
+}
+
+
+void UploadBatcherVK::copyToImage( const StagingRegion& i_region, VkImage i_image, const VkBufferImageCopy& i_copy, const VkImageSubresourceRange& i_range, const VkImageLayout i_final_layout )
+{
+    VkCommandBuffer command_buffer = getCommandBuffer();
+
+    VkBufferImageCopy copy_region = i_copy;
+    copy_region.bufferOffset += i_region.m_offset;
+
+    UtilsVK::setImageLayout( command_buffer, i_image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, i_range );
+    vkCmdCopyBufferToImage ( command_buffer, i_region.m_buffer, i_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region );
+
+    if( !isTransfer() )
+    {
+        UtilsVK::setImageLayout( command_buffer, i_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, i_final_layout, i_range );
+        return;
+    }
+
+    //the final layout comes with the ownership transfer, release and acquire both describe it
+    VkImageMemoryBarrier barrier{};
+    barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout           = i_final_layout;
+    barrier.srcQueueFamilyIndex = m_copy_queue    .getQueueFamily();
+    barrier.dstQueueFamilyIndex = m_graphics_queue.getQueueFamily();
+    barrier.image               = i_image;
+    barrier.subresourceRange    = i_range;
+
+    m_image_barriers.push_back( barrier );
+}
+
+
+void UploadBatcherVK::upload( const void* i_data, const VkDeviceSize i_size, VkBuffer i_dst_buffer, const VkDeviceSize i_dst_offset )
+{
+    const StagingRegion region = stage( i_size );
+    memcpy( region.m_data, i_data, static_cast<size_t>( i_size ) );
+
+    copyToBuffer( region, i_size, i_dst_buffer, i_dst_offset );
+}
+
+
+void UploadBatcherVK::close( const uint64_t i_value )
+{
+    for( const StagingBuffer& staging : m_dedicated )
+    {
+        m_copy_queue.releaseBuffer( staging.m_buffer, staging.m_memory );
+    }
+    m_dedicated.clear();
+
+    if( m_command_buffer == VK_NULL_HANDLE )
+    {
+        return;
+    }
+
+    if( !isTransfer() )
+    {
+        m_copy_queue.endUpload( m_command_buffer );
+        m_command_buffer = VK_NULL_HANDLE;
+
+        m_batches.push_back( { i_value, m_head } );
+        return;
+    }
+
+    //release on the transfer queue, after every copy of the batch
+    for( VkBufferMemoryBarrier& barrier : m_buffer_barriers )
+    {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+    }
+    for( VkImageMemoryBarrier& barrier : m_image_barriers )
+    {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+    }
+
+    vkCmdPipelineBarrier( m_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+        static_cast<uint32_t>( m_buffer_barriers.size() ), m_buffer_barriers.data(), static_cast<uint32_t>( m_image_barriers.size() ), m_image_barriers.data() );
+
+    m_copy_queue.endUpload( m_command_buffer );
+    m_command_buffer = VK_NULL_HANDLE;
+
+    const uint64_t copy_value = m_copy_queue.flush();
+    m_batches.push_back( { copy_value, m_head } );
+
+    //acquire on the graphics queue, in front of the submit that is closing the batch and waits for the copies
+    for( VkBufferMemoryBarrier& barrier : m_buffer_barriers )
+    {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    }
+    for( VkImageMemoryBarrier& barrier : m_image_barriers )
+    {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    }
+
+    VkCommandBuffer acquire = m_graphics_queue.beginUpload();
+
+    vkCmdPipelineBarrier( acquire, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+        static_cast<uint32_t>( m_buffer_barriers.size() ), m_buffer_barriers.data(), static_cast<uint32_t>( m_image_barriers.size() ), m_image_barriers.data() );
+
+    m_graphics_queue.endUpload( acquire );
+    m_graphics_queue.addWait  ( m_copy_queue.getTimeline(), copy_value, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT );
+
+    m_buffer_barriers.clear();
+    m_image_barriers .clear();
+}
+
+
+VkCommandBuffer UploadBatcherVK::getCommandBuffer()
+{
+    if( m_command_buffer == VK_NULL_HANDLE )
+    {
+        m_command_buffer = m_copy_queue.beginUpload();
+    }
+
+    return m_command_buffer;
+}
+
+
+VkDeviceSize UploadBatcherVK::reserve( const VkDeviceSize i_size, const VkDeviceSize i_alignment )
+{
+    const uint64_t completed = m_copy_queue.getCompletedValue();
+
+    while( !m_batches.empty() && m_batches.front().m_value <= completed )
+    {
+        m_tail = m_batches.front().m_end;
+        m_batches.pop_front();
+    }
+
+    for( ;; )
+    {
+        //a region never wraps, the end of the ring is skipped when it doesn't fit there
+        VkDeviceSize position = ( m_head + i_alignment - 1 ) / i_alignment * i_alignment;
+        if( position % m_ring_size + i_size > m_ring_size )
+        {
+            position += m_ring_size - position % m_ring_size;
+        }
+
+        if( position + i_size - m_tail <= m_ring_size )
+        {
+            m_head = position + i_size;
+            return position % m_ring_size;
+        }
+
+        if( !m_batches.empty() )
+        {
+            m_copy_queue.wait( m_batches.front().m_value );
+
+            m_tail = m_batches.front().m_end;
+            m_batches.pop_front();
+        }
+        else if( m_command_buffer != VK_NULL_HANDLE )
+        {
+            //the open batch fills the ring, it goes now and comes back as the oldest batch
+            m_graphics_queue.flush();
+        }
+        else
+        {
+            //nothing in flight, the whole ring is free
+            m_head = 0;
+            m_tail = 0;
+        }
+    }
+}
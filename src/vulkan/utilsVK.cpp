@@ -1,6 +1,8 @@
 #include "vulkan/utilsVK.h"
 #include "vulkan/deviceVK.h"
 #include "vulkan/rendererVK.h"
+#include "vulkan/submitQueueVK.h"
+#include "vulkan/uploadBatcherVK.h"
 #include <fstream>
 #include <iostream>
 #include <vector>
@@ -120,6 +122,24 @@ void UtilsVK::endRegion(VkCommandBuffer cmdBuffer)
 #endif
 }
 
+void UtilsVK::setViewport(VkCommandBuffer i_cmd_buffer, uint32_t i_width, uint32_t i_height)
+{
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)i_width;
+    viewport.height = (float)i_height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor{};
+    scissor.offset = { 0, 0 };
+    scissor.extent = { i_width, i_height };
+
+    vkCmdSetViewport(i_cmd_buffer, 0, 1, &viewport);
+    vkCmdSetScissor(i_cmd_buffer, 0, 1, &scissor);
+}
+
 bool UtilsVK::getSupportedDepthFormat(VkPhysicalDevice i_physical_device, VkFormat* i_depth_format)
 {
     // Since all depth formats may be optional, we need to find a suitable depth format to use
@@ -230,6 +250,11 @@ void UtilsVK::copyBuffer(const DeviceVK& i_device, VkBuffer i_src_buffer, VkBuff
     endOneTimeCommandBuffer(i_device, command_buffer);
 }
 
+void UtilsVK::uploadBuffer(const DeviceVK& i_device, const void* i_data, VkDeviceSize i_size, VkBuffer i_dst_buffer, VkDeviceSize i_dst_offset)
+{
+    i_device.getSubmitQueue().getUploadBatcher().upload(i_data, i_size, i_dst_buffer, i_dst_offset);
+}
+
 void UtilsVK::setImageLayout(VkCommandBuffer cmdbuffer, VkImage image, VkImageLayout oldImageLayout,
     VkImageLayout newImageLayout, VkImageSubresourceRange subresourceRange,
     VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
@@ -351,6 +376,7 @@ void UtilsVK::createImage(const DeviceVK& i_device, VkFormat i_format, VkImageUs
     VkImageLayout image_layout;
 
     o_image_block.m_format = i_format;
+    o_image_block.m_extent = { i_width, i_height };
 
     if (i_usage_bits & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
     {
@@ -429,6 +455,7 @@ void MiniEngine::UtilsVK::createImage(const DeviceVK& i_device, VkFormat i_forma
 
     o_image_block.m_format = i_format;
     o_image_block.m_type = i_image_type;
+    o_image_block.m_extent = { i_width, i_height };
 
     if (i_usage_bits & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
     {
@@ -527,56 +554,17 @@ void UtilsVK::TextureFromBuffer(const DeviceVK& device, void* i_buffer, VkDevice
     assert(i_buffer != nullptr);
     uint32_t mip_levels = 1;
 
+    o_new_image.m_extent = { i_tex_width, i_tex_height };
+
     VkMemoryAllocateInfo mem_alloc_info{};
     mem_alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
     VkMemoryRequirements mem_reqs;
 
-    // Use a separate command buffer for texture loading
-    VkCommandBuffer command_buffer = initOneTimeCommandBuffer(device);
-
-    // Create a host-visible staging buffer that contains the raw image data
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_memory;
-
-    VkBufferCreateInfo buffer_create_info{};
-    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    buffer_create_info.size = i_buffer_size;
-
-    // This buffer is used as a transfer source for the buffer copy
-    buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    if (VK_SUCCESS != vkCreateBuffer(device.getLogicalDevice(), &buffer_create_info, nullptr, &staging_buffer))
-    {
-        throw MiniEngineException("Error Creating Buffer");
-    }
-
-    // Get memory requirements for the staging buffer (alignment, memory type bits)
-    vkGetBufferMemoryRequirements(device.getLogicalDevice(), staging_buffer, &mem_reqs);
-
-    mem_alloc_info.allocationSize = mem_reqs.size;
-    // Get memory type index for a host visible buffer
-    mem_alloc_info.memoryTypeIndex = device.getMemoryTypeIndex(
-        mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    // The raw image data goes to the staging ring, the copy is batched with the other uploads
+    UploadBatcherVK& upload_batcher = device.getSubmitQueue().getUploadBatcher();
 
-    if (VK_SUCCESS != vkAllocateMemory(device.getLogicalDevice(), &mem_alloc_info, nullptr, &staging_memory))
-    {
-        throw MiniEngineException("Error Creating Buffer");
-    }
-
-    if (VK_SUCCESS != vkBindBufferMemory(device.getLogicalDevice(), staging_buffer, staging_memory, 0))
-    {
-        throw MiniEngineException("Error Creating Buffer");
-    }
-
-    // Copy texture data into staging buffer
-    uint8_t* data;
-    if (VK_SUCCESS != vkMapMemory(device.getLogicalDevice(), staging_memory, 0, mem_reqs.size, 0, (void**)&data))
-    {
-    }
-
-    memcpy(data, i_buffer, static_cast<size_t>(i_buffer_size));
-    vkUnmapMemory(device.getLogicalDevice(), staging_memory);
+    const StagingRegion staging = upload_batcher.stage(i_buffer_size);
+    memcpy(staging.m_data, i_buffer, static_cast<size_t>(i_buffer_size));
 
     VkBufferImageCopy buffer_copy_region = {};
     buffer_copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -636,24 +624,8 @@ void UtilsVK::TextureFromBuffer(const DeviceVK& device, void* i_buffer, VkDevice
     subresource_range.levelCount = mip_levels;
     subresource_range.layerCount = 1;
 
-    // Image barrier for optimal image (target)
-    // Optimal image will be used as destination for the copy
-    setImageLayout(command_buffer, o_new_image.m_image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        subresource_range);
-
-    // Copy mip levels from staging buffer
-    vkCmdCopyBufferToImage(command_buffer, staging_buffer, o_new_image.m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-        &buffer_copy_region);
-
-    // Change texture image layout to shader read after all mip levels have been copied
-    setImageLayout(command_buffer, o_new_image.m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, i_image_layout,
-        subresource_range);
-
-    endOneTimeCommandBuffer(device, command_buffer);
-
-    // Clean up staging resources
-    vkFreeMemory(device.getLogicalDevice(), staging_memory, nullptr);
-    vkDestroyBuffer(device.getLogicalDevice(), staging_buffer, nullptr);
+    // Transfer destination, copy of the mip levels from the staging ring and transition to i_image_layout
+    upload_batcher.copyToImage(staging, o_new_image.m_image, buffer_copy_region, subresource_range, i_image_layout);
 
     // Create sampler
     VkSamplerCreateInfo sampler_create_info = {};
@@ -720,13 +692,9 @@ void UtilsVK::endOneTimeCommandBuffer(const DeviceVK& device, VkCommandBuffer io
     UtilsVK::endRegion(io_command_buffer);
     vkEndCommandBuffer(io_command_buffer);
 
-    VkSubmitInfo submit_info{};
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &io_command_buffer;
-
-    vkQueueSubmit(device.getGraphicsQueue(), 1, &submit_info, VK_NULL_HANDLE);
-    vkQueueWaitIdle(device.getGraphicsQueue());
+    // pending uploads go first, then wait for this exact submit instead of the whole queue
+    SubmitQueueVK& submit_queue = device.getSubmitQueue();
+    submit_queue.wait(submit_queue.submit({ io_command_buffer }));
     // vkResetCommandPool(device.getLogicalDevice(),  device.getCommandPool(), 0U);
     // vkResetCommandBuffer(io_command_buffer, 0);
     vkFreeCommandBuffers(device.getLogicalDevice(), device.getCommandPool(), 1, &io_command_buffer);
@@ -231,6 +231,7 @@ void WindowVK::createSwapChain()
         colorAttachmentView.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
         colorAttachmentView.flags                           = 0;
         colorAttachmentView.image                           =  m_swap_chain_images[ i ].m_image = images[ i ];
+        m_swap_chain_images[ i ].m_extent                   = swapchain_extent;
 
         if( vkCreateImageView( m_renderer.getDevice()->getLogicalDevice(), &colorAttachmentView, nullptr, &m_swap_chain_images[ i ].m_image_view ) )
         {
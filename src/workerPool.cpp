@@ -0,0 +1,191 @@
+#include "workerPool.h"
+
+using namespace MiniEngine;
+
+
+namespace
+{
+    thread_local uint32_t t_thread_index = 0;
+}
+
+
+WorkerPool::WorkerPool() :
+    m_stop( false )
+{
+}
+
+
+WorkerPool::~WorkerPool()
+{
+    assert( m_workers.empty() );
+}
+
+
+void WorkerPool::initialize( const uint32_t i_worker_count )
+{
+    assert( m_workers.empty() );
+
+    m_stop = false;
+
+    for( uint32_t id = 0; id < i_worker_count; id++ )
+    {
+        m_workers.emplace_back( &WorkerPool::workerLoop, this, id + 1 );
+    }
+}
+
+
+void WorkerPool::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock( m_jobs_mutex );
+        m_stop = true;
+    }
+    m_jobs_condition.notify_all();
+
+    for( auto& worker : m_workers )
+    {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+
+void WorkerPool::parallelFor( const uint32_t i_count, const uint32_t i_min_chunk, const std::function<void( uint32_t, uint32_t )>& i_job )
+{
+    if( i_count == 0 )
+    {
+        return;
+    }
+
+    const uint32_t chunk  = std::max( std::max( i_min_chunk, 1u ), ( i_count + getThreadCount() - 1 ) / getThreadCount() );
+    const uint32_t chunks = ( i_count + chunk - 1 ) / chunk;
+
+    if( chunks == 1 || m_workers.empty() )
+    {
+        i_job( 0, i_count );
+        return;
+    }
+
+    //the jobs reference these locals, so this function never leaves before all of them have finished
+    std::atomic<uint32_t> pending( chunks - 1 );
+    std::exception_ptr    error;
+    std::mutex            error_mutex;
+
+    auto run_chunk = [ & ]( const uint32_t i_begin, const uint32_t i_end )
+    {
+        try
+        {
+            i_job( i_begin, i_end );
+        }
+        catch( ... )
+        {
+            std::lock_guard<std::mutex> lock( error_mutex );
+            if( !error )
+            {
+                error = std::current_exception();
+            }
+        }
+    };
+
+    {
+        std::lock_guard<std::mutex> lock( m_jobs_mutex );
+
+        for( uint32_t id = 1; id < chunks; id++ )
+        {
+            const uint32_t begin = id * chunk;
+            const uint32_t end   = std::min( i_count, begin + chunk );
+
+            m_jobs.emplace_back( [ &, begin, end ]()
+            {
+                run_chunk( begin, end );
+                pending.fetch_sub( 1, std::memory_order_release );
+            } );
+        }
+    }
+    m_jobs_condition.notify_all();
+
+    run_chunk( 0, std::min( i_count, chunk ) );
+
+    while( pending.load( std::memory_order_acquire ) > 0 )
+    {
+        if( !runPendingJob() )
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    if( error )
+    {
+        std::rethrow_exception( error );
+    }
+}
+
+
+void WorkerPool::post( std::function<void()> i_job )
+{
+    if( m_workers.empty() )
+    {
+        i_job();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock( m_jobs_mutex );
+        m_jobs.push_back( std::move( i_job ) );
+    }
+    m_jobs_condition.notify_one();
+}
+
+
+uint32_t WorkerPool::getThreadIndex()
+{
+    return t_thread_index;
+}
+
+
+void WorkerPool::workerLoop( const uint32_t i_thread_index )
+{
+    t_thread_index = i_thread_index;
+
+    while( true )
+    {
+        std::function<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock( m_jobs_mutex );
+            m_jobs_condition.wait( lock, [ this ]() { return m_stop || !m_jobs.empty(); } );
+
+            if( m_jobs.empty() )
+            {
+                return;
+            }
+
+            job = std::move( m_jobs.front() );
+            m_jobs.pop_front();
+        }
+
+        job();
+    }
+}
+
+
+bool WorkerPool::runPendingJob()
+{
+    std::function<void()> job;
+
+    {
+        std::lock_guard<std::mutex> lock( m_jobs_mutex );
+
+        if( m_jobs.empty() )
+        {
+            return false;
+        }
+
+        job = std::move( m_jobs.front() );
+        m_jobs.pop_front();
+    }
+
+    job();
+
+    return true;
+}
@@ -0,0 +1,121 @@
+#include "common.h"
+#include "objParser.h"
+#include "workerPool.h"
+
+#include <chrono>
+
+using namespace MiniEngine;
+
+
+namespace
+{
+    //reference for ObjParser, tinyobj into the same layout
+    void loadTinyObj( const std::string& i_path, ObjParser::Mesh& o_mesh )
+    {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+
+        std::string warn;
+        std::string err;
+        bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, i_path.c_str() );
+
+        if (!err.empty()) 
+        {
+            throw MiniEngineException( err.c_str() );
+        }
+
+        if(!ret) 
+        {
+            throw MiniEngineException( "Failed to load/parse .obj.\n");
+        }
+
+        o_mesh.m_positions = attrib.vertices;
+        o_mesh.m_normals   = attrib.normals;
+        o_mesh.m_texcoords = attrib.texcoords;
+        o_mesh.m_indices.clear();
+
+        for( const auto& shape : shapes )
+        {
+            for( const auto& index : shape.mesh.indices )
+            {
+                o_mesh.m_indices.push_back( { index.vertex_index, index.normal_index, index.texcoord_index } );
+            }
+        }
+    }
+
+
+    double getMilliseconds( const std::chrono::high_resolution_clock::time_point i_start, const std::chrono::high_resolution_clock::time_point i_end )
+    {
+        return std::chrono::duration<double, std::milli>( i_end - i_start ).count();
+    }
+
+
+    //times tinyobj, ObjParser on the calling thread and ObjParser on i_workers on the same file, and checks the
+    //parallel output against tinyobj
+    void benchmarkOBJ( const std::string& i_path, WorkerPool& i_workers )
+    {
+        typedef std::chrono::high_resolution_clock Clock;
+
+        ObjParser::Mesh reference;
+        ObjParser::Mesh serial;
+        ObjParser::Mesh parallel;
+
+        const auto reference_start = Clock::now();
+        loadTinyObj( i_path, reference );
+        const auto serial_start = Clock::now();
+        if( !ObjParser::load( i_path, nullptr, serial ) )
+        {
+            throw MiniEngineException( "Failed to load/parse %s", i_path );
+        }
+        const auto parallel_start = Clock::now();
+        if( !ObjParser::load( i_path, &i_workers, parallel ) )
+        {
+            throw MiniEngineException( "Failed to load/parse %s", i_path );
+        }
+        const auto parallel_end = Clock::now();
+
+        const bool same_indices = std::equal( parallel.m_indices.begin(), parallel.m_indices.end(), reference.m_indices.begin(), reference.m_indices.end(), []( const ObjParser::Index& i_a, const ObjParser::Index& i_b )
+        {
+            return i_a.m_vertex_index == i_b.m_vertex_index && i_a.m_normal_index == i_b.m_normal_index && i_a.m_texcoord_index == i_b.m_texcoord_index;
+        } );
+
+        const bool same = same_indices && parallel.m_positions == reference.m_positions && parallel.m_normals == reference.m_normals && parallel.m_texcoords == reference.m_texcoords;
+
+        std::cout << i_path << ": " << parallel.m_indices.size() / 3 << " triangles, tinyobj "
+                  << getMilliseconds( reference_start, serial_start ) << " ms, ObjParser "
+                  << getMilliseconds( serial_start, parallel_start ) << " ms on 1 thread, "
+                  << getMilliseconds( parallel_start, parallel_end ) << " ms on " << i_workers.getThreadCount() << " threads"
+                  << ( same ? "" : ", OUTPUT DIFFERS" ) << std::endl;
+    }
+}
+
+
+//ObjParserBenchmark file.obj [file.obj ...]
+int main( int argc, char* argv[] )
+{
+    if( argc < 2 )
+    {
+        std::cout << "usage: ObjParserBenchmark file.obj [file.obj ...]" << std::endl;
+        return 1;
+    }
+
+    //the calling thread takes part in the parsing, one worker less than the cores
+    WorkerPool workers;
+    workers.initialize( std::max( std::thread::hardware_concurrency(), 1u ) - 1 );
+
+    try
+    {
+        for( int id = 1; id < argc; id++ )
+        {
+            benchmarkOBJ( argv[ id ], workers );
+        }
+    }
+    catch( const std::exception& e )
+    {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}